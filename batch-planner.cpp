@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Calculate a whole set of dive plans from a scenario file without the GUI */
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QJsonDocument>
+#include <QTextStream>
+#include <QThreadPool>
+
+#include "core/batchplanner.h"
+#include "core/subsurfacestartup.h"
+#include <stdio.h>
+
+int main(int argc, char **argv)
+{
+	QCoreApplication *application = new QCoreApplication(argc, argv);
+	copy_prefs(&default_prefs, &prefs);
+
+	QCommandLineParser parser;
+	QCommandLineOption inputOption(QStringList() << "i" << "input",
+				       "Read the scenarios from JSON <file>",
+				       "file");
+	parser.addOption(inputOption);
+	QCommandLineOption outputOption(QStringList() << "o" << "output",
+					"Write the plans to <file> instead of stdout",
+					"file");
+	parser.addOption(outputOption);
+	QCommandLineOption formatOption(QStringList() << "f" << "format",
+					"Write the plans as csv (default) or json",
+					"format", "csv");
+	parser.addOption(formatOption);
+	QCommandLineOption jobsOption(QStringList() << "j" << "jobs",
+				      "Calculate at most <n> plans at the same time",
+				      "n");
+	parser.addOption(jobsOption);
+
+	parser.process(*application);
+
+	QString input = parser.value(inputOption);
+	QString format = parser.value(formatOption);
+	if (input.isEmpty() || (format != "csv" && format != "json")) {
+		fprintf(stderr, "need --input and a --format of csv or json\n");
+		exit(1);
+	}
+	if (parser.isSet(jobsOption) && parser.value(jobsOption).toInt() > 0)
+		QThreadPool::globalInstance()->setMaxThreadCount(parser.value(jobsOption).toInt());
+
+	QFile inputFile(input);
+	if (!inputFile.open(QIODevice::ReadOnly)) {
+		fprintf(stderr, "cannot open %s\n", qPrintable(input));
+		exit(1);
+	}
+	QJsonParseError error;
+	QJsonDocument doc = QJsonDocument::fromJson(inputFile.readAll(), &error);
+	if (error.error != QJsonParseError::NoError || !doc.isObject()) {
+		fprintf(stderr, "%s: %s\n", qPrintable(input), qPrintable(error.errorString()));
+		exit(1);
+	}
+
+	QJsonArray results;
+	QStringList errors;
+	if (!run_batch_plans(doc.object(), results, errors)) {
+		for (const QString &message: errors)
+			fprintf(stderr, "%s\n", qPrintable(message));
+		exit(1);
+	}
+
+	QFile outputFile;
+	QString output = parser.value(outputOption);
+	if (output.isEmpty()) {
+		outputFile.open(stdout, QIODevice::WriteOnly);
+	} else {
+		outputFile.setFileName(output);
+		if (!outputFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+			fprintf(stderr, "cannot write %s\n", qPrintable(output));
+			exit(1);
+		}
+	}
+	if (format == "json") {
+		outputFile.write(QJsonDocument(results).toJson());
+	} else {
+		QTextStream out(&outputFile);
+		write_batch_plans_csv(out, results);
+	}
+	outputFile.close();
+	exit(0);
+}
@@ -0,0 +1,414 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Calculate a whole set of dive plans from a scenario file */
+
+#include "batchplanner.h"
+#include "dive.h"
+#include "planner.h"
+#include "qthelper.h"
+#include "units.h"
+
+#include <QTextStream>
+#include <QVector>
+#include <QtConcurrent>
+
+/*
+ * A scenario file is a JSON object like this (depths in m, times in min,
+ * cylinder sizes in l, pressures in bar, SAC in l/min, surface pressure in mbar):
+ *
+ * {
+ *   "settings": { "last_stop_6m": false, "descent_rate": 18, "deco_po2": 1.6 },
+ *   "scenarios": [
+ *     { "name": "trimix", "deco_mode": "buehlmann", "gflow": [30, 50], "gfhigh": 80,
+ *       "cylinders": [ { "o2": 18, "he": 45, "size": 24, "pressure": 232 },
+ *                      { "o2": 50, "deco": true } ],
+ *       "depth": [ 50, 60 ], "bottom_time": [ 20, 25, 30 ] },
+ *     { "name": "multilevel", "deco_mode": "vpmb", "conservatism": [ 0, 2 ],
+ *       "cylinders": [ { "o2": 32, "size": 12, "pressure": 200 } ],
+ *       "segments": [ { "depth": 30, "time": 15 }, { "depth": 20, "time": 20 } ] }
+ *   ]
+ * }
+ *
+ * Every number of a scenario except those in "segments" may also be a list, and
+ * "cylinders" may be a list of cylinder lists. The scenario is then expanded into
+ * all combinations. "depth" and "bottom_time" give a square profile whose descent
+ * is part of the bottom time, "segments" are planner waypoints whose time includes
+ * the transition from the previous depth. A scenario needs either both "depth"
+ * and "bottom_time" or "segments".
+ */
+
+namespace {
+	struct Scenario {
+		QString name;
+		enum deco_mode deco_mode;
+		int gflow, gfhigh, conservatism;
+		int surface_pressure, salinity;
+		int bottomsac, decosac;
+		QJsonArray cylinders;
+		QJsonArray segments;
+	};
+
+	struct PlanJob {
+		Scenario scenario;
+		struct diveplan diveplan;
+		struct dive dive;
+		struct deco_state ds;
+		struct decostop stoptable[60];
+	};
+}
+
+static QVector<double> numbers(const QJsonObject &obj, const QString &key, double def)
+{
+	QVector<double> res;
+	QJsonValue value = obj.value(key);
+
+	if (value.isArray()) {
+		for (const QJsonValue &v: value.toArray())
+			res.append(v.toDouble(def));
+	}
+	if (res.isEmpty())
+		res.append(value.toDouble(def));
+	return res;
+}
+
+// A number or a non-empty list of numbers
+static bool is_numbers(const QJsonValue &value)
+{
+	if (!value.isArray())
+		return value.isDouble();
+	if (value.toArray().isEmpty())
+		return false;
+	for (const QJsonValue &v: value.toArray()) {
+		if (!v.isDouble())
+			return false;
+	}
+	return true;
+}
+
+static void apply_settings(const QJsonObject &settings)
+{
+	if (settings.contains("last_stop_6m"))
+		prefs.last_stop = settings.value("last_stop_6m").toBool();
+	if (settings.contains("o2_breaks"))
+		prefs.doo2breaks = settings.value("o2_breaks").toBool();
+	if (settings.contains("switch_at_required_stop"))
+		prefs.switch_at_req_stop = settings.value("switch_at_required_stop").toBool();
+	if (settings.contains("min_switch_duration"))
+		prefs.min_switch_duration = lrint(settings.value("min_switch_duration").toDouble() * 60);
+	if (settings.contains("descent_rate"))
+		prefs.descrate = lrint(settings.value("descent_rate").toDouble() * 1000 / 60);
+	if (settings.contains("ascent_rate_75"))
+		prefs.ascrate75 = lrint(settings.value("ascent_rate_75").toDouble() * 1000 / 60);
+	if (settings.contains("ascent_rate_50"))
+		prefs.ascrate50 = lrint(settings.value("ascent_rate_50").toDouble() * 1000 / 60);
+	if (settings.contains("ascent_rate_stops"))
+		prefs.ascratestops = lrint(settings.value("ascent_rate_stops").toDouble() * 1000 / 60);
+	if (settings.contains("ascent_rate_last_6m"))
+		prefs.ascratelast6m = lrint(settings.value("ascent_rate_last_6m").toDouble() * 1000 / 60);
+	if (settings.contains("bottom_po2"))
+		prefs.bottompo2 = lrint(settings.value("bottom_po2").toDouble() * 1000);
+	if (settings.contains("deco_po2"))
+		prefs.decopo2 = lrint(settings.value("deco_po2").toDouble() * 1000);
+}
+
+// Check that the profile of a scenario entry makes sense before it is expanded
+static bool check_profile(const QJsonObject &obj, const QString &name, QStringList &errors)
+{
+	int nr_errors = errors.size();
+
+	if (obj.contains("segments")) {
+		QJsonArray segments = obj.value("segments").toArray();
+		if (segments.isEmpty())
+			errors.append(QString("%1: segments must be a non-empty list").arg(name));
+		for (int i = 0; i < segments.size(); i++) {
+			QJsonObject segment = segments.at(i).toObject();
+			if (!segment.value("depth").isDouble() || segment.value("depth").toDouble() < 0.0)
+				errors.append(QString("%1: segment %2 needs a depth of at least 0 m").arg(name).arg(i + 1));
+			if (!segment.value("time").isDouble() || segment.value("time").toDouble() <= 0.0)
+				errors.append(QString("%1: segment %2 needs a time of more than 0 min").arg(name).arg(i + 1));
+		}
+		return errors.size() == nr_errors;
+	}
+
+	if (!is_numbers(obj.value("depth")) || !is_numbers(obj.value("bottom_time"))) {
+		errors.append(QString("%1: needs a depth and a bottom_time, or segments").arg(name));
+		return false;
+	}
+	for (double depth: numbers(obj, "depth", 0.0)) {
+		double droptime = depth * 1000 / prefs.descrate / 60;
+		if (depth <= 0.0) {
+			errors.append(QString("%1: depth %2 m is not deeper than the surface").arg(name).arg(depth));
+			continue;
+		}
+		for (double bottom_time: numbers(obj, "bottom_time", 0.0)) {
+			if (bottom_time <= droptime)
+				errors.append(QString("%1: bottom time %2 min is not longer than the %3 min descent to %4 m")
+					      .arg(name).arg(bottom_time).arg(droptime, 0, 'f', 1).arg(depth));
+		}
+	}
+	return errors.size() == nr_errors;
+}
+
+// Expand one entry of the scenario file into all its combinations
+static bool expand_scenario(const QJsonObject &obj, int nr, QVector<Scenario> &scenarios, QStringList &errors)
+{
+	Scenario base;
+	QString mode = obj.value("deco_mode").toString("buehlmann").toLower();
+	QVector<QJsonArray> cylinder_sets;
+	QVector<QJsonArray> profiles;
+
+	base.name = obj.value("name").toString(QString("scenario %1").arg(nr));
+	base.deco_mode = mode == "vpmb" || mode == "vpm-b" ? VPMB : BUEHLMANN;
+	base.surface_pressure = lrint(obj.value("surface_pressure").toDouble(SURFACE_PRESSURE));
+	base.salinity = lrint(obj.value("salinity").toDouble(SEAWATER_SALINITY));
+	base.bottomsac = lrint(obj.value("bottom_sac").toDouble(prefs.bottomsac / 1000.0) * 1000);
+	base.decosac = lrint(obj.value("deco_sac").toDouble(prefs.decosac / 1000.0) * 1000);
+
+	if (!check_profile(obj, base.name, errors))
+		return false;
+
+	QJsonArray cylinders = obj.value("cylinders").toArray();
+	if (!cylinders.isEmpty() && cylinders.first().isArray()) {
+		for (const QJsonValue &set: cylinders)
+			cylinder_sets.append(set.toArray());
+	} else {
+		cylinder_sets.append(cylinders);
+	}
+
+	if (obj.contains("segments")) {
+		profiles.append(obj.value("segments").toArray());
+	} else {
+		for (double depth: numbers(obj, "depth", 0.0)) {
+			for (double bottom_time: numbers(obj, "bottom_time", 0.0)) {
+				double droptime = depth * 1000 / prefs.descrate / 60;
+				QJsonArray square;
+				square.append(QJsonObject { { "depth", depth }, { "time", droptime } });
+				square.append(QJsonObject { { "depth", depth }, { "time", bottom_time - droptime } });
+				profiles.append(square);
+			}
+		}
+	}
+
+	// Buehlmann ignores the conservatism and VPM-B the gradient factors
+	QVector<double> gflows = base.deco_mode == VPMB ? QVector<double> { (double)prefs.gflow } : numbers(obj, "gflow", prefs.gflow);
+	QVector<double> gfhighs = base.deco_mode == VPMB ? QVector<double> { (double)prefs.gfhigh } : numbers(obj, "gfhigh", prefs.gfhigh);
+	QVector<double> conservatisms = base.deco_mode == VPMB ? numbers(obj, "conservatism", prefs.vpmb_conservatism) : QVector<double> { 0.0 };
+
+	for (const QJsonArray &profile: profiles) {
+		for (const QJsonArray &cylinder_set: cylinder_sets) {
+			for (double gflow: gflows) {
+				for (double gfhigh: gfhighs) {
+					for (double conservatism: conservatisms) {
+						Scenario scenario = base;
+						scenario.segments = profile;
+						scenario.cylinders = cylinder_set;
+						scenario.gflow = lrint(gflow);
+						scenario.gfhigh = lrint(gfhigh);
+						scenario.conservatism = lrint(conservatism);
+						scenarios.append(scenario);
+					}
+				}
+			}
+		}
+	}
+	return true;
+}
+
+// Turn a scenario into a dive with its cylinders and a plan with its waypoints
+static bool setup_job(PlanJob &job, QStringList &errors)
+{
+	const Scenario &scenario = job.scenario;
+	struct diveplan *diveplan = &job.diveplan;
+	struct dive *dive = &job.dive;
+	pressure_t decopo2 = { .mbar = prefs.decopo2 };
+	int nr_cylinders = scenario.cylinders.size();
+
+	if (nr_cylinders == 0 || nr_cylinders > MAX_CYLINDERS) {
+		errors.append(QString("%1: need 1 to %2 cylinders").arg(scenario.name).arg(MAX_CYLINDERS));
+		return false;
+	}
+
+	diveplan->when = 0;
+	diveplan->surface_pressure = scenario.surface_pressure;
+	diveplan->salinity = scenario.salinity;
+	diveplan->bottomsac = scenario.bottomsac;
+	diveplan->decosac = scenario.decosac;
+	diveplan->gflow = scenario.gflow;
+	diveplan->gfhigh = scenario.gfhigh;
+	diveplan->vpmb_conservatism = scenario.conservatism;
+	dive->surface_pressure.mbar = scenario.surface_pressure;
+	dive->salinity = scenario.salinity;
+
+	for (int i = 0; i < nr_cylinders; i++) {
+		QJsonObject obj = scenario.cylinders.at(i).toObject();
+		cylinder_t *cyl = &dive->cylinder[i];
+
+		cyl->gasmix.o2.permille = lrint(obj.value("o2").toDouble(21.0) * 10);
+		cyl->gasmix.he.permille = lrint(obj.value("he").toDouble(0.0) * 10);
+		cyl->type.size.mliter = lrint(obj.value("size").toDouble(0.0) * 1000);
+		cyl->type.workingpressure.mbar = lrint(obj.value("pressure").toDouble(0.0) * 1000);
+		if (obj.contains("switch_depth"))
+			cyl->depth.mm = lrint(obj.value("switch_depth").toDouble() * 1000);
+		else
+			cyl->depth = gas_mod(&cyl->gasmix, decopo2, dive, M_OR_FT(3,10));
+	}
+	reset_cylinders(dive, true);
+
+	// Like the planner model, tell the algorithm about the deco gases that are available
+	for (int i = 1; i < nr_cylinders; i++) {
+		QJsonObject obj = scenario.cylinders.at(i).toObject();
+		if (obj.contains("switch_depth") || obj.value("deco").toBool())
+			plan_add_segment(diveplan, 0, dive->cylinder[i].depth.mm, i, 0, true);
+	}
+
+	for (const QJsonValue &value: scenario.segments) {
+		QJsonObject obj = value.toObject();
+		int cylinderid = obj.value("cylinder").toInt(0);
+
+		if (cylinderid < 0 || cylinderid >= nr_cylinders) {
+			errors.append(QString("%1: segment uses unknown cylinder %2").arg(scenario.name).arg(cylinderid));
+			return false;
+		}
+		plan_add_segment(diveplan, lrint(obj.value("time").toDouble() * 60), lrint(obj.value("depth").toDouble() * 1000),
+				 cylinderid, 0, true);
+	}
+
+	// The deco model is that of the scenario, not that of the application state
+	memset(&job.ds, 0, sizeof(job.ds));
+	init_deco_parameters(&job.ds);
+	job.ds.params.planner = true;
+	job.ds.params.deco_mode = scenario.deco_mode;
+	return true;
+}
+
+static void run_job(PlanJob &job)
+{
+	struct deco_state *cache = NULL;
+
+	plan(&job.ds, &job.diveplan, &job.dive, DECOTIMESTEP, job.stoptable, &cache, true, false);
+	free(cache);
+}
+
+static QString format_time(int seconds)
+{
+	return QString("%1:%2").arg(seconds / 60).arg(seconds % 60, 2, 10, QChar('0'));
+}
+
+static QJsonObject job_to_json(const PlanJob &job)
+{
+	const Scenario &scenario = job.scenario;
+	QJsonArray runtime, stops, cylinders;
+	int lasttime = 0, lastdepth = 0, maxdepth = 0, minimum_gas = 0;
+
+	for (struct divedatapoint *dp = job.diveplan.dp; dp; dp = dp->next) {
+		// the dive notes put the minimum gas on the last bottom segment
+		if (dp->minimum_gas.mbar)
+			minimum_gas = dp->minimum_gas.mbar;
+		if (dp->time == 0)
+			continue;
+		runtime.append(QJsonObject {
+			{ "depth", dp->depth.mm / 1000.0 },
+			{ "duration", dp->time - lasttime },
+			{ "runtime", dp->time },
+			{ "cylinder", dp->cylinderid },
+			{ "entered", dp->entered }
+		});
+		// A calculated segment that stays at its depth is a deco (or safety) stop
+		if (!dp->entered && dp->depth.mm && dp->depth.mm == lastdepth)
+			stops.append(QJsonObject { { "depth", dp->depth.mm / 1000.0 }, { "time", dp->time - lasttime } });
+		lasttime = dp->time;
+		lastdepth = dp->depth.mm;
+		maxdepth = qMax(maxdepth, lastdepth);
+	}
+
+	for (int i = 0; i < scenario.cylinders.size(); i++) {
+		const cylinder_t *cyl = &job.dive.cylinder[i];
+		cylinders.append(QJsonObject {
+			{ "gas", get_gas_string(cyl->gasmix) },
+			{ "gas_used", cyl->gas_used.mliter / 1000.0 },
+			{ "deco_gas_used", cyl->deco_gas_used.mliter / 1000.0 },
+			{ "start_pressure", cyl->start.mbar / 1000.0 },
+			{ "end_pressure", cyl->end.mbar / 1000.0 }
+		});
+	}
+
+	return QJsonObject {
+		{ "name", scenario.name },
+		{ "deco_mode", scenario.deco_mode == VPMB ? "vpmb" : "buehlmann" },
+		{ "gflow", scenario.gflow },
+		{ "gfhigh", scenario.gfhigh },
+		{ "conservatism", scenario.conservatism },
+		{ "max_depth", maxdepth / 1000.0 },
+		{ "duration", (int)job.dive.dc.duration.seconds },
+		{ "segments", runtime },
+		{ "stops", stops },
+		{ "cylinders", cylinders },
+		{ "minimum_gas", minimum_gas / 1000.0 }
+	};
+}
+
+void write_batch_plans_csv(QTextStream &out, const QJsonArray &results)
+{
+	out << "name,deco_mode,gflow,gfhigh,conservatism,max_depth,bottom_time,runtime,stops,gas_used\n";
+	for (const QJsonValue &value: results) {
+		QJsonObject result = value.toObject();
+		QStringList stops, gases;
+		int bottom_time = 0;
+
+		for (const QJsonValue &segment: result.value("segments").toArray()) {
+			if (segment.toObject().value("entered").toBool())
+				bottom_time = segment.toObject().value("runtime").toInt();
+		}
+		for (const QJsonValue &stop: result.value("stops").toArray())
+			stops.append(QString("%1m %2").arg(stop.toObject().value("depth").toDouble()).arg(format_time(stop.toObject().value("time").toInt())));
+		for (const QJsonValue &cylinder: result.value("cylinders").toArray())
+			gases.append(QString("%1 %2l").arg(cylinder.toObject().value("gas").toString()).arg(lrint(cylinder.toObject().value("gas_used").toDouble())));
+
+		out << "\"" << result.value("name").toString().replace("\"", "\"\"") << "\","
+		    << result.value("deco_mode").toString() << ","
+		    << result.value("gflow").toInt() << ","
+		    << result.value("gfhigh").toInt() << ","
+		    << result.value("conservatism").toInt() << ","
+		    << result.value("max_depth").toDouble() << ","
+		    << format_time(bottom_time) << ","
+		    << format_time(result.value("duration").toInt()) << ","
+		    << "\"" << stops.join("; ") << "\","
+		    << "\"" << gases.join("; ") << "\"\n";
+	}
+}
+
+// Call this from the main thread, the workers only run plan()
+bool run_batch_plans(const QJsonObject &scenarioFile, QJsonArray &results, QStringList &errors)
+{
+	apply_settings(scenarioFile.value("settings").toObject());
+
+	QVector<Scenario> scenarios;
+	QJsonArray entries = scenarioFile.value("scenarios").toArray();
+	if (entries.isEmpty())
+		errors.append("no scenarios");
+	for (int i = 0; i < entries.size(); i++) {
+		if (!entries.at(i).isObject())
+			errors.append(QString("scenario %1: not a JSON object").arg(i + 1));
+		else
+			expand_scenario(entries.at(i).toObject(), i + 1, scenarios, errors);
+	}
+
+	// The dives and plans are set up here, so that the workers only run plan()
+	QVector<PlanJob> jobs(scenarios.size());
+	for (int i = 0; i < scenarios.size(); i++) {
+		jobs[i].scenario = scenarios[i];
+		setup_job(jobs[i], errors);
+	}
+
+	if (errors.isEmpty()) {
+		// the deco mode of each plan is in its deco state, so they can all run at once
+		QtConcurrent::blockingMap(jobs, run_job);
+		for (const PlanJob &job: jobs)
+			results.append(job_to_json(job));
+	}
+
+	for (PlanJob &job: jobs) {
+		free_dps(&job.diveplan);
+		clear_dive(&job.dive);
+	}
+	return errors.isEmpty();
+}
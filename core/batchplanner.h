@@ -0,0 +1,17 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef BATCHPLANNER_H
+#define BATCHPLANNER_H
+
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QStringList>
+
+class QTextStream;
+
+// Calculate all plans of a scenario file (see batchplanner.cpp for the format) on the
+// global thread pool. If a scenario is invalid nothing is calculated, the function
+// returns false and errors has a line per problem, starting with the scenario name.
+bool run_batch_plans(const QJsonObject &scenarioFile, QJsonArray &results, QStringList &errors);
+void write_batch_plans_csv(QTextStream &out, const QJsonArray &results);
+
+#endif // BATCHPLANNER_H
@@ -10,8 +10,10 @@
  *
  * add_segment()	- add <seconds> at the given pressure, breathing gasmix
  * deco_allowed_depth() - ceiling based on lead tissue, surface pressure, 3m increments or smooth
- * set_gf()		- set Buehlmann gradient factors
- * set_vpmb_conservatism() - set VPM-B conservatism value
+ * set_gf()		- set default Buehlmann gradient factors
+ * set_vpmb_conservatism() - set default VPM-B conservatism value
+ * init_deco_parameters() - use the default parameters for a deco state
+ * set_deco_parameters() - use other parameters for a deco state
  * clear_deco()
  * cache_deco_state()
  * restore_deco_state()
@@ -23,6 +25,9 @@
 #include <assert.h>
 #include "core/planner.h"
 #include "qthelper.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #define cube(x) (x * x * x)
 
@@ -31,9 +36,8 @@
 // was introduced in v4.6.3 this can be set to a value of 1.0 which means no correction.
 #define subsurface_conservatism_factor 1.0
 
-extern int plot_depth;
-
 //! Option structure for Buehlmann decompression.
+//! gf_high and gf_low are only the defaults, see init_deco_parameters().
 struct buehlmann_config {
 	double satmult;			//! safety at inert gas accumulation as percentage of effect (more than 100).
 	double desatmult;		//! safety at inert gas depletion as percentage of effect (less than 100).
@@ -62,7 +66,7 @@ struct vpmb_config {
 	double skin_compression_gammaC;   //! Skin compression gammaC (N / bar = m2).
 	double regeneration_time;         //! Time needed for the bubble to regenerate to the start radius (min).
 	double other_gases_pressure;      //! Always present pressure of other gasses in tissues (bar).
-	short conservatism;		  //! VPM-B conservatism level (0-4)
+	short conservatism;		  //! VPM-B conservatism level (0-4), default
 };
 
 struct vpmb_config vpmb_config = {
@@ -146,26 +150,27 @@ const double vpmb_conservatism_lvls[] = { 1.0, 1.05, 1.12, 1.22, 1.35 };
 #define WV_PRESSURE 0.0627 		// water vapor pressure in bar, based on respiratory quotient Rq = 1.0 (Buhlmann value)
 #define WV_PRESSURE_SCHREINER 0.0493	// water vapor pressure in bar, based on respiratory quotient Rq = 0.8 (Schreiner value)
 
+static double wv_pressure(const struct deco_state *ds)
+{
+	return (ds->params.planner && ds->params.deco_mode == VPMB) ? WV_PRESSURE_SCHREINER : WV_PRESSURE;
+}
+
 #define DECO_STOPS_MULTIPLIER_MM 3000.0
 #define NITROGEN_FRACTION 0.79
 
 #define TISSUE_ARRAY_SZ sizeof(ds->tissue_n2_sat)
 
-int  sum1;
-long sumx, sumxx;
-double sumy, sumxy;
-
-double get_crit_radius_He()
+static double get_crit_radius_He(const struct deco_state *ds)
 {
-	if (vpmb_config.conservatism <= 4)
-		return vpmb_config.crit_radius_He * vpmb_conservatism_lvls[vpmb_config.conservatism] * subsurface_conservatism_factor;
+	if (ds->params.vpmb_conservatism <= 4)
+		return vpmb_config.crit_radius_He * vpmb_conservatism_lvls[ds->params.vpmb_conservatism] * subsurface_conservatism_factor;
 	return vpmb_config.crit_radius_He;
 }
 
-double get_crit_radius_N2()
+static double get_crit_radius_N2(const struct deco_state *ds)
 {
-	if (vpmb_config.conservatism <= 4)
-		return vpmb_config.crit_radius_N2 * vpmb_conservatism_lvls[vpmb_config.conservatism] * subsurface_conservatism_factor;
+	if (ds->params.vpmb_conservatism <= 4)
+		return vpmb_config.crit_radius_N2 * vpmb_conservatism_lvls[ds->params.vpmb_conservatism] * subsurface_conservatism_factor;
 	return vpmb_config.crit_radius_N2;
 }
 
@@ -217,48 +222,143 @@ double vpmb_tolerated_ambient_pressure(struct deco_state *ds, double reference_p
 	return ds->tissue_n2_sat[ci] + ds->tissue_he_sat[ci] + vpmb_config.other_gases_pressure - total_gradient;
 }
 
+/*
+ * The Buehlmann a and b coefficients of each compartment, weighted by
+ * its N2 and He loading. With SSE2 two compartments are done at a time;
+ * the operations are the same as in the scalar loop, so are the results.
+ */
+static void mix_buehlmann_coefficients(struct deco_state *ds)
+{
+	int ci;
+#if defined(__SSE2__)
+	for (ci = 0; ci < 16; ci += 2) {
+		__m128d n2 = _mm_loadu_pd(ds->tissue_n2_sat + ci);
+		__m128d he = _mm_loadu_pd(ds->tissue_he_sat + ci);
+		__m128d sat = _mm_loadu_pd(ds->tissue_inertgas_saturation + ci);
+		__m128d a = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(buehlmann_N2_a + ci), n2), _mm_mul_pd(_mm_loadu_pd(buehlmann_He_a + ci), he));
+		__m128d b = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(buehlmann_N2_b + ci), n2), _mm_mul_pd(_mm_loadu_pd(buehlmann_He_b + ci), he));
+		_mm_storeu_pd(ds->buehlmann_inertgas_a + ci, _mm_div_pd(a, sat));
+		_mm_storeu_pd(ds->buehlmann_inertgas_b + ci, _mm_div_pd(b, sat));
+	}
+#else
+	for (ci = 0; ci < 16; ci++) {
+		ds->buehlmann_inertgas_a[ci] = ((buehlmann_N2_a[ci] * ds->tissue_n2_sat[ci]) + (buehlmann_He_a[ci] * ds->tissue_he_sat[ci])) / ds->tissue_inertgas_saturation[ci];
+		ds->buehlmann_inertgas_b[ci] = ((buehlmann_N2_b[ci] * ds->tissue_n2_sat[ci]) + (buehlmann_He_b[ci] * ds->tissue_he_sat[ci])) / ds->tissue_inertgas_saturation[ci];
+	}
+#endif
+}
+
+/*
+ * The lowest ceiling of each compartment with gf_low, without the running
+ * maximum so that it can be done two compartments at a time with SSE2.
+ */
+static void gf_low_ceilings(const struct deco_state *ds, double gf_low, double ceiling[16])
+{
+	int ci;
+#if defined(__SSE2__)
+	const __m128d one = _mm_set1_pd(1.0);
+	const __m128d gf_lo = _mm_set1_pd(gf_low);
+
+	for (ci = 0; ci < 16; ci += 2) {
+		__m128d a = _mm_loadu_pd(ds->buehlmann_inertgas_a + ci);
+		__m128d b = _mm_loadu_pd(ds->buehlmann_inertgas_b + ci);
+		__m128d sat = _mm_loadu_pd(ds->tissue_inertgas_saturation + ci);
+		__m128d num = _mm_sub_pd(_mm_mul_pd(b, sat), _mm_mul_pd(_mm_mul_pd(gf_lo, a), b));
+		__m128d den = _mm_add_pd(_mm_mul_pd(_mm_sub_pd(one, b), gf_lo), b);
+		_mm_storeu_pd(ceiling + ci, _mm_div_pd(num, den));
+	}
+#else
+	for (ci = 0; ci < 16; ci++)
+		ceiling[ci] = (ds->buehlmann_inertgas_b[ci] * ds->tissue_inertgas_saturation[ci] - gf_low * ds->buehlmann_inertgas_a[ci] * ds->buehlmann_inertgas_b[ci]) /
+			      ((1.0 - ds->buehlmann_inertgas_b[ci]) * gf_low + ds->buehlmann_inertgas_b[ci]);
+#endif
+}
+
+/*
+ * The tolerated pressure of each compartment between gf_low at the deepest
+ * ceiling and gf_high at the surface, and whether the compartment limits
+ * the ceiling at all. The running maximum is left to the caller, so that
+ * SSE2 can do two compartments at a time; the selection between the two
+ * cases is a compare mask. Same operations in the same order as the
+ * scalar loop, so the results are identical.
+ */
+static void gf_tolerated_pressures(const struct deco_state *ds, double gf_low, double gf_high, double surface,
+				   double tolerated[16], bool limits[16])
+{
+	int ci;
+	double gf_low_pressure = ds->gf_low_pressure_this_dive;
+#if defined(__SSE2__)
+	const __m128d sign = _mm_set1_pd(-0.0);
+	const __m128d one = _mm_set1_pd(1.0);
+	const __m128d gf_lo = _mm_set1_pd(gf_low);
+	const __m128d gf_hi = _mm_set1_pd(gf_high);
+	const __m128d surf = _mm_set1_pd(surface);
+	const __m128d glp = _mm_set1_pd(gf_low_pressure);
+	const __m128d gf_diff = _mm_set1_pd(gf_high - gf_low);
+	const __m128d num_gf = _mm_set1_pd(gf_high * gf_low_pressure - gf_low * surface);
+	const __m128d den_gf = _mm_set1_pd(gf_low * gf_low_pressure - gf_high * surface);
+	const __m128d glp_surf = _mm_set1_pd(gf_low_pressure - surface);
+
+	for (ci = 0; ci < 16; ci += 2) {
+		__m128d a = _mm_loadu_pd(ds->buehlmann_inertgas_a + ci);
+		__m128d b = _mm_loadu_pd(ds->buehlmann_inertgas_b + ci);
+		__m128d sat = _mm_loadu_pd(ds->tissue_inertgas_saturation + ci);
+		__m128d minus_ab = _mm_xor_pd(_mm_mul_pd(a, b), sign);
+		__m128d one_b = _mm_sub_pd(one, b);
+		__m128d at_surface = _mm_add_pd(_mm_mul_pd(_mm_sub_pd(_mm_add_pd(_mm_div_pd(surf, b), a), surf), gf_hi), surf);
+		__m128d at_gf_low = _mm_add_pd(_mm_mul_pd(_mm_sub_pd(_mm_add_pd(_mm_div_pd(glp, b), a), glp), gf_lo), glp);
+		__m128d num = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(minus_ab, num_gf),
+						    _mm_mul_pd(_mm_mul_pd(_mm_mul_pd(one_b, gf_diff), glp), surf)),
+					 _mm_mul_pd(_mm_mul_pd(b, glp_surf), sat));
+		__m128d den = _mm_add_pd(_mm_add_pd(_mm_mul_pd(minus_ab, gf_diff), _mm_mul_pd(one_b, den_gf)),
+					 _mm_mul_pd(b, glp_surf));
+		int mask = _mm_movemask_pd(_mm_cmplt_pd(at_surface, at_gf_low));
+
+		_mm_storeu_pd(tolerated + ci, _mm_div_pd(num, den));
+		limits[ci] = mask & 1;
+		limits[ci + 1] = (mask >> 1) & 1;
+	}
+#else
+	for (ci = 0; ci < 16; ci++) {
+		double a = ds->buehlmann_inertgas_a[ci];
+		double b = ds->buehlmann_inertgas_b[ci];
+
+		limits[ci] = (surface / b + a - surface) * gf_high + surface < (gf_low_pressure / b + a - gf_low_pressure) * gf_low + gf_low_pressure;
+		tolerated[ci] = (-a * b * (gf_high * gf_low_pressure - gf_low * surface) -
+				 (1.0 - b) * (gf_high - gf_low) * gf_low_pressure * surface +
+				 b * (gf_low_pressure - surface) * ds->tissue_inertgas_saturation[ci]) /
+				(-a * b * (gf_high - gf_low) +
+				 (1.0 - b) * (gf_low * gf_low_pressure - gf_high * surface) +
+				 b * (gf_low_pressure - surface));
+	}
+#endif
+}
 
 double tissue_tolerance_calc(struct deco_state *ds, const struct dive *dive, double pressure)
 {
 	int ci = -1;
 	double ret_tolerance_limit_ambient_pressure = 0.0;
-	double gf_high = buehlmann_config.gf_high;
-	double gf_low = buehlmann_config.gf_low;
+	double gf_high = ds->params.gf_high;
+	double gf_low = ds->params.gf_low;
 	double surface = get_surface_pressure_in_mbar(dive, true) / 1000.0;
 	double lowest_ceiling = 0.0;
-	double tissue_lowest_ceiling[16];
+	double tissue_ceiling[16];
+	bool tissue_limits[16];
 
-	for (ci = 0; ci < 16; ci++) {
-		ds->buehlmann_inertgas_a[ci] = ((buehlmann_N2_a[ci] * ds->tissue_n2_sat[ci]) + (buehlmann_He_a[ci] * ds->tissue_he_sat[ci])) / ds->tissue_inertgas_saturation[ci];
-		ds->buehlmann_inertgas_b[ci] = ((buehlmann_N2_b[ci] * ds->tissue_n2_sat[ci]) + (buehlmann_He_b[ci] * ds->tissue_he_sat[ci])) / ds->tissue_inertgas_saturation[ci];
-	}
+	mix_buehlmann_coefficients(ds);
 
-	if (decoMode() != VPMB) {
+	if (ds->params.deco_mode != VPMB) {
+		/* tolerated = (tissue_inertgas_saturation - buehlmann_inertgas_a) * buehlmann_inertgas_b; */
+		gf_low_ceilings(ds, gf_low, tissue_ceiling);
 		for (ci = 0; ci < 16; ci++) {
-
-			/* tolerated = (tissue_inertgas_saturation - buehlmann_inertgas_a) * buehlmann_inertgas_b; */
-
-			tissue_lowest_ceiling[ci] = (ds->buehlmann_inertgas_b[ci] * ds->tissue_inertgas_saturation[ci] - gf_low * ds->buehlmann_inertgas_a[ci] * ds->buehlmann_inertgas_b[ci]) /
-						     ((1.0 - ds->buehlmann_inertgas_b[ci]) * gf_low + ds->buehlmann_inertgas_b[ci]);
-			if (tissue_lowest_ceiling[ci] > lowest_ceiling)
-				lowest_ceiling = tissue_lowest_ceiling[ci];
-			if (lowest_ceiling > ds->gf_low_pressure_this_dive)
-				ds->gf_low_pressure_this_dive = lowest_ceiling;
+			if (tissue_ceiling[ci] > lowest_ceiling)
+				lowest_ceiling = tissue_ceiling[ci];
 		}
+		if (lowest_ceiling > ds->gf_low_pressure_this_dive)
+			ds->gf_low_pressure_this_dive = lowest_ceiling;
+		gf_tolerated_pressures(ds, gf_low, gf_high, surface, tissue_ceiling, tissue_limits);
 		for (ci = 0; ci < 16; ci++) {
-			double tolerated;
-
-			if ((surface / ds->buehlmann_inertgas_b[ci] + ds->buehlmann_inertgas_a[ci] - surface) * gf_high + surface <
-			    (ds->gf_low_pressure_this_dive / ds->buehlmann_inertgas_b[ci] + ds->buehlmann_inertgas_a[ci] - ds->gf_low_pressure_this_dive) * gf_low + ds->gf_low_pressure_this_dive)
-				tolerated = (-ds->buehlmann_inertgas_a[ci] * ds->buehlmann_inertgas_b[ci] * (gf_high * ds->gf_low_pressure_this_dive - gf_low * surface) -
-					     (1.0 - ds->buehlmann_inertgas_b[ci]) * (gf_high - gf_low) * ds->gf_low_pressure_this_dive * surface +
-					     ds->buehlmann_inertgas_b[ci] * (ds->gf_low_pressure_this_dive - surface) * ds->tissue_inertgas_saturation[ci]) /
-					    (-ds->buehlmann_inertgas_a[ci] * ds->buehlmann_inertgas_b[ci] * (gf_high - gf_low) +
-					     (1.0 - ds->buehlmann_inertgas_b[ci]) * (gf_low * ds->gf_low_pressure_this_dive - gf_high * surface) +
-					     ds->buehlmann_inertgas_b[ci] * (ds->gf_low_pressure_this_dive - surface));
-			else
-				tolerated = ret_tolerance_limit_ambient_pressure;
-
+			double tolerated = tissue_limits[ci] ? tissue_ceiling[ci] : ret_tolerance_limit_ambient_pressure;
 
 			ds->tolerated_by_tissue[ci] = tolerated;
 
@@ -287,21 +387,23 @@ double tissue_tolerance_calc(struct deco_state *ds, const struct dive *dive, dou
 		// We are doing ok if the gradient was computed within ten centimeters of the ceiling.
 		} while (fabs(ret_tolerance_limit_ambient_pressure - reference_pressure) > 0.01);
 
-		if (plot_depth) {
-			++sum1;
-			sumx += plot_depth;
-			sumxx += plot_depth * plot_depth;
+		if (ds->regression.plot_depth) {
+			struct deco_regression *r = &ds->regression;
+			int plot_depth = r->plot_depth;
+			++r->sum1;
+			r->sumx += plot_depth;
+			r->sumxx += plot_depth * plot_depth;
 			double n2_gradient, he_gradient, total_gradient;
-			n2_gradient = update_gradient(ds, depth_to_bar(plot_depth, &displayed_dive), ds->bottom_n2_gradient[ds->ci_pointing_to_guiding_tissue]);
-			he_gradient = update_gradient(ds, depth_to_bar(plot_depth, &displayed_dive), ds->bottom_he_gradient[ds->ci_pointing_to_guiding_tissue]);
+			n2_gradient = update_gradient(ds, depth_to_bar(plot_depth, dive), ds->bottom_n2_gradient[ds->ci_pointing_to_guiding_tissue]);
+			he_gradient = update_gradient(ds, depth_to_bar(plot_depth, dive), ds->bottom_he_gradient[ds->ci_pointing_to_guiding_tissue]);
 			total_gradient = ((n2_gradient * ds->tissue_n2_sat[ds->ci_pointing_to_guiding_tissue]) + (he_gradient * ds->tissue_he_sat[ds->ci_pointing_to_guiding_tissue]))
 					/ (ds->tissue_n2_sat[ds->ci_pointing_to_guiding_tissue] + ds->tissue_he_sat[ds->ci_pointing_to_guiding_tissue]);
 
-			double buehlmann_gradient = (1.0 / ds->buehlmann_inertgas_b[ds->ci_pointing_to_guiding_tissue] - 1.0) * depth_to_bar(plot_depth, &displayed_dive) + ds->buehlmann_inertgas_a[ds->ci_pointing_to_guiding_tissue];
+			double buehlmann_gradient = (1.0 / ds->buehlmann_inertgas_b[ds->ci_pointing_to_guiding_tissue] - 1.0) * depth_to_bar(plot_depth, dive) + ds->buehlmann_inertgas_a[ds->ci_pointing_to_guiding_tissue];
 			double gf = (total_gradient - vpmb_config.other_gases_pressure) / buehlmann_gradient;
-			sumxy += gf * plot_depth;
-			sumy += gf;
-			plot_depth = 0;
+			r->sumxy += gf * plot_depth;
+			r->sumy += gf;
+			r->plot_depth = 0;
 		}
 	}
 	return ret_tolerance_limit_ambient_pressure;
@@ -310,16 +412,12 @@ double tissue_tolerance_calc(struct deco_state *ds, const struct dive *dive, dou
 /*
  * Return buelman factor for a particular period and tissue index.
  *
- * We cache the factor, since we commonly call this with the
- * same values... We have a special "fixed cache" for the one second
- * case, although I wonder if that's even worth it considering the
- * more general-purpose cache.
+ * There is a special "fixed cache" for the one second case. Other
+ * periods are computed; add_segment() keeps the factors of the last
+ * segment length in the deco state, so this is rarely called.
  */
-
-
-double factor(int period_in_seconds, int ci, enum inertgas gas)
+static double factor(int period_in_seconds, int ci, enum inertgas gas)
 {
-	double factor;
 	if (period_in_seconds == 1) {
 		if (gas == N2)
 			return buehlmann_N2_factor_expositon_one_second[ci];
@@ -327,22 +425,16 @@ double factor(int period_in_seconds, int ci, enum inertgas gas)
 			return buehlmann_He_factor_expositon_one_second[ci];
 	}
 
-	factor = cache_value(ci, period_in_seconds, gas);
-	if (!factor) {
-		// ln(2)/60 = 1.155245301e-02
-		if (gas == N2)
-			factor = 1 - exp(-period_in_seconds * 1.155245301e-02 / buehlmann_N2_t_halflife[ci]);
-		else
-			factor = 1 - exp(-period_in_seconds * 1.155245301e-02 / buehlmann_He_t_halflife[ci]);
-		cache_insert(ci, period_in_seconds, gas, factor);
-	}
-
-	return factor;
+	// ln(2)/60 = 1.155245301e-02
+	if (gas == N2)
+		return 1 - exp(-period_in_seconds * 1.155245301e-02 / buehlmann_N2_t_halflife[ci]);
+	else
+		return 1 - exp(-period_in_seconds * 1.155245301e-02 / buehlmann_He_t_halflife[ci]);
 }
 
-double calc_surface_phase(double surface_pressure, double he_pressure, double n2_pressure, double he_time_constant, double n2_time_constant)
+static double calc_surface_phase(const struct deco_state *ds, double surface_pressure, double he_pressure, double n2_pressure, double he_time_constant, double n2_time_constant)
 {
-	double inspired_n2 = (surface_pressure - ((in_planner() && (decoMode() == VPMB)) ? WV_PRESSURE_SCHREINER : WV_PRESSURE)) * NITROGEN_FRACTION;
+	double inspired_n2 = (surface_pressure - wv_pressure(ds)) * NITROGEN_FRACTION;
 
 	if (n2_pressure > inspired_n2)
 		return (he_pressure / he_time_constant + (n2_pressure - inspired_n2) / n2_time_constant) / (he_pressure + n2_pressure - inspired_n2);
@@ -375,7 +467,7 @@ void vpmb_next_gradient(struct deco_state *ds, double deco_time, double surface_
 	deco_time /= 60.0;
 
 	for (ci = 0; ci < 16; ++ci) {
-		desat_time = deco_time + calc_surface_phase(surface_pressure, ds->tissue_he_sat[ci], ds->tissue_n2_sat[ci], log(2.0) / buehlmann_He_t_halflife[ci], log(2.0) / buehlmann_N2_t_halflife[ci]);
+		desat_time = deco_time + calc_surface_phase(ds, surface_pressure, ds->tissue_he_sat[ci], ds->tissue_n2_sat[ci], log(2.0) / buehlmann_He_t_halflife[ci], log(2.0) / buehlmann_N2_t_halflife[ci]);
 
 		n2_b = ds->initial_n2_gradient[ci] + (vpmb_config.crit_volume_lambda * vpmb_config.surface_tension_gamma) / (vpmb_config.skin_compression_gammaC * desat_time);
 		he_b = ds->initial_he_gradient[ci] + (vpmb_config.crit_volume_lambda * vpmb_config.surface_tension_gamma) / (vpmb_config.skin_compression_gammaC * desat_time);
@@ -419,11 +511,11 @@ void nuclear_regeneration(struct deco_state *ds, double time)
 	double crushing_radius_N2, crushing_radius_He;
 	for (ci = 0; ci < 16; ++ci) {
 		//rm
-		crushing_radius_N2 = 1.0 / (ds->max_n2_crushing_pressure[ci] / (2.0 * (vpmb_config.skin_compression_gammaC - vpmb_config.surface_tension_gamma)) + 1.0 / get_crit_radius_N2());
-		crushing_radius_He = 1.0 / (ds->max_he_crushing_pressure[ci] / (2.0 * (vpmb_config.skin_compression_gammaC - vpmb_config.surface_tension_gamma)) + 1.0 / get_crit_radius_He());
+		crushing_radius_N2 = 1.0 / (ds->max_n2_crushing_pressure[ci] / (2.0 * (vpmb_config.skin_compression_gammaC - vpmb_config.surface_tension_gamma)) + 1.0 / get_crit_radius_N2(ds));
+		crushing_radius_He = 1.0 / (ds->max_he_crushing_pressure[ci] / (2.0 * (vpmb_config.skin_compression_gammaC - vpmb_config.surface_tension_gamma)) + 1.0 / get_crit_radius_He(ds));
 		//rs
-		ds->n2_regen_radius[ci] = crushing_radius_N2 + (get_crit_radius_N2() - crushing_radius_N2) * (1.0 - exp (-time / vpmb_config.regeneration_time));
-		ds->he_regen_radius[ci] = crushing_radius_He + (get_crit_radius_He() - crushing_radius_He) * (1.0 - exp (-time / vpmb_config.regeneration_time));
+		ds->n2_regen_radius[ci] = crushing_radius_N2 + (get_crit_radius_N2(ds) - crushing_radius_N2) * (1.0 - exp (-time / vpmb_config.regeneration_time));
+		ds->he_regen_radius[ci] = crushing_radius_He + (get_crit_radius_He(ds) - crushing_radius_He) * (1.0 - exp (-time / vpmb_config.regeneration_time));
 	}
 }
 
@@ -464,8 +556,8 @@ void calc_crushing_pressure(struct deco_state *ds, double pressure)
 			if (ds->max_ambient_pressure >= pressure)
 				return;
 
-			n2_inner_pressure = calc_inner_pressure(get_crit_radius_N2(), ds->crushing_onset_tension[ci], pressure);
-			he_inner_pressure = calc_inner_pressure(get_crit_radius_He(), ds->crushing_onset_tension[ci], pressure);
+			n2_inner_pressure = calc_inner_pressure(get_crit_radius_N2(ds), ds->crushing_onset_tension[ci], pressure);
+			he_inner_pressure = calc_inner_pressure(get_crit_radius_He(ds), ds->crushing_onset_tension[ci], pressure);
 
 			n2_crushing_pressure = pressure - n2_inner_pressure;
 			he_crushing_pressure = pressure - he_inner_pressure;
@@ -476,34 +568,319 @@ void calc_crushing_pressure(struct deco_state *ds, double pressure)
 	ds->max_ambient_pressure = MAX(pressure, ds->max_ambient_pressure);
 }
 
-/* add period_in_seconds at the given pressure and gas to the deco calculation */
-void add_segment(struct deco_state *ds, double pressure, const struct gasmix *gasmix, int period_in_seconds, int ccpo2, const struct dive *dive, int sac)
+/*
+ * Consecutive segments mostly have the same length, so the deco state
+ * remembers the factors of the last one instead of computing them for
+ * every compartment and gas each time.
+ */
+static void update_segment_factors(struct deco_state *ds, int period_in_seconds)
 {
-	(void) sac;
 	int ci;
-	struct gas_pressures pressures;
 
-	fill_pressures(&pressures, pressure - ((in_planner() && (decoMode() == VPMB)) ? WV_PRESSURE_SCHREINER : WV_PRESSURE),
-		       gasmix, (double) ccpo2 / 1000.0, dive->dc.divemode);
+	if (ds->factor_period == period_in_seconds)
+		return;
+	for (ci = 0; ci < 16; ci++) {
+		ds->n2_factor[ci] = factor(period_in_seconds, ci, N2);
+		ds->he_factor[ci] = factor(period_in_seconds, ci, HE);
+	}
+	ds->factor_period = period_in_seconds;
+}
 
+/*
+ * Move the tissue loadings towards the inspired inert gas pressures. With
+ * SSE2 two compartments are done at a time, selecting the saturation or
+ * desaturation multiplier through a compare mask. Same operations in the
+ * same order as the scalar loop, so the results are identical.
+ */
+static void load_tissues(struct deco_state *ds, double pn2, double phe)
+{
+	int ci;
+#if defined(__SSE2__)
+	const __m128d zero = _mm_setzero_pd();
+	const __m128d satmult = _mm_set1_pd(buehlmann_config.satmult);
+	const __m128d desatmult = _mm_set1_pd(buehlmann_config.desatmult);
+	const __m128d n2 = _mm_set1_pd(pn2);
+	const __m128d he = _mm_set1_pd(phe);
+
+	for (ci = 0; ci < 16; ci += 2) {
+		__m128d n2_sat = _mm_loadu_pd(ds->tissue_n2_sat + ci);
+		__m128d he_sat = _mm_loadu_pd(ds->tissue_he_sat + ci);
+		__m128d pn2_oversat = _mm_sub_pd(n2, n2_sat);
+		__m128d phe_oversat = _mm_sub_pd(he, he_sat);
+		__m128d n2_up = _mm_cmpgt_pd(pn2_oversat, zero);
+		__m128d he_up = _mm_cmpgt_pd(phe_oversat, zero);
+		__m128d n2_satmult = _mm_or_pd(_mm_and_pd(n2_up, satmult), _mm_andnot_pd(n2_up, desatmult));
+		__m128d he_satmult = _mm_or_pd(_mm_and_pd(he_up, satmult), _mm_andnot_pd(he_up, desatmult));
+
+		n2_sat = _mm_add_pd(n2_sat, _mm_mul_pd(_mm_mul_pd(n2_satmult, pn2_oversat), _mm_loadu_pd(ds->n2_factor + ci)));
+		he_sat = _mm_add_pd(he_sat, _mm_mul_pd(_mm_mul_pd(he_satmult, phe_oversat), _mm_loadu_pd(ds->he_factor + ci)));
+		_mm_storeu_pd(ds->tissue_n2_sat + ci, n2_sat);
+		_mm_storeu_pd(ds->tissue_he_sat + ci, he_sat);
+		_mm_storeu_pd(ds->tissue_inertgas_saturation + ci, _mm_add_pd(n2_sat, he_sat));
+	}
+#else
 	for (ci = 0; ci < 16; ci++) {
-		double pn2_oversat = pressures.n2 - ds->tissue_n2_sat[ci];
-		double phe_oversat = pressures.he - ds->tissue_he_sat[ci];
-		double n2_f = factor(period_in_seconds, ci, N2);
-		double he_f = factor(period_in_seconds, ci, HE);
+		double pn2_oversat = pn2 - ds->tissue_n2_sat[ci];
+		double phe_oversat = phe - ds->tissue_he_sat[ci];
 		double n2_satmult = pn2_oversat > 0 ? buehlmann_config.satmult : buehlmann_config.desatmult;
 		double he_satmult = phe_oversat > 0 ? buehlmann_config.satmult : buehlmann_config.desatmult;
 
-		ds->tissue_n2_sat[ci] += n2_satmult * pn2_oversat * n2_f;
-		ds->tissue_he_sat[ci] += he_satmult * phe_oversat * he_f;
+		ds->tissue_n2_sat[ci] += n2_satmult * pn2_oversat * ds->n2_factor[ci];
+		ds->tissue_he_sat[ci] += he_satmult * phe_oversat * ds->he_factor[ci];
 		ds->tissue_inertgas_saturation[ci] = ds->tissue_n2_sat[ci] + ds->tissue_he_sat[ci];
-
 	}
-	if (decoMode() == VPMB)
+#endif
+}
+
+/* the inert gas pressures that add_segment() loads the tissues with */
+static void inspired_pressures(const struct deco_state *ds, struct gas_pressures *pressures, double pressure, const struct gasmix *gasmix, int ccpo2, const struct dive *dive)
+{
+	fill_pressures(pressures, pressure - wv_pressure(ds), gasmix, (double) ccpo2 / 1000.0, dive->dc.divemode);
+}
+
+/* add period_in_seconds at the given pressure and gas to the deco calculation */
+void add_segment(struct deco_state *ds, double pressure, const struct gasmix *gasmix, int period_in_seconds, int ccpo2, const struct dive *dive, int sac)
+{
+	(void) sac;
+	struct gas_pressures pressures;
+
+	inspired_pressures(ds, &pressures, pressure, gasmix, ccpo2, dive);
+	update_segment_factors(ds, period_in_seconds);
+	load_tissues(ds, pressures.n2, pressures.he);
+	if (ds->params.deco_mode == VPMB)
 		calc_crushing_pressure(ds, pressure);
 	return;
 }
 
+/*
+ * Buehlmann segments can be folded into one linear map of the loading of
+ * every compartment, sat -> mult * sat + add, as the saturation and the
+ * desaturation multipliers are the same. The sequence can then be applied
+ * to any deco state at the cost of a single segment. The results differ
+ * from adding the segments one by one only by rounding.
+ */
+void clear_deco_sequence(struct deco_sequence *seq)
+{
+	int ci;
+
+	for (ci = 0; ci < 16; ci++) {
+		seq->n2_mult[ci] = seq->he_mult[ci] = 1.0;
+		seq->n2_add[ci] = seq->he_add[ci] = 0.0;
+	}
+}
+
+/* ds only gives the model parameters, the sequence applies to any state with the same ones */
+void add_segment_to_sequence(const struct deco_state *ds, struct deco_sequence *seq, double pressure, const struct gasmix *gasmix, int period_in_seconds, int ccpo2, const struct dive *dive)
+{
+	struct gas_pressures pressures;
+	int ci;
+
+	inspired_pressures(ds, &pressures, pressure, gasmix, ccpo2, dive);
+	for (ci = 0; ci < 16; ci++) {
+		double n2_f = buehlmann_config.satmult * factor(period_in_seconds, ci, N2);
+		double he_f = buehlmann_config.satmult * factor(period_in_seconds, ci, HE);
+
+		seq->n2_mult[ci] *= 1.0 - n2_f;
+		seq->n2_add[ci] = seq->n2_add[ci] * (1.0 - n2_f) + pressures.n2 * n2_f;
+		seq->he_mult[ci] *= 1.0 - he_f;
+		seq->he_add[ci] = seq->he_add[ci] * (1.0 - he_f) + pressures.he * he_f;
+	}
+}
+
+void add_deco_sequence(struct deco_state *ds, const struct deco_sequence *seq)
+{
+	int ci;
+
+	for (ci = 0; ci < 16; ci++) {
+		ds->tissue_n2_sat[ci] = seq->n2_mult[ci] * ds->tissue_n2_sat[ci] + seq->n2_add[ci];
+		ds->tissue_he_sat[ci] = seq->he_mult[ci] * ds->tissue_he_sat[ci] + seq->he_add[ci];
+		ds->tissue_inertgas_saturation[ci] = ds->tissue_n2_sat[ci] + ds->tissue_he_sat[ci];
+	}
+}
+
+/* is the loading over the gf_high M-value at the surface, i.e. is there a Buehlmann ceiling? */
+static bool over_surface_m_value(int ci, double n2, double he, double gf, double surface_pressure)
+{
+	double sat = n2 + he;
+	double a = (buehlmann_N2_a[ci] * n2 + buehlmann_He_a[ci] * he) / sat;
+	double b = (buehlmann_N2_b[ci] * n2 + buehlmann_He_b[ci] * he) / sat;
+
+	return sat > surface_pressure + gf * (surface_pressure / b + a - surface_pressure);
+}
+
+/*
+ * Seconds at the given pressure and gas until a Buehlmann ceiling appears,
+ * max_time if that takes longer. The tissue loadings at a constant pressure
+ * follow the Haldane equation, so for a compartment that only carries
+ * nitrogen the time to reach the M-value is found by inverting it. With
+ * helium, the loading of the compartment is checked after every stepsize
+ * seconds instead, as the two gases move at different rates.
+ */
+double ndl_time(const struct deco_state *ds, double pressure, const struct gasmix *gasmix, int ccpo2, const struct dive *dive, double surface_pressure, int stepsize, int max_time)
+{
+	struct gas_pressures pressures;
+	double gf = ds->params.gf_high;
+	double ndl = max_time;
+	int ci;
+
+	inspired_pressures(ds, &pressures, pressure, gasmix, ccpo2, dive);
+	for (ci = 0; ci < 16; ci++) {
+		double n2 = ds->tissue_n2_sat[ci];
+		double he = ds->tissue_he_sat[ci];
+		double n2_end = n2 + (pressures.n2 - n2) * (pressures.n2 > n2 ? buehlmann_config.satmult : buehlmann_config.desatmult);
+		double he_end = he + (pressures.he - he) * (pressures.he > he ? buehlmann_config.satmult : buehlmann_config.desatmult);
+		// ln(2)/60 = 1.155245301e-02
+		double n2_rate = 1.155245301e-02 / buehlmann_N2_t_halflife[ci];
+		double he_rate = 1.155245301e-02 / buehlmann_He_t_halflife[ci];
+		double t;
+
+		if (he == 0.0 && pressures.he == 0.0) {
+			double m_value = surface_pressure + gf * (surface_pressure / buehlmann_N2_b[ci] + buehlmann_N2_a[ci] - surface_pressure);
+
+			if (n2 >= m_value)
+				t = 0.0;
+			else if (n2_end <= m_value)
+				continue;
+			else
+				t = -log((n2_end - m_value) / (n2_end - n2)) / n2_rate;
+		} else {
+			double n2_step = exp(-stepsize * n2_rate);
+			double he_step = exp(-stepsize * he_rate);
+			double n2_left = n2 - n2_end;
+			double he_left = he - he_end;
+
+			for (t = stepsize; t < ndl; t += stepsize) {
+				n2_left *= n2_step;
+				he_left *= he_step;
+				if (over_surface_m_value(ci, n2_end + n2_left, he_end + he_left, gf, surface_pressure))
+					break;
+			}
+		}
+		if (t < ndl)
+			ndl = t;
+	}
+	return ndl;
+}
+
+/*
+ * For the a and b coefficients of the given loadings, the pressure that
+ * tissue_tolerance_calc() finds tolerated by a Buehlmann compartment is
+ * linear in its loading: tolerated = c0 + c1 * (n2 + he). Returns false if
+ * the compartment does not limit the ceiling at all.
+ */
+static bool tolerance_line(const struct deco_state *ds, int ci, double n2, double he, double surface, double *c0, double *c1)
+{
+	double gf_high = ds->params.gf_high;
+	double gf_low = ds->params.gf_low;
+	double gf_low_pressure = ds->gf_low_pressure_this_dive;
+	double sat = n2 + he;
+	double a = (buehlmann_N2_a[ci] * n2 + buehlmann_He_a[ci] * he) / sat;
+	double b = (buehlmann_N2_b[ci] * n2 + buehlmann_He_b[ci] * he) / sat;
+	double denominator = -a * b * (gf_high - gf_low) + (1.0 - b) * (gf_low * gf_low_pressure - gf_high * surface) + b * (gf_low_pressure - surface);
+
+	if ((surface / b + a - surface) * gf_high + surface >= (gf_low_pressure / b + a - gf_low_pressure) * gf_low + gf_low_pressure)
+		return false;
+	*c0 = (-a * b * (gf_high * gf_low_pressure - gf_low * surface) - (1.0 - b) * (gf_high - gf_low) * gf_low_pressure * surface) / denominator;
+	*c1 = b * (gf_low_pressure - surface) / denominator;
+	return true;
+}
+
+/* the tolerated pressure of a compartment, which is loaded with A + B * E and then goes through the ascent */
+static double tolerated_after_ascent(const struct deco_state *ds, int ci, const struct deco_sequence *ascent, double surface,
+				     double n2_a, double n2_b, double n2_e, double he_a, double he_b, double he_e)
+{
+	double n2 = ascent->n2_mult[ci] * (n2_a + n2_b * n2_e) + ascent->n2_add[ci];
+	double he = ascent->he_mult[ci] * (he_a + he_b * he_e) + ascent->he_add[ci];
+	double c0, c1;
+
+	if (!tolerance_line(ds, ci, n2, he, surface, &c0, &c1))
+		return 0.0;
+	return c0 + c1 * (n2 + he);
+}
+
+/* The highest tolerated ambient pressure that deco_allowed_depth() (smoothed) does not put below depth */
+static double deco_allowed_pressure(int depth, double surface_pressure, const struct dive *dive)
+{
+	double specific_weight = dive->dc.salinity ? dive->dc.salinity / 10000.0 * 0.981 : 1.03 * 0.981;
+	int mbar;
+
+	/* any ceiling shallower than the last stop is put at the last stop */
+	if (depth < buehlmann_config.last_deco_stop_in_mtr * 1000)
+		depth = 0;
+	/* the largest whole mbar that rel_mbar_to_depth() rounds to no more than the cm of depth */
+	mbar = (int)ceil((depth / 10 + 0.5) * specific_weight) - 1;
+	return surface_pressure + (mbar + 0.5) / 1000.0;
+}
+
+/*
+ * Seconds at the given pressure and gas until the ascent folded into the
+ * sequence ends below the Buehlmann ceiling at target_depth, max_time if
+ * that takes longer. This is a prediction for the planner: the gradient
+ * factor anchor of the deco state is taken as fixed and the checks during
+ * the ascent are left to a trial ascent.
+ *
+ * At a constant pressure the loadings follow the Haldane equation, so for
+ * a compartment that only carries nitrogen the time its tolerated pressure
+ * takes to drop to the one at target_depth is found by inverting it. With
+ * helium the ratio of the gases, and with it the a and b coefficients,
+ * changes over the stop, so that time is found by bisection instead.
+ */
+double clear_time(const struct deco_state *ds, double pressure, const struct gasmix *gasmix, int ccpo2, const struct dive *dive,
+		  const struct deco_sequence *ascent, int target_depth, double surface_pressure, int max_time)
+{
+	struct gas_pressures pressures;
+	double surface = get_surface_pressure_in_mbar(dive, true) / 1000.0;
+	double target = deco_allowed_pressure(target_depth, surface_pressure, dive);
+	double clear = 0.0;
+	int ci;
+
+	inspired_pressures(ds, &pressures, pressure, gasmix, ccpo2, dive);
+	for (ci = 0; ci < 16; ci++) {
+		double n2 = ds->tissue_n2_sat[ci];
+		double he = ds->tissue_he_sat[ci];
+		// The loadings after t seconds at the stop are A + B * exp(-rate * t)
+		double n2_mult = pressures.n2 > n2 ? buehlmann_config.satmult : buehlmann_config.desatmult;
+		double he_mult = pressures.he > he ? buehlmann_config.satmult : buehlmann_config.desatmult;
+		double n2_a = n2 + n2_mult * (pressures.n2 - n2);
+		double n2_b = n2_mult * (n2 - pressures.n2);
+		double he_a = he + he_mult * (pressures.he - he);
+		double he_b = he_mult * (he - pressures.he);
+		// ln(2)/60 = 1.155245301e-02
+		double n2_rate = 1.155245301e-02 / buehlmann_N2_t_halflife[ci];
+		double he_rate = 1.155245301e-02 / buehlmann_He_t_halflife[ci];
+		double t;
+
+		if (tolerated_after_ascent(ds, ci, ascent, surface, n2_a, n2_b, 1.0, he_a, he_b, 1.0) <= target)
+			continue;
+		if (tolerated_after_ascent(ds, ci, ascent, surface, n2_a, n2_b, exp(-max_time * n2_rate), he_a, he_b, exp(-max_time * he_rate)) > target)
+			return max_time;
+
+		if (he == 0.0 && pressures.he == 0.0) {
+			double c0, c1;
+
+			if (!tolerance_line(ds, ci, 1.0, 0.0, surface, &c0, &c1) || c1 <= 0.0 || n2_b <= 0.0)
+				return max_time;
+			// The loading after the ascent may be at most (target - c0) / c1
+			double n2_e = ((target - c0) / c1 - ascent->n2_add[ci]) / ascent->n2_mult[ci];
+			t = -log((n2_e - n2_a) / n2_b) / n2_rate;
+		} else {
+			double lo = 0.0, hi = max_time;
+
+			while (hi - lo > 0.01) {
+				t = (lo + hi) / 2.0;
+				if (tolerated_after_ascent(ds, ci, ascent, surface, n2_a, n2_b, exp(-t * n2_rate), he_a, he_b, exp(-t * he_rate)) > target)
+					lo = t;
+				else
+					hi = t;
+			}
+			t = hi;
+		}
+		if (t > clear)
+			clear = t;
+	}
+	return clear;
+}
+
 #if DECO_CALC_DEBUG
 void dump_tissues(struct deco_state *ds)
 {
@@ -529,20 +906,28 @@ void clear_vpmb_state(struct deco_state *ds) {
 	ds->max_bottom_ceiling_pressure.mbar = 0;
 }
 
+/*
+ * Start a deco state from surface saturation. The model parameters of
+ * the state are kept: set them with init_deco_parameters() or
+ * set_deco_parameters() before.
+ */
 void clear_deco(struct deco_state *ds, double surface_pressure)
 {
 	int ci;
+	memset(&ds->regression, 0, sizeof(ds->regression));
 	clear_vpmb_state(ds);
 	for (ci = 0; ci < 16; ci++) {
-		ds->tissue_n2_sat[ci] = (surface_pressure - ((in_planner() && (decoMode() == VPMB)) ? WV_PRESSURE_SCHREINER : WV_PRESSURE)) * N2_IN_AIR / 1000;
+		ds->tissue_n2_sat[ci] = (surface_pressure - wv_pressure(ds)) * N2_IN_AIR / 1000;
 		ds->tissue_he_sat[ci] = 0.0;
+		ds->tissue_inertgas_saturation[ci] = ds->tissue_n2_sat[ci];
 		ds->max_n2_crushing_pressure[ci] = 0.0;
 		ds->max_he_crushing_pressure[ci] = 0.0;
-		ds->n2_regen_radius[ci] = get_crit_radius_N2();
-		ds->he_regen_radius[ci] = get_crit_radius_He();
+		ds->n2_regen_radius[ci] = get_crit_radius_N2(ds);
+		ds->he_regen_radius[ci] = get_crit_radius_He(ds);
 	}
 	ds->gf_low_pressure_this_dive = surface_pressure + buehlmann_config.gf_low_position_min;
 	ds->max_ambient_pressure = 0.0;
+	ds->factor_period = 0;
 }
 
 void cache_deco_state(struct deco_state *src, struct deco_state **cached_datap)
@@ -556,8 +941,14 @@ void cache_deco_state(struct deco_state *src, struct deco_state **cached_datap)
 	*data = *src;
 }
 
+/*
+ * The gradient factor regression of the target is kept: it is collected
+ * across the trial ascents that the planner undoes with this.
+ */
 void restore_deco_state(struct deco_state *data, struct deco_state *target, bool keep_vpmb_state)
 {
+	struct deco_regression regression = target->regression;
+
 	if (keep_vpmb_state) {
 		int ci;
 		for (ci = 0; ci < 16; ci++) {
@@ -570,7 +961,7 @@ void restore_deco_state(struct deco_state *data, struct deco_state *target, bool
 		data->max_bottom_ceiling_pressure = target->max_bottom_ceiling_pressure;
 	}
 	*target = *data;
-
+	target->regression = regression;
 }
 
 int deco_allowed_depth(double tissues_tolerance, double surface_pressure, struct dive *dive, bool smooth)
@@ -600,21 +991,50 @@ void set_gf(short gflow, short gfhigh)
 		buehlmann_config.gf_high = (double)gfhigh / 100.0;
 }
 
-void set_vpmb_conservatism(short conservatism)
+static short clamp_vpmb_conservatism(short conservatism)
 {
 	if (conservatism < 0)
-		vpmb_config.conservatism = 0;
-	else if (conservatism > 4)
-		vpmb_config.conservatism = 4;
-	else
-		vpmb_config.conservatism = conservatism;
+		return 0;
+	if (conservatism > 4)
+		return 4;
+	return conservatism;
+}
+
+void set_vpmb_conservatism(short conservatism)
+{
+	vpmb_config.conservatism = clamp_vpmb_conservatism(conservatism);
+}
+
+/*
+ * The gradient factors and VPM-B conservatism set in the preferences and the
+ * deco model of the application state. This is the only place that looks at
+ * the application state, so call it on the GUI thread and hand the state to
+ * calculations on other threads.
+ */
+void init_deco_parameters(struct deco_state *ds)
+{
+	ds->params.gf_low = buehlmann_config.gf_low;
+	ds->params.gf_high = buehlmann_config.gf_high;
+	ds->params.vpmb_conservatism = vpmb_config.conservatism;
+	ds->params.planner = in_planner();
+	ds->params.deco_mode = decoMode();
+}
+
+/* Other parameters than the defaults, -1 keeps a gradient factor like for set_gf() */
+void set_deco_parameters(struct deco_state *ds, short gflow, short gfhigh, short conservatism)
+{
+	if (gflow != -1)
+		ds->params.gf_low = (double)gflow / 100.0;
+	if (gfhigh != -1)
+		ds->params.gf_high = (double)gfhigh / 100.0;
+	ds->params.vpmb_conservatism = clamp_vpmb_conservatism(conservatism);
 }
 
 double get_gf(struct deco_state *ds, double ambpressure_bar, const struct dive *dive)
 {
 	double surface_pressure_bar = get_surface_pressure_in_mbar(dive, true) / 1000.0;
-	double gf_low = buehlmann_config.gf_low;
-	double gf_high = buehlmann_config.gf_high;
+	double gf_low = ds->params.gf_low;
+	double gf_high = ds->params.gf_high;
 	double gf;
 	if (ds->gf_low_pressure_this_dive > surface_pressure_bar)
 		gf = MAX((double)gf_low, (ambpressure_bar - surface_pressure_bar) /
@@ -624,30 +1044,32 @@ double get_gf(struct deco_state *ds, double ambpressure_bar, const struct dive *
 	return gf;
 }
 
-double regressiona()
+double regressiona(const struct deco_state *ds)
 {
-	if (sum1 > 1) {
-		double avxy = sumxy / sum1;
-		double avx = (double)sumx / sum1;
-		double avy = sumy / sum1;
-		double avxx = (double) sumxx / sum1;
+	const struct deco_regression *r = &ds->regression;
+
+	if (r->sum1 > 1) {
+		double avxy = r->sumxy / r->sum1;
+		double avx = (double)r->sumx / r->sum1;
+		double avy = r->sumy / r->sum1;
+		double avxx = (double) r->sumxx / r->sum1;
 		return (avxy - avx * avy) / (avxx - avx*avx);
 	}
 	else
 		return 0.0;
 }
 
-double regressionb()
+double regressionb(const struct deco_state *ds)
 {
-	if (sum1)
-		return sumy / sum1 - sumx * regressiona() / sum1;
+	const struct deco_regression *r = &ds->regression;
+
+	if (r->sum1)
+		return r->sumy / r->sum1 - r->sumx * regressiona(ds) / r->sum1;
 	else
 		return 0.0;
 }
 
-void reset_regression()
+void reset_regression(struct deco_state *ds)
 {
-	sum1 = 0;
-	sumxx = sumx = 0L;
-	sumy = sumxy = 0.0;
+	memset(&ds->regression, 0, sizeof(ds->regression));
 }
@@ -26,6 +26,9 @@ struct plot_info {
 	double endtempcoord;
 	double maxpp;
 	struct plot_data *entry;
+	int nr_cylinders;
+	struct plot_pressure_data *pressures;	/* nr_cylinders per entry */
+	int *ceilings, *percentages;		/* 16 per entry, NULL unless calculated */
 };
 
 typedef enum {
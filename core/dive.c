@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <ctype.h>
 #include "gettext.h"
 #include "dive.h"
 #include "libdivecomputer.h"
@@ -13,6 +14,7 @@
 #include "qthelper.h"
 #include "metadata.h"
 #include "membuffer.h"
+#include "strndup.h"
 
 /* one could argue about the best place to have this variable -
  * it's used in the UI, but it seems to make the most sense to have it
@@ -1742,7 +1744,7 @@ struct dive *fixup_dive(struct dive *dive)
 	/* we should always have a uniq ID as that gets assigned during alloc_dive(),
 	 * but we want to make sure... */
 	if (!dive->id)
-		dive->id = dive_getUniqID(dive);
+		set_dive_id(dive, dive_getUniqID(dive));
 
 	return dive;
 }
@@ -3178,68 +3180,384 @@ void dump_taglist(const char *intro, struct tag_entry *tl)
 	fprintf(stderr, "\n");
 }
 
-// count the dives where the tag list contains the given tag
-int count_dives_with_tag(const char *tag)
+/*
+ * Inverted index from the tags, the buddies and divemasters, the locations
+ * and the suits to the dives using them. For each kind of value it keeps
+ * the distinct values sorted by their lookup key, each with the ascending
+ * table indexes of its dives, plus the list of dives that have no value of
+ * that kind at all. People are compared trimmed and case insensitively, like
+ * string_sequence_contains() does, everything else as exact strings.
+ *
+ * Like the time index the inverted index is rebuilt lazily, after
+ * invalidate_dive_value_index() is called whenever the dive table is
+ * changed or marked as changed. The edits of the tags, people, location
+ * or suit of dives in the table all end in mark_divelist_changed(), the
+ * copies of dives (displayed_dive, the planner's) don't touch the index.
+ */
+struct dive_value_entry {
+	char *name;	/* the spelling used by the first dive that has it */
+	char *key;	/* either name or one of the keys of the list */
+	int nr;
+	int *dives;
+};
+
+struct dive_value_list {
+	int nr;
+	struct dive_value_entry *entries;
+	int nr_empty;
+	int *empty;
+	int *pool;	/* storage for the dive lists of all entries */
+	int nr_keys, allocated_keys;
+	char **keys;	/* storage for the keys that differ from the names */
+};
+
+static struct {
+	struct dive_value_list lists[DIVE_VALUE_KINDS];
+	int generation;
+	bool valid;
+} dive_value_index;
+
+/* one (value, dive) pair, collected while the index is built */
+struct dive_value_posting {
+	char *name, *key;
+	int idx;
+};
+
+struct dive_value_postings {
+	int nr, allocated;
+	struct dive_value_posting *postings;
+};
+
+/*
+ * The same people show up on many dives, so while the index is built
+ * every distinct spelling is case folded only once.
+ */
+struct casefold_cache {
+	int size, nr;
+	char **names;
+	char **keys;
+};
+
+static unsigned int casefold_hash(const char *name, int size)
 {
-	int i, counter = 0;
-	struct dive *d;
+	uint32_t hash = 2166136261u;
 
-	for_each_dive (i, d) {
-		if (empty_string(tag)) {
-			// count dives with no tags
-			if (d->tag_list == NULL)
-				counter++;
-		} else if (taglist_contains(d->tag_list, tag)) {
-			counter++;
+	while (*name)
+		hash = (hash ^ (unsigned char)*name++) * 16777619u;
+	return hash & (size - 1);
+}
+
+static void casefold_cache_insert(struct casefold_cache *cache, char *name, char *key)
+{
+	unsigned int h;
+
+	for (h = casefold_hash(name, cache->size); cache->names[h]; h = (h + 1) & (cache->size - 1))
+		;
+	cache->names[h] = name;
+	cache->keys[h] = key;
+	cache->nr++;
+}
+
+/* the key of a person, which stays owned by the list */
+static char *casefold_person(struct casefold_cache *cache, struct dive_value_list *list, const char *name)
+{
+	unsigned int h;
+	char *key;
+
+	if (2 * (cache->nr + 1) > cache->size) {
+		struct casefold_cache old = *cache;
+		int i;
+
+		cache->size = old.size ? old.size * 2 : 64;
+		cache->nr = 0;
+		cache->names = calloc(cache->size, sizeof(char *));
+		cache->keys = calloc(cache->size, sizeof(char *));
+		if (!cache->names || !cache->keys)
+			exit(1);
+		for (i = 0; i < old.size; i++)
+			if (old.names[i])
+				casefold_cache_insert(cache, old.names[i], old.keys[i]);
+		free(old.names);
+		free(old.keys);
+	}
+	for (h = casefold_hash(name, cache->size); cache->names[h]; h = (h + 1) & (cache->size - 1))
+		if (!strcmp(cache->names[h], name))
+			return cache->keys[h];
+
+	key = casefold_string(name);
+	if (list->nr_keys >= list->allocated_keys) {
+		list->allocated_keys = (list->nr_keys + 32) * 3 / 2;
+		list->keys = realloc(list->keys, list->allocated_keys * sizeof(char *));
+		if (!list->keys)
+			exit(1);
+	}
+	list->keys[list->nr_keys++] = key;
+	casefold_cache_insert(cache, strdup(name), key);
+	return key;
+}
+
+static void free_casefold_cache(struct casefold_cache *cache)
+{
+	int i;
+
+	for (i = 0; i < cache->size; i++)
+		free(cache->names[i]);
+	free(cache->names);
+	free(cache->keys);
+}
+
+void invalidate_dive_value_index(void)
+{
+	dive_value_index.valid = false;
+}
+
+static void add_dive_value_posting(struct dive_value_postings *p, char *name, char *key, int idx)
+{
+	if (p->nr >= p->allocated) {
+		p->allocated = (p->nr + 32) * 3 / 2;
+		p->postings = realloc(p->postings, p->allocated * sizeof(struct dive_value_posting));
+		if (!p->postings)
+			exit(1);
+	}
+	p->postings[p->nr].name = name;
+	p->postings[p->nr].key = key;
+	p->postings[p->nr].idx = idx;
+	p->nr++;
+}
+
+static void add_dive_value(struct dive_value_postings *p, const char *name, int idx)
+{
+	char *copy = strdup(name);
+	add_dive_value_posting(p, copy, copy, idx);
+}
+
+/* split a comma separated list of people and add every one of them */
+static void add_dive_persons(struct dive_value_postings *p, struct casefold_cache *cache, struct dive_value_list *list,
+			     const char *persons, int idx)
+{
+	while (!empty_string(persons)) {
+		const char *end = strchr(persons, ',');
+		int len = end ? end - persons : (int)strlen(persons);
+		char *name, *key;
+
+		while (len > 0 && isspace((unsigned char)*persons)) {
+			persons++;
+			len--;
 		}
+		while (len > 0 && isspace((unsigned char)persons[len - 1]))
+			len--;
+		if (len > 0) {
+			name = strndup(persons, len);
+			key = casefold_person(cache, list, name);
+			if (*key)
+				add_dive_value_posting(p, name, key, idx);
+			else
+				free(name);
+		}
+		persons = end ? end + 1 : NULL;
 	}
-	return counter;
 }
 
-extern bool string_sequence_contains(const char *string_sequence, const char *text);
+static int dive_value_posting_cmp(const void *_a, const void *_b)
+{
+	const struct dive_value_posting *a = _a, *b = _b;
+	int cmp = strcmp(a->key, b->key);
 
-// count the dives where the person is included in the comma separated string sequences of buddies or divemasters
-int count_dives_with_person(const char *person)
+	return cmp ? cmp : a->idx - b->idx;
+}
+
+static void clear_dive_value_list(struct dive_value_list *list)
 {
-	int i, counter = 0;
-	struct dive *d;
+	int i;
 
-	for_each_dive (i, d) {
-		if (empty_string(person)) {
-			// solo dive
-			if (empty_string(d->buddy) && empty_string(d->divemaster))
-				counter++;
-		} else if (string_sequence_contains(d->buddy, person) || string_sequence_contains(d->divemaster, person)) {
-			counter++;
+	for (i = 0; i < list->nr; i++)
+		free(list->entries[i].name);
+	for (i = 0; i < list->nr_keys; i++)
+		free(list->keys[i]);
+	free(list->keys);
+	free(list->entries);
+	free(list->empty);
+	free(list->pool);
+	memset(list, 0, sizeof(*list));
+}
+
+/* sort the postings and turn every run with the same key into one entry */
+static void fill_dive_value_list(struct dive_value_list *list, struct dive_value_postings *p)
+{
+	int i, nr = 0;
+	struct dive_value_entry *entry = NULL;
+
+	qsort(p->postings, p->nr, sizeof(struct dive_value_posting), dive_value_posting_cmp);
+	list->entries = malloc((p->nr + 1) * sizeof(struct dive_value_entry));
+	list->pool = malloc((p->nr + 1) * sizeof(int));
+	if (!list->entries || !list->pool)
+		exit(1);
+	for (i = 0; i < p->nr; i++) {
+		struct dive_value_posting *posting = p->postings + i;
+
+		if (!entry || strcmp(entry->key, posting->key)) {
+			entry = list->entries + list->nr++;
+			entry->name = posting->name;
+			entry->key = posting->key;
+			entry->nr = 0;
+			entry->dives = list->pool + nr;
+		} else {
+			free(posting->name);
+			/* the same person as buddy and divemaster, for example */
+			if (entry->dives[entry->nr - 1] == posting->idx)
+				continue;
 		}
+		entry->dives[entry->nr++] = posting->idx;
+		nr++;
 	}
-	return counter;
+	p->nr = 0;
 }
 
-// count the dives with exactly the location
-int count_dives_with_location(const char *location)
+static void update_dive_value_index(void)
 {
-	int i, counter = 0;
+	int i, kind;
 	struct dive *d;
+	struct dive_value_postings postings[DIVE_VALUE_KINDS] = { { 0 } };
+	struct casefold_cache cache = { 0 };
 
+	if (dive_value_index.valid)
+		return;
+	for (kind = 0; kind < DIVE_VALUE_KINDS; kind++) {
+		struct dive_value_list *list = dive_value_index.lists + kind;
+		clear_dive_value_list(list);
+		list->empty = malloc((dive_table.nr + 1) * sizeof(int));
+		if (!list->empty)
+			exit(1);
+	}
 	for_each_dive (i, d) {
-		if (same_string(get_dive_location(d), location))
-			counter++;
+		struct dive_value_list *lists = dive_value_index.lists;
+		struct tag_entry *tl;
+		const char *location = get_dive_location(d);
+
+		for (tl = d->tag_list; tl; tl = tl->next)
+			add_dive_value(postings + DIVE_VALUE_TAG, tl->tag->name, i);
+		if (!d->tag_list)
+			lists[DIVE_VALUE_TAG].empty[lists[DIVE_VALUE_TAG].nr_empty++] = i;
+
+		add_dive_persons(postings + DIVE_VALUE_PERSON, &cache, lists + DIVE_VALUE_PERSON, d->buddy, i);
+		add_dive_persons(postings + DIVE_VALUE_PERSON, &cache, lists + DIVE_VALUE_PERSON, d->divemaster, i);
+		if (empty_string(d->buddy) && empty_string(d->divemaster))
+			lists[DIVE_VALUE_PERSON].empty[lists[DIVE_VALUE_PERSON].nr_empty++] = i;
+
+		if (!empty_string(location))
+			add_dive_value(postings + DIVE_VALUE_LOCATION, location, i);
+		else
+			lists[DIVE_VALUE_LOCATION].empty[lists[DIVE_VALUE_LOCATION].nr_empty++] = i;
+
+		if (!empty_string(d->suit))
+			add_dive_value(postings + DIVE_VALUE_SUIT, d->suit, i);
+		else
+			lists[DIVE_VALUE_SUIT].empty[lists[DIVE_VALUE_SUIT].nr_empty++] = i;
+	}
+	free_casefold_cache(&cache);
+	for (kind = 0; kind < DIVE_VALUE_KINDS; kind++) {
+		fill_dive_value_list(dive_value_index.lists + kind, postings + kind);
+		free(postings[kind].postings);
 	}
-	return counter;
+	dive_value_index.generation++;
+	dive_value_index.valid = true;
 }
 
-// count the dives with exactly the suit
-int count_dives_with_suit(const char *suit)
+/*
+ * A number that changes every time the index is rebuilt, so that users of
+ * the dive lists can tell when the dive table indexes they hold are stale.
+ */
+int get_dive_value_generation(void)
 {
-	int i, counter = 0;
-	struct dive *d;
+	update_dive_value_index();
+	return dive_value_index.generation;
+}
 
-	for_each_dive (i, d) {
-		if (same_string(d->suit, suit))
-			counter++;
+/* the number of distinct values of the given kind */
+int count_dive_values(enum dive_value_kind kind)
+{
+	update_dive_value_index();
+	return dive_value_index.lists[kind].nr;
+}
+
+/* the n-th distinct value of the given kind, in no particular display order */
+const char *get_dive_value(enum dive_value_kind kind, int n)
+{
+	update_dive_value_index();
+	if (n < 0 || n >= dive_value_index.lists[kind].nr)
+		return NULL;
+	return dive_value_index.lists[kind].entries[n].name;
+}
+
+/*
+ * Find the dives with the given value, or the dives without any value of
+ * that kind if the value is empty. Returns the number of dives and, if
+ * divesp is not NULL, points it at their ascending dive table indexes.
+ *
+ * NOTE! The returned array belongs to the index and is only valid until
+ * the dive table is changed.
+ */
+int get_dives_with_value(enum dive_value_kind kind, const char *value, const int **divesp)
+{
+	struct dive_value_list *list = dive_value_index.lists + kind;
+	char *key;
+	int lo, hi;
+
+	update_dive_value_index();
+	if (divesp)
+		*divesp = list->empty;
+	if (empty_string(value))
+		return list->nr_empty;
+
+	key = kind == DIVE_VALUE_PERSON ? casefold_string(value) : (char *)value;
+	lo = 0;
+	hi = list->nr;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		int cmp = strcmp(list->entries[mid].key, key);
+		if (!cmp) {
+			lo = mid;
+			break;
+		}
+		if (cmp < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
-	return counter;
+	if (key != value)
+		free(key);
+	if (lo >= hi) {
+		if (divesp)
+			*divesp = NULL;
+		return 0;
+	}
+	if (divesp)
+		*divesp = list->entries[lo].dives;
+	return list->entries[lo].nr;
+}
+
+// count the dives where the tag list contains the given tag
+int count_dives_with_tag(const char *tag)
+{
+	return get_dives_with_value(DIVE_VALUE_TAG, tag, NULL);
+}
+
+// count the dives where the person is included in the comma separated string sequences of buddies or divemasters
+int count_dives_with_person(const char *person)
+{
+	return get_dives_with_value(DIVE_VALUE_PERSON, person, NULL);
+}
+
+// count the dives with exactly the location
+int count_dives_with_location(const char *location)
+{
+	return get_dives_with_value(DIVE_VALUE_LOCATION, location, NULL);
+}
+
+// count the dives with exactly the suit
+int count_dives_with_suit(const char *suit)
+{
+	return get_dives_with_value(DIVE_VALUE_SUIT, suit, NULL);
 }
 
 /*
@@ -3577,19 +3895,184 @@ timestamp_t dive_endtime(const struct dive *dive)
 	return dive->when + dive_totaltime(dive);
 }
 
-struct dive *find_dive_including(timestamp_t when)
+/*
+ * Index of the dives in the dive table sorted by start time. On top of the
+ * sorted entries sits a segment tree with the largest end time of each
+ * range of entries, so that the dives overlapping a given moment can be
+ * found in O((k + 1) log n) for k matches - a single very long dive early
+ * in the log doesn't make every query walk back to it.
+ *
+ * The index is rebuilt lazily after invalidate_dive_time_index(), which is
+ * called whenever the dive table is changed or marked as changed.
+ */
+struct dive_time_entry {
+	timestamp_t when, end;
+	int idx;
+};
+
+static struct {
+	int nr, allocated;
+	struct dive_time_entry *entries;
+	/* node 1 is the root, the children of node n are 2n and 2n + 1 and
+	 * the leaves are the entries, starting at node 'size' */
+	int size;
+	timestamp_t *max_end;
+	bool valid;
+} dive_time_index;
+
+void invalidate_dive_time_index(void)
+{
+	dive_time_index.valid = false;
+}
+
+static int dive_time_entry_cmp(const void *_a, const void *_b)
+{
+	const struct dive_time_entry *a = _a, *b = _b;
+
+	if (a->when != b->when)
+		return a->when < b->when ? -1 : 1;
+	return a->idx - b->idx;
+}
+
+static void update_dive_time_index(void)
 {
 	int i;
 	struct dive *dive;
 
-	/* binary search, anyone? Too lazy for now;
-	 * also we always use the duration from the first divecomputer
-	 *     could this ever be a problem? */
+	if (dive_time_index.valid)
+		return;
+	if (dive_table.nr > dive_time_index.allocated) {
+		dive_time_index.allocated = dive_table.nr + 32;
+		free(dive_time_index.entries);
+		dive_time_index.entries = malloc(dive_time_index.allocated * sizeof(struct dive_time_entry));
+		if (!dive_time_index.entries)
+			exit(1);
+	}
 	for_each_dive (i, dive) {
-		if (dive->when <= when && when <= dive_endtime(dive))
-			return dive;
+		struct dive_time_entry *entry = dive_time_index.entries + i;
+		entry->when = dive->when;
+		entry->end = dive_endtime(dive);
+		entry->idx = i;
 	}
-	return NULL;
+	dive_time_index.nr = dive_table.nr;
+	/* the dive table is normally sorted already, so this is cheap */
+	qsort(dive_time_index.entries, dive_time_index.nr, sizeof(struct dive_time_entry), dive_time_entry_cmp);
+
+	if (!dive_time_index.max_end || dive_time_index.size < dive_time_index.nr) {
+		dive_time_index.size = 64;
+		while (dive_time_index.size < dive_time_index.nr)
+			dive_time_index.size *= 2;
+		free(dive_time_index.max_end);
+		dive_time_index.max_end = malloc(2 * dive_time_index.size * sizeof(timestamp_t));
+		if (!dive_time_index.max_end)
+			exit(1);
+	}
+	for (i = 0; i < dive_time_index.size; i++)
+		dive_time_index.max_end[dive_time_index.size + i] = i < dive_time_index.nr ? dive_time_index.entries[i].end : INT64_MIN;
+	for (i = dive_time_index.size - 1; i > 0; i--)
+		dive_time_index.max_end[i] = MAX(dive_time_index.max_end[2 * i], dive_time_index.max_end[2 * i + 1]);
+	dive_time_index.valid = true;
+}
+
+/* position of the first entry that starts after 'when' */
+static int dive_time_upper_bound(timestamp_t when)
+{
+	int lo = 0, hi = dive_time_index.nr;
+
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (dive_time_index.entries[mid].when <= when)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/*
+ * Call fn, in the order of start time, for the entries before position 'hi'
+ * that end at or after 'end'. Node covers the entries [node_lo, node_hi).
+ */
+static void for_each_dive_time_entry_ending_after(int node, int node_lo, int node_hi, int hi, timestamp_t end,
+						  void (*fn)(struct dive_time_entry *entry, void *data), void *data)
+{
+	int mid;
+
+	if (node_lo >= hi || dive_time_index.max_end[node] < end)
+		return;
+	if (node_hi - node_lo == 1) {
+		fn(dive_time_index.entries + node_lo, data);
+		return;
+	}
+	mid = (node_lo + node_hi) / 2;
+	for_each_dive_time_entry_ending_after(2 * node, node_lo, mid, hi, end, fn, data);
+	for_each_dive_time_entry_ending_after(2 * node + 1, mid, node_hi, hi, end, fn, data);
+}
+
+/* the entries that start no later than 'when' and end no earlier than 'end' */
+static void for_each_dive_time_entry_including(timestamp_t when, timestamp_t end,
+					       void (*fn)(struct dive_time_entry *entry, void *data), void *data)
+{
+	update_dive_time_index();
+	for_each_dive_time_entry_ending_after(1, 0, dive_time_index.size, dive_time_upper_bound(when), end, fn, data);
+}
+
+struct dives_including {
+	int nr, allocated;
+	struct dive **dives;
+};
+
+static void add_dive_including(struct dive_time_entry *entry, void *_match)
+{
+	struct dives_including *match = _match;
+
+	if (match->nr >= match->allocated) {
+		match->allocated = (match->nr + 16) * 3 / 2;
+		match->dives = realloc(match->dives, match->allocated * sizeof(struct dive *));
+		if (!match->dives)
+			exit(1);
+	}
+	match->dives[match->nr++] = get_dive(entry->idx);
+}
+
+/*
+ * Collect the dives that include the moment 'when', with their start and
+ * end widened by 'offset' (so time_during_dive_with_offset() is true for
+ * all of them) into an internally allocated array, sorted by start time.
+ * Returns the number of dives found.
+ *
+ * NOTE! The returned array must be freed once used.
+ */
+int find_dives_including(timestamp_t when, timestamp_t offset, struct dive ***divesp)
+{
+	struct dives_including match = { 0, 0, NULL };
+
+	for_each_dive_time_entry_including(when + offset, when - offset, add_dive_including, &match);
+	/* callers free the array even if nothing was found */
+	if (!match.dives) {
+		match.dives = malloc(sizeof(struct dive *));
+		if (!match.dives)
+			exit(1);
+	}
+	*divesp = match.dives;
+	return match.nr;
+}
+
+static void first_dive_including(struct dive_time_entry *entry, void *_best)
+{
+	int *best = _best;
+
+	if (*best < 0 || entry->idx < *best)
+		*best = entry->idx;
+}
+
+struct dive *find_dive_including(timestamp_t when)
+{
+	int best = -1;
+
+	/* like a walk through the dive table, return the first dive in table order */
+	for_each_dive_time_entry_including(when, when, first_dive_including, &best);
+	return get_dive(best);
 }
 
 bool time_during_dive_with_offset(struct dive *dive, timestamp_t when, timestamp_t offset)
@@ -3611,12 +4094,16 @@ bool dive_within_time_range(struct dive *dive, timestamp_t when, timestamp_t off
 struct dive *find_dive_n_near(timestamp_t when, int n, timestamp_t offset)
 {
 	int i, j = 0;
-	struct dive *dive;
 
-	for_each_dive (i, dive) {
-		if (dive_within_time_range(dive, when, offset))
+	/* the dives we are looking for start in [when - offset, when + offset] */
+	update_dive_time_index();
+	for (i = dive_time_upper_bound(when - offset - 1); i < dive_time_index.nr; i++) {
+		struct dive_time_entry *entry = dive_time_index.entries + i;
+		if (entry->when > when + offset)
+			break;
+		if (entry->end <= when + offset)
 			if (++j == n)
-				return dive;
+				return get_dive(entry->idx);
 	}
 	return NULL;
 }
@@ -3767,36 +4254,68 @@ bool dive_check_picture_time(struct dive *d, int shift_time, timestamp_t timesta
 
 bool picture_check_valid(const char *filename, int shift_time)
 {
-	int i;
-	struct dive *dive;
+	int i, nr;
+	bool found = false;
+	struct dive **dives;
 
 	timestamp_t timestamp = picture_get_timestamp(filename);
-	for_each_dive (i, dive)
-		if (dive->selected && dive_check_picture_time(dive, shift_time, timestamp))
-			return true;
-	return false;
+	if (!timestamp)
+		return false;
+	nr = find_dives_including(timestamp + shift_time, D30MIN, &dives);
+	for (i = 0; i < nr && !found; i++)
+		found = dives[i]->selected && dive_check_picture_time(dives[i], shift_time, timestamp);
+	free(dives);
+	return found;
 }
 
-void dive_create_picture(struct dive *dive, const char *filename, int shift_time, bool match_all)
+static void create_picture_with_metadata(struct dive *dive, const char *filename, int shift_time, bool match_all, const struct metadata *metadata)
 {
-	struct metadata metadata;
-	get_metadata(filename, &metadata);
 	if (!new_picture_for_dive(dive, filename))
 		return;
-	if (!match_all && !dive_check_picture_time(dive, shift_time, metadata.timestamp))
+	if (!match_all && !dive_check_picture_time(dive, shift_time, metadata->timestamp))
 		return;
 
 	struct picture *picture = alloc_picture();
 	picture->filename = strdup(filename);
-	picture->offset.seconds = metadata.timestamp - dive->when + shift_time;
-	picture->longitude = metadata.longitude;
-	picture->latitude = metadata.latitude;
+	picture->offset.seconds = metadata->timestamp - dive->when + shift_time;
+	picture->longitude = metadata->longitude;
+	picture->latitude = metadata->latitude;
 
 	dive_add_picture(dive, picture);
 	dive_set_geodata_from_picture(dive, picture);
 	invalidate_dive_cache(dive);
 }
 
+/* add the picture to all the selected dives it belongs to (or simply all selected dives if match_all) */
+void create_picture_for_selected_dives(const char *filename, int shift_time, bool match_all)
+{
+	int i, nr;
+	struct dive *dive, **dives;
+	struct metadata metadata;
+
+	get_metadata(filename, &metadata);
+	if (match_all) {
+		for_each_dive (i, dive)
+			if (dive->selected)
+				create_picture_with_metadata(dive, filename, shift_time, true, &metadata);
+		return;
+	}
+	if (!metadata.timestamp)
+		return;
+	nr = find_dives_including(metadata.timestamp + shift_time, D30MIN, &dives);
+	for (i = 0; i < nr; i++)
+		if (dives[i]->selected)
+			create_picture_with_metadata(dives[i], filename, shift_time, false, &metadata);
+	free(dives);
+}
+
+void dive_create_picture(struct dive *dive, const char *filename, int shift_time, bool match_all)
+{
+	struct metadata metadata;
+	get_metadata(filename, &metadata);
+	create_picture_with_metadata(dive, filename, shift_time, match_all, &metadata);
+}
+
 void dive_add_picture(struct dive *dive, struct picture *newpic)
 {
 	struct picture **pic_ptr = &dive->picture_list;
@@ -3822,8 +4341,7 @@ void dive_set_geodata_from_picture(struct dive *dive, struct picture *picture)
 	struct dive_site *ds = get_dive_site_by_uuid(dive->dive_site_uuid);
 	if (!dive_site_has_gps_location(ds) && (picture->latitude.udeg || picture->longitude.udeg)) {
 		if (ds) {
-			ds->latitude = picture->latitude;
-			ds->longitude = picture->longitude;
+			set_dive_site_gps(ds, picture->latitude, picture->longitude);
 		} else {
 			dive->dive_site_uuid = create_dive_site_with_gps("", picture->latitude, picture->longitude, dive->when);
 			invalidate_dive_cache(dive);
@@ -69,6 +69,7 @@ static inline char *copy_string(const char *s)
 
 #include "sha1.h"
 #include "units.h"
+#include "pref.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -284,6 +285,20 @@ int count_dives_with_person(const char *person);
 int count_dives_with_location(const char *location);
 int count_dives_with_suit(const char *suit);
 
+/* the kinds of values kept in the inverted index of the dive table */
+enum dive_value_kind {
+	DIVE_VALUE_TAG,
+	DIVE_VALUE_PERSON,	/* buddies and divemasters */
+	DIVE_VALUE_LOCATION,
+	DIVE_VALUE_SUIT,
+	DIVE_VALUE_KINDS
+};
+
+int count_dive_values(enum dive_value_kind kind);
+const char *get_dive_value(enum dive_value_kind kind, int n);
+int get_dives_with_value(enum dive_value_kind kind, const char *value, const int **divesp);
+int get_dive_value_generation(void);
+
 struct extra_data {
 	const char *key;
 	const char *value;
@@ -358,6 +373,8 @@ struct dive {
 	bool selected;
 	bool hidden_by_filter;
 	bool downloaded;
+	bool cylinder_info_valid; /* sac, otu and maxcns are up to date */
+	unsigned int changes; /* bumped by invalidate_dive_cache() */
 	timestamp_t when;
 	uint32_t dive_site_uuid;
 	char *notes;
@@ -386,6 +403,8 @@ struct dive {
 static inline void invalidate_dive_cache(struct dive *dive)
 {
 	memset(dive->git_id, 0, 20);
+	dive->cylinder_info_valid = false;
+	dive->changes++;
 }
 
 static inline bool dive_cache_is_valid(const struct dive *dive)
@@ -432,6 +451,7 @@ extern struct picture *alloc_picture();
 extern struct picture *clone_picture(struct picture *src);
 extern bool dive_check_picture_time(struct dive *d, int shift_time, timestamp_t timestamp);
 extern void dive_create_picture(struct dive *d, const char *filename, int shift_time, bool match_all);
+extern void create_picture_for_selected_dives(const char *filename, int shift_time, bool match_all);
 extern void dive_add_picture(struct dive *d, struct picture *newpic);
 extern bool dive_remove_picture(struct dive *d, const char *filename);
 extern unsigned int dive_get_picture_count(struct dive *d);
@@ -473,12 +493,12 @@ static inline int calculate_depth_to_mbar(int depth, pressure_t surface_pressure
 	return mbar;
 }
 
-static inline int depth_to_mbar(int depth, struct dive *dive)
+static inline int depth_to_mbar(int depth, const struct dive *dive)
 {
 	return calculate_depth_to_mbar(depth, dive->surface_pressure, dive->salinity);
 }
 
-static inline double depth_to_bar(int depth, struct dive *dive)
+static inline double depth_to_bar(int depth, const struct dive *dive)
 {
 	return depth_to_mbar(depth, dive) / 1000.0;
 }
@@ -665,41 +685,23 @@ extern void delete_current_divecomputer(void);
 #define for_each_gps_location(_i, _x) \
 	for ((_i) = 0; ((_x) = get_gps_location(_i, &gps_location_table)) != NULL; (_i)++)
 
-static inline struct dive *get_dive_by_uniq_id(int id)
-{
-	int i;
-	struct dive *dive = NULL;
-
-	for_each_dive (i, dive) {
-		if (dive->id == id)
-			break;
-	}
-#ifdef DEBUG
-	if (dive == NULL) {
-		fprintf(stderr, "Invalid id %x passed to get_dive_by_diveid, try to fix the code\n", id);
-		exit(1);
-	}
-#endif
-	return dive;
-}
+/*
+ * Look up a dive in the dive table by its unique id. These go through
+ * a hash index that the functions changing the dive table keep up to
+ * date, so they are constant time and don't change anything. The id of
+ * a dive in the table has to be changed with set_dive_id(), copy_dive()
+ * onto a dive in the table must keep its id.
+ */
+extern struct dive *get_dive_by_uniq_id(int id);
+extern int get_idx_by_uniq_id(int id);
+extern void set_dive_id(struct dive *dive, int id);
 
-static inline int get_idx_by_uniq_id(int id)
-{
-	int i;
-	struct dive *dive = NULL;
-
-	for_each_dive (i, dive) {
-		if (dive->id == id)
-			break;
-	}
-#ifdef DEBUG
-	if (dive == NULL) {
-		fprintf(stderr, "Invalid id %x passed to get_dive_by_diveid, try to fix the code\n", id);
-		exit(1);
-	}
-#endif
-	return i;
-}
+/* Call this after changing the dive table; it rebuilds the id index and drops the time and value indexes */
+extern void invalidate_dive_indexes(void);
+/* The cheaper version of the above after appending a dive to the table */
+extern void dive_appended_to_table(void);
+extern void invalidate_dive_time_index(void);
+extern void invalidate_dive_value_index(void);
 
 static inline bool dive_site_has_gps_location(struct dive_site *ds)
 {
@@ -721,6 +723,7 @@ extern int report_error(const char *fmt, ...);
 extern void set_error_cb(void(*cb)(char *));	// Callback takes ownership of passed string
 
 extern struct dive *find_dive_including(timestamp_t when);
+extern int find_dives_including(timestamp_t when, timestamp_t offset, struct dive ***divesp);
 extern bool dive_within_time_range(struct dive *dive, timestamp_t when, timestamp_t offset);
 extern bool time_during_dive_with_offset(struct dive *dive, timestamp_t when, timestamp_t offset);
 struct dive *find_dive_n_near(timestamp_t when, int n, timestamp_t offset);
@@ -870,6 +873,23 @@ extern void subsurface_command_line_exit(int *, char ***);
 
 #define DECOTIMESTEP 60 /* seconds. Unit of deco stop times */
 
+/* model parameters of a deco calculation, see init_deco_parameters() */
+struct deco_parameters {
+	double gf_low;
+	double gf_high;
+	short vpmb_conservatism;
+	bool planner;			/* the planner uses another water vapour pressure for VPM-B */
+	enum deco_mode deco_mode;
+};
+
+/* VPM-B gradient factor regression collected by the planner, see regressiona() */
+struct deco_regression {
+	int plot_depth;
+	int sum1;
+	long sumx, sumxx;
+	double sumy, sumxy;
+};
+
 struct deco_state {
 	double tissue_n2_sat[16];
 	double tissue_he_sat[16];
@@ -896,13 +916,36 @@ struct deco_state {
 	int ci_pointing_to_guiding_tissue;
 	double gf_low_pressure_this_dive;
 	int deco_time;
+
+	/* saturation factors of the last segment length, see add_segment() */
+	int factor_period;
+	double n2_factor[16];
+	double he_factor[16];
+
+	struct deco_parameters params;
+	struct deco_regression regression;
+};
+
+/* consecutive segments folded into one tissue update, see add_segment_to_sequence() */
+struct deco_sequence {
+	double n2_mult[16];
+	double n2_add[16];
+	double he_mult[16];
+	double he_add[16];
 };
 
 extern void add_segment(struct deco_state *ds, double pressure, const struct gasmix *gasmix, int period_in_seconds, int setpoint, const struct dive *dive, int sac);
+extern void clear_deco_sequence(struct deco_sequence *seq);
+extern void add_segment_to_sequence(const struct deco_state *ds, struct deco_sequence *seq, double pressure, const struct gasmix *gasmix, int period_in_seconds, int setpoint, const struct dive *dive);
+extern void add_deco_sequence(struct deco_state *ds, const struct deco_sequence *seq);
+extern double ndl_time(const struct deco_state *ds, double pressure, const struct gasmix *gasmix, int setpoint, const struct dive *dive, double surface_pressure, int stepsize, int max_time);
+extern double clear_time(const struct deco_state *ds, double pressure, const struct gasmix *gasmix, int setpoint, const struct dive *dive, const struct deco_sequence *ascent, int target_depth, double surface_pressure, int max_time);
 extern void clear_deco(struct deco_state *ds, double surface_pressure);
 extern void dump_tissues(struct deco_state *ds);
 extern void set_gf(short gflow, short gfhigh);
 extern void set_vpmb_conservatism(short conservatism);
+extern void init_deco_parameters(struct deco_state *ds);
+extern void set_deco_parameters(struct deco_state *ds, short gflow, short gfhigh, short conservatism);
 extern void cache_deco_state(struct deco_state *source, struct deco_state **datap);
 extern void restore_deco_state(struct deco_state *data, struct deco_state *target, bool keep_vpmb_state);
 extern void nuclear_regeneration(struct deco_state *ds, double time);
@@ -933,6 +976,7 @@ struct diveplan {
 	struct divedatapoint *dp;
 	int eff_gflow, eff_gfhigh;
 	int surface_interval;
+	struct plan_cache *cache;	/* optional, see alloc_plan_cache() */
 };
 
 struct divedatapoint *plan_add_segment(struct diveplan *diveplan, int duration, int depth, int cylinderid, int po2, bool entered);
@@ -945,6 +989,8 @@ struct decostop {
 	int time;
 };
 extern bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, int timestep, struct decostop *decostoptable, struct deco_state **cached_datap, bool is_planner, bool show_disclaimer);
+extern int wait_until(struct deco_state *ds, struct dive *dive, int clock, int min, int leap, int stepsize, int depth, int target_depth, int avg_depth, int bottom_time, struct gasmix *gasmix, int po2, double surface_pressure);
+extern int stop_end_time(struct deco_state *ds, struct dive *dive, int clock, int leap, int stepsize, int depth, int target_depth, int avg_depth, int bottom_time, struct gasmix *gasmix, int po2, double surface_pressure);
 extern void calc_crushing_pressure(struct deco_state *ds, double pressure);
 extern void vpmb_start_gradient(struct deco_state *ds);
 extern void clear_vpmb_state(struct deco_state *ds);
@@ -1029,6 +1075,4 @@ extern volume_t string_to_volume(const char *str, pressure_t workp);
 extern fraction_t string_to_fraction(const char *str);
 extern void average_max_depth(struct diveplan *dive, int *avg_depth, int *max_depth);
 
-#include "pref.h"
-
 #endif // DIVE_H
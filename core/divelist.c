@@ -11,8 +11,15 @@
  * void get_dive_gas(struct dive *dive, int *o2_p, int *he_p, int *o2low_p)
  * int total_weight(struct dive *dive)
  * int get_divenr(struct dive *dive)
+ * struct dive *get_dive_by_uniq_id(int id)
+ * int get_idx_by_uniq_id(int id)
+ * void invalidate_dive_indexes(void)
+ * void dive_appended_to_table(void)
+ * void set_dive_id(struct dive *dive, int id)
+ * unsigned int get_dive_list_generation(void)
  * int init_decompression(struct dive *dive)
  * void update_cylinder_related_info(struct dive *dive)
+ * void cache_cylinder_related_info(struct dive *dive)
  * void dump_trip_list(void)
  * dive_trip_t *find_matching_trip(timestamp_t when)
  * void insert_trip(dive_trip_t **dive_trip_p)
@@ -434,16 +441,346 @@ static void add_dive_to_deco(struct deco_state *ds, struct dive *dive)
 	}
 }
 
-int get_divenr(struct dive *dive)
+/*
+ * The tissues at the end of the dives init_decompression() added to the
+ * deco state, by dive id. A snapshot is the state after a chain of dives:
+ * it is only used if the dive hasn't changed since and it continues the
+ * same chain, i.e. the snapshot of the dive before it in the chain is
+ * the one it was calculated from. Every snapshot gets a new serial number
+ * to tell the chains apart, so a changed dive invalidates the snapshots
+ * of all later dives.
+ *
+ * Not every edit of a dive bumps its change counter, so a snapshot also
+ * keeps a hash of everything add_dive_to_deco() looks at.
+ *
+ * init_decompression() runs on the threads that calculate plans and
+ * profiles, so the table is only used with lock_deco_snapshots() held.
+ */
+struct deco_snapshot {
+	int id;
+	unsigned int serial;
+	int prev_id;
+	unsigned int prev_serial;
+	unsigned int changes;
+	uint32_t content;
+	timestamp_t when, endtime;
+	int samples;
+	bool planner;
+	enum deco_mode deco_mode;
+	short vpmb_conservatism;
+	struct deco_state ds;
+};
+
+static struct {
+	int size, nr;
+	unsigned int serial;
+	struct deco_snapshot **slot;
+} deco_snapshots;
+
+static struct deco_snapshot **deco_snapshot_slot(int id)
+{
+	unsigned int h = ((uint32_t)id * 2654435761u) & (deco_snapshots.size - 1);
+
+	while (deco_snapshots.slot[h] && deco_snapshots.slot[h]->id != id)
+		h = (h + 1) & (deco_snapshots.size - 1);
+	return deco_snapshots.slot + h;
+}
+
+static struct deco_snapshot *get_deco_snapshot(int id)
+{
+	if (!deco_snapshots.size)
+		return NULL;
+	return *deco_snapshot_slot(id);
+}
+
+static struct deco_snapshot *new_deco_snapshot(int id)
+{
+	struct deco_snapshot **slot;
+
+	if (2 * (deco_snapshots.nr + 1) > deco_snapshots.size) {
+		int i, old_size = deco_snapshots.size;
+		struct deco_snapshot **old = deco_snapshots.slot;
+
+		deco_snapshots.size = old_size ? 2 * old_size : 64;
+		deco_snapshots.slot = calloc(deco_snapshots.size, sizeof(*deco_snapshots.slot));
+		if (!deco_snapshots.slot)
+			exit(1);
+		for (i = 0; i < old_size; i++) {
+			if (old[i])
+				*deco_snapshot_slot(old[i]->id) = old[i];
+		}
+		free(old);
+	}
+	slot = deco_snapshot_slot(id);
+	if (!*slot) {
+		*slot = malloc(sizeof(**slot));
+		if (!*slot)
+			exit(1);
+		deco_snapshots.nr++;
+	}
+	(*slot)->id = id;
+	return *slot;
+}
+
+/* the snapshot of a deleted dive is never used again */
+static void delete_deco_snapshot(int id)
 {
+	struct deco_snapshot **slot, *snapshot;
+	unsigned int h, mask = deco_snapshots.size - 1;
+
+	if (!deco_snapshots.size)
+		return;
+	slot = deco_snapshot_slot(id);
+	if (!*slot)
+		return;
+	free(*slot);
+	*slot = NULL;
+	deco_snapshots.nr--;
+	/* put the rest of the cluster back, so that no lookup stops at the hole */
+	for (h = (slot - deco_snapshots.slot + 1) & mask; (snapshot = deco_snapshots.slot[h]) != NULL; h = (h + 1) & mask) {
+		deco_snapshots.slot[h] = NULL;
+		*deco_snapshot_slot(snapshot->id) = snapshot;
+	}
+}
+
+static uint32_t hash_bytes(uint32_t hash, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+
+	while (len--)
+		hash = (hash ^ *p++) * 16777619u;
+	return hash;
+}
+
+#define HASH_VALUE(hash, value) hash = hash_bytes(hash, &(value), sizeof(value))
+
+/* what add_dive_to_deco() and the surface interval after the dive depend on */
+static uint32_t deco_content_hash(struct dive *dive)
+{
+	struct divecomputer *dc = &dive->dc;
+	uint32_t hash = 2166136261u;
+	const struct event *ev;
 	int i;
+
+	HASH_VALUE(hash, dive->sac);
+	HASH_VALUE(hash, dive->salinity);
+	HASH_VALUE(hash, dive->surface_pressure.mbar);
+	HASH_VALUE(hash, dc->salinity);
+	HASH_VALUE(hash, dc->surface_pressure.mbar);
+	HASH_VALUE(hash, dc->divemode);
+	for (i = 0; i < MAX_CYLINDERS; i++) {
+		HASH_VALUE(hash, dive->cylinder[i].gasmix.o2.permille);
+		HASH_VALUE(hash, dive->cylinder[i].gasmix.he.permille);
+	}
+	for (i = 0; i < dc->samples; i++) {
+		HASH_VALUE(hash, dc->sample[i].time.seconds);
+		HASH_VALUE(hash, dc->sample[i].depth.mm);
+		HASH_VALUE(hash, dc->sample[i].setpoint.mbar);
+	}
+	for (ev = dc->events; ev; ev = ev->next) {
+		HASH_VALUE(hash, ev->time.seconds);
+		HASH_VALUE(hash, ev->type);
+		HASH_VALUE(hash, ev->flags);
+		HASH_VALUE(hash, ev->value);
+		HASH_VALUE(hash, ev->gas.index);
+		HASH_VALUE(hash, ev->gas.mix.o2.permille);
+		HASH_VALUE(hash, ev->gas.mix.he.permille);
+		HASH_VALUE(hash, ev->deleted);
+	}
+	return hash;
+}
+
+#undef HASH_VALUE
+
+static bool deco_snapshot_is_valid(const struct deco_snapshot *snapshot, const struct deco_state *ds, struct dive *dive,
+				   uint32_t content, int prev_id, unsigned int prev_serial)
+{
+	return snapshot && snapshot->prev_id == prev_id && snapshot->prev_serial == prev_serial &&
+	       snapshot->changes == dive->changes && snapshot->content == content && snapshot->when == dive->when &&
+	       snapshot->endtime == dive_endtime(dive) && snapshot->samples == dive->dc.samples &&
+	       snapshot->planner == ds->params.planner && snapshot->deco_mode == ds->params.deco_mode &&
+	       snapshot->vpmb_conservatism == ds->params.vpmb_conservatism;
+}
+
+static struct deco_snapshot *save_deco_snapshot(const struct deco_state *ds, struct dive *dive, uint32_t content,
+					       int prev_id, unsigned int prev_serial)
+{
+	struct deco_snapshot *snapshot = new_deco_snapshot(dive->id);
+
+	snapshot->serial = ++deco_snapshots.serial;
+	snapshot->prev_id = prev_id;
+	snapshot->prev_serial = prev_serial;
+	snapshot->changes = dive->changes;
+	snapshot->content = content;
+	snapshot->when = dive->when;
+	snapshot->endtime = dive_endtime(dive);
+	snapshot->samples = dive->dc.samples;
+	snapshot->planner = ds->params.planner;
+	snapshot->deco_mode = ds->params.deco_mode;
+	snapshot->vpmb_conservatism = ds->params.vpmb_conservatism;
+	snapshot->ds = *ds;
+	return snapshot;
+}
+
+/* the model parameters stay the ones of the caller */
+static void restore_deco_snapshot(const struct deco_snapshot *snapshot, struct deco_state *ds)
+{
+	struct deco_parameters params = ds->params;
+
+	*ds = snapshot->ds;
+	ds->params = params;
+}
+
+/*
+ * Hash index from unique dive id to the position of the dive in the
+ * dive table. Open addressing with linear probing, an id of zero marks
+ * an empty slot (dive_getUniqID() never hands out zero).
+ *
+ * The index is kept up to date by the functions that change the dive
+ * table, on the thread that changes it: those that move dives around
+ * call invalidate_dive_indexes(), which rebuilds it, dives appended by
+ * record_dive_to_table() are added by dive_appended_to_table() and the
+ * id of a dive in the table is only changed through set_dive_id().
+ * Lookups only read the index, so the threads that calculate deco
+ * can use them while the table doesn't change.
+ */
+static struct {
+	int size, nr;
+	int *ids;
+	int *idx;
+} dive_id_index;
+
+static inline unsigned int dive_id_hash(int id)
+{
+	return ((uint32_t)id * 2654435761u) & (dive_id_index.size - 1);
+}
+
+static void add_dive_id(int id, int idx)
+{
+	unsigned int h;
+
+	if (!id)
+		return;
+	for (h = dive_id_hash(id); dive_id_index.ids[h]; h = (h + 1) & (dive_id_index.size - 1))
+		/* like a linear scan of the table, the first dive with a given id wins */
+		if (dive_id_index.ids[h] == id)
+			return;
+	dive_id_index.ids[h] = id;
+	dive_id_index.idx[h] = idx;
+	dive_id_index.nr++;
+}
+
+static void rebuild_dive_id_index(void)
+{
+	int i, size = 64;
 	struct dive *d;
+
+	while (size < 2 * dive_table.nr)
+		size *= 2;
+	if (size != dive_id_index.size) {
+		free(dive_id_index.ids);
+		free(dive_id_index.idx);
+		dive_id_index.ids = malloc(size * sizeof(int));
+		dive_id_index.idx = malloc(size * sizeof(int));
+		if (!dive_id_index.ids || !dive_id_index.idx)
+			exit(1);
+		dive_id_index.size = size;
+	}
+	memset(dive_id_index.ids, 0, size * sizeof(int));
+	dive_id_index.nr = 0;
+	for_each_dive(i, d)
+		add_dive_id(d->id, i);
+}
+
+/*
+ * Bumped whenever the dive table or the dives in it may have changed,
+ * so that caches of values derived from the dives can tell they are stale.
+ */
+static unsigned int dive_list_generation;
+
+unsigned int get_dive_list_generation(void)
+{
+	return dive_list_generation;
+}
+
+void invalidate_dive_indexes(void)
+{
+	dive_list_generation++;
+	rebuild_dive_id_index();
+	invalidate_dive_time_index();
+	invalidate_dive_value_index();
+}
+
+/* The other dives keep their place, so only the new one goes into the id index */
+void dive_appended_to_table(void)
+{
+	int idx = dive_table.nr - 1;
+
+	/* keep the load at most one half, like the rebuild does */
+	if (2 * (dive_id_index.nr + 1) > dive_id_index.size) {
+		invalidate_dive_indexes();
+		return;
+	}
+	dive_list_generation++;
+	add_dive_id(dive_table.dives[idx]->id, idx);
+	invalidate_dive_time_index();
+	invalidate_dive_value_index();
+}
+
+static int lookup_dive_idx(int id)
+{
+	unsigned int h;
+
+	if (!dive_id_index.size || !id)
+		return -1;
+	for (h = dive_id_hash(id); dive_id_index.ids[h]; h = (h + 1) & (dive_id_index.size - 1)) {
+		if (dive_id_index.ids[h] == id)
+			return dive_id_index.idx[h];
+	}
+	return -1;
+}
+
+void set_dive_id(struct dive *dive, int id)
+{
+	bool in_table = lookup_dive_idx(dive->id) >= 0;
+
+	dive->id = id;
+	if (in_table)
+		invalidate_dive_indexes();
+}
+
+struct dive *get_dive_by_uniq_id(int id)
+{
+	int idx = lookup_dive_idx(id);
+
+#ifdef DEBUG
+	if (idx < 0) {
+		fprintf(stderr, "Invalid id %x passed to get_dive_by_diveid, try to fix the code\n", id);
+		exit(1);
+	}
+#endif
+	return get_dive(idx);
+}
+
+int get_idx_by_uniq_id(int id)
+{
+	int idx = lookup_dive_idx(id);
+
+#ifdef DEBUG
+	if (idx < 0) {
+		fprintf(stderr, "Invalid id %x passed to get_dive_by_diveid, try to fix the code\n", id);
+		exit(1);
+	}
+#endif
+	return idx < 0 ? dive_table.nr : idx;
+}
+
+int get_divenr(struct dive *dive)
+{
 	// tempting as it may be, don't die when called with dive=NULL
+	// don't compare pointers, we could be passing in a copy of the dive
 	if (dive)
-		for_each_dive(i, d) {
-			if (d->id == dive->id) // don't compare pointers, we could be passing in a copy of the dive
-				return i;
-		}
+		return lookup_dive_idx(dive->id);
 	return -1;
 }
 
@@ -466,7 +803,8 @@ static struct gasmix air = { .o2.permille = O2_IN_AIR, .he.permille = 0 };
 /* return last surface time before this dive or dummy value of 48h */
 /* return negative surface time if dives are overlapping */
 /* The place you call this function is likely the place where you want
- * to create the deco_state */
+ * to create the deco_state. Its parameters have to be set before, see
+ * init_deco_parameters() */
 int init_decompression(struct deco_state *ds, struct dive *dive)
 {
 	int i, divenr = -1;
@@ -474,6 +812,11 @@ int init_decompression(struct deco_state *ds, struct dive *dive)
 	timestamp_t last_endtime = 0, last_starttime = 0;
 	bool deco_init = false;
 	double surface_pressure;
+	struct deco_snapshot *snapshot;
+	int prev_id = 0;
+	unsigned int prev_serial = 0, serial;
+	uint32_t content;
+	bool restored;
 
 	if (!dive)
 		return false;
@@ -563,42 +906,62 @@ int init_decompression(struct deco_state *ds, struct dive *dive)
 #endif
 
 		surface_pressure = get_surface_pressure_in_mbar(pdive, true) / 1000.0;
-		/* Is it the first dive we add? */
-		if (!deco_init) {
+		surface_time = pdive->when - last_endtime;
+		if (deco_init && surface_time < 0) {
 #if DECO_CALC_DEBUG & 2
-			printf("Init deco\n");
+			printf("Exit because surface intervall is %d\n", surface_time);
 #endif
-			clear_deco(ds, surface_pressure);
-			deco_init = true;
+			return surface_time;
+		}
+		content = deco_content_hash(pdive);
+		lock_deco_snapshots();
+		snapshot = get_deco_snapshot(pdive->id);
+		restored = deco_snapshot_is_valid(snapshot, ds, pdive, content, prev_id, prev_serial);
+		if (restored) {
+			restore_deco_snapshot(snapshot, ds);
+			serial = snapshot->serial;
+		}
+		unlock_deco_snapshots();
+		if (restored) {
 #if DECO_CALC_DEBUG & 2
-			printf("Tissues after init:\n");
+			printf("Tissues after dive #%d from snapshot:\n", pdive->number);
 			dump_tissues(ds);
 #endif
-		}
-		else {
-			surface_time = pdive->when - last_endtime;
-			if (surface_time < 0) {
+		} else {
+			/* Is it the first dive we add? */
+			if (!deco_init) {
 #if DECO_CALC_DEBUG & 2
-				printf("Exit because surface intervall is %d\n", surface_time);
+				printf("Init deco\n");
+#endif
+				clear_deco(ds, surface_pressure);
+#if DECO_CALC_DEBUG & 2
+				printf("Tissues after init:\n");
+				dump_tissues(ds);
 #endif
-				return surface_time;
 			}
-			add_segment(ds, surface_pressure, &air, surface_time, 0, dive, prefs.decosac);
+			else {
+				add_segment(ds, surface_pressure, &air, surface_time, 0, dive, prefs.decosac);
 #if DECO_CALC_DEBUG & 2
-			printf("Tissues after surface intervall of %d:%02u:\n", FRACTION(surface_time, 60));
+				printf("Tissues after surface intervall of %d:%02u:\n", FRACTION(surface_time, 60));
+				dump_tissues(ds);
+#endif
+			}
+
+			add_dive_to_deco(ds, pdive);
+			clear_vpmb_state(ds);
+#if DECO_CALC_DEBUG & 2
+			printf("Tissues after added dive #%d:\n", pdive->number);
 			dump_tissues(ds);
 #endif
+			lock_deco_snapshots();
+			serial = save_deco_snapshot(ds, pdive, content, prev_id, prev_serial)->serial;
+			unlock_deco_snapshots();
 		}
-
-		add_dive_to_deco(ds, pdive);
-
+		deco_init = true;
+		prev_id = pdive->id;
+		prev_serial = serial;
 		last_starttime = pdive->when;
 		last_endtime = dive_endtime(pdive);
-		clear_vpmb_state(ds);
-#if DECO_CALC_DEBUG & 2
-		printf("Tissues after added dive #%d:\n", pdive->number);
-		dump_tissues(ds);
-#endif
 	}
 
 	surface_pressure = get_surface_pressure_in_mbar(dive, true) / 1000.0;
@@ -640,9 +1003,17 @@ void update_cylinder_related_info(struct dive *dive)
 		dive->otu = calculate_otu(dive);
 		if (dive->maxcns == 0)
 			dive->maxcns = calculate_cns(dive);
+		dive->cylinder_info_valid = true;
 	}
 }
 
+/* like update_cylinder_related_info(), but only if the dive changed since */
+void cache_cylinder_related_info(struct dive *dive)
+{
+	if (dive != NULL && !dive->cylinder_info_valid)
+		update_cylinder_related_info(dive);
+}
+
 #define MAX_GAS_STRING 80
 #define UTF8_ELLIPSIS "\xE2\x80\xA6"
 
@@ -947,6 +1318,10 @@ void delete_single_dive(int idx)
 	for (i = idx; i < dive_table.nr - 1; i++)
 		dive_table.dives[i] = dive_table.dives[i + 1];
 	dive_table.dives[--dive_table.nr] = NULL;
+	invalidate_dive_indexes();
+	lock_deco_snapshots();
+	delete_deco_snapshot(dive->id);
+	unlock_deco_snapshots();
 	/* free all allocations */
 	free(dive->dc.sample);
 	free((void *)dive->notes);
@@ -997,6 +1372,7 @@ void add_single_dive(int idx, struct dive *dive)
 		dive_table.dives[i] = dive;
 		dive = tmp;
 	}
+	invalidate_dive_indexes();
 }
 
 bool consecutive_selected()
@@ -1076,7 +1452,7 @@ struct dive *merge_two_dives(struct dive *a, struct dive *b)
 	// now make sure that we keep the id of the first dive.
 	// why?
 	// because this way one of the previously selected ids is still around
-	res->id = id;
+	set_dive_id(res, id);
 
 	// renumber dives from merged one in advance by difference between
 	// merged dives numbers. Do not renumber if actual number is zero.
@@ -1193,6 +1569,13 @@ void combine_trips(struct dive_trip *trip_a, struct dive_trip *trip_b)
 
 void mark_divelist_changed(bool changed)
 {
+	/* dives may have been edited in place - start and end times, tags,
+	 * buddies, suits and locations may be stale */
+	if (changed) {
+		dive_list_generation++;
+		invalidate_dive_time_index();
+		invalidate_dive_value_index();
+	}
 	if (dive_list_changed == changed)
 		return;
 	dive_list_changed = changed;
@@ -1332,7 +1715,7 @@ void process_dives(bool is_imported, bool prefer_imported)
 		delete_single_dive(i + 1);
 		delete_single_dive(i + 1);
 		// keep the id or the first dive for the merged dive
-		merged->id = id;
+		set_dive_id(merged, id);
 
 		/* this means the table was changed */
 		did_merge = true;
@@ -12,6 +12,8 @@ extern "C" {
 struct dive;
 
 extern void update_cylinder_related_info(struct dive *);
+extern unsigned int get_dive_list_generation(void);
+extern void cache_cylinder_related_info(struct dive *);
 extern void mark_divelist_changed(bool);
 extern int unsaved_changes(void);
 extern void remove_autogen_trips(void);
@@ -9,6 +9,103 @@
 
 struct dive_site_table dive_site_table;
 
+/*
+ * Hash index from uuid to dive site, maintained by alloc_or_get_dive_site(),
+ * delete_dive_site() and set_dive_site_uuid(). Open addressing with linear
+ * probing; a NULL site marks an empty slot. The uuids are kept next to the
+ * sites so that probing doesn't have to touch the sites themselves.
+ */
+static struct {
+	int size, nr;
+	uint32_t *uuids;
+	struct dive_site **sites;
+} uuid_index;
+
+static inline unsigned int uuid_hash(uint32_t uuid)
+{
+	return (uuid * 2654435761u) & (uuid_index.size - 1);
+}
+
+static void uuid_index_insert(struct dive_site *ds)
+{
+	unsigned int h;
+
+	if (2 * (uuid_index.nr + 1) > uuid_index.size) {
+		int i, old_size = uuid_index.size;
+		uint32_t *old_uuids = uuid_index.uuids;
+		struct dive_site **old_sites = uuid_index.sites;
+
+		uuid_index.size = old_size ? old_size * 2 : 64;
+		uuid_index.uuids = calloc(uuid_index.size, sizeof(uint32_t));
+		uuid_index.sites = calloc(uuid_index.size, sizeof(struct dive_site *));
+		if (!uuid_index.uuids || !uuid_index.sites)
+			exit(1);
+		for (i = 0; i < old_size; i++) {
+			if (!old_sites[i])
+				continue;
+			for (h = uuid_hash(old_uuids[i]); uuid_index.sites[h]; h = (h + 1) & (uuid_index.size - 1))
+				;
+			uuid_index.uuids[h] = old_uuids[i];
+			uuid_index.sites[h] = old_sites[i];
+		}
+		free(old_uuids);
+		free(old_sites);
+	}
+	for (h = uuid_hash(ds->uuid); uuid_index.sites[h]; h = (h + 1) & (uuid_index.size - 1))
+		;
+	uuid_index.uuids[h] = ds->uuid;
+	uuid_index.sites[h] = ds;
+	uuid_index.nr++;
+}
+
+/* the slot of a site in the index, or -1 - there may be other sites with the same uuid */
+static int uuid_index_slot(struct dive_site *ds)
+{
+	unsigned int h;
+
+	if (!uuid_index.size)
+		return -1;
+	for (h = uuid_hash(ds->uuid); uuid_index.sites[h]; h = (h + 1) & (uuid_index.size - 1))
+		if (uuid_index.sites[h] == ds)
+			return h;
+	return -1;
+}
+
+static void uuid_index_remove(struct dive_site *ds)
+{
+	unsigned int h, i, j, mask = uuid_index.size - 1;
+	int slot = uuid_index_slot(ds);
+
+	if (slot < 0)
+		return;
+	h = slot;
+	uuid_index.sites[h] = NULL;
+	uuid_index.nr--;
+	/* backward shift deletion: move up entries that would otherwise become unreachable */
+	for (i = (h + 1) & mask; uuid_index.sites[i]; i = (i + 1) & mask) {
+		j = uuid_hash(uuid_index.uuids[i]);
+		if (((i - j) & mask) < ((i - h) & mask))
+			continue;
+		uuid_index.uuids[h] = uuid_index.uuids[i];
+		uuid_index.sites[h] = uuid_index.sites[i];
+		uuid_index.sites[i] = NULL;
+		h = i;
+	}
+}
+
+struct dive_site *get_dive_site_by_uuid(uint32_t uuid)
+{
+	unsigned int h;
+
+	if (!uuid_index.size)
+		return NULL;
+	for (h = uuid_hash(uuid); uuid_index.sites[h]; h = (h + 1) & (uuid_index.size - 1)) {
+		if (uuid_index.uuids[h] == uuid)
+			return uuid_index.sites[h];
+	}
+	return NULL;
+}
+
 /* there could be multiple sites of the same name - return the first one */
 uint32_t get_dive_site_uuid_by_name(const char *name, struct dive_site **dsp)
 {
@@ -24,19 +121,251 @@ uint32_t get_dive_site_uuid_by_name(const char *name, struct dive_site **dsp)
 	return 0;
 }
 
-/* there could be multiple sites at the same GPS fix - return the first one */
-uint32_t get_dive_site_uuid_by_gps(degrees_t latitude, degrees_t longitude, struct dive_site **dsp)
+/*
+ * Spatial index of the dive sites that have a GPS fix: the sites are filed
+ * in buckets of a regular lat/lon grid, which are kept in a hash keyed by
+ * the grid cell. The index tracks the dive site table incrementally through
+ * alloc_or_get_dive_site(), delete_dive_site() and set_dive_site_gps(); the
+ * query functions double check the current coordinates of every candidate.
+ */
+#define GRID_CELL_UDEG 10000		/* 0.01 degrees, roughly 1.1km north-south */
+#define GRID_LON_CELLS (360 * 1000000 / GRID_CELL_UDEG)
+#define GRID_MAX_QUERY_CELLS 4096	/* beyond that a linear scan is cheaper */
+#define METERS_PER_DEGREE 111194.93	/* 6371km * pi / 180, matches get_distance() */
+
+struct grid_bucket {
+	int lat_cell, lon_cell;
+	int nr, allocated;
+	struct dive_site **sites;
+};
+
+static struct {
+	int size, nr;
+	struct grid_bucket *buckets;
+} site_grid;
+
+static inline int grid_cell(int udeg)
+{
+	return udeg >= 0 ? udeg / GRID_CELL_UDEG : -((-udeg - 1) / GRID_CELL_UDEG) - 1;
+}
+
+static inline int grid_wrap_lon(int lon_cell)
+{
+	lon_cell %= GRID_LON_CELLS;
+	if (lon_cell >= GRID_LON_CELLS / 2)
+		lon_cell -= GRID_LON_CELLS;
+	else if (lon_cell < -GRID_LON_CELLS / 2)
+		lon_cell += GRID_LON_CELLS;
+	return lon_cell;
+}
+
+static inline int grid_lon_cell(int udeg)
+{
+	return grid_wrap_lon(grid_cell(udeg));
+}
+
+static inline unsigned int grid_hash(int lat_cell, int lon_cell, int size)
+{
+	return ((uint32_t)lat_cell * 2654435761u ^ (uint32_t)lon_cell * 2246822519u) & (size - 1);
+}
+
+/* find the bucket for a grid cell - buckets are never removed, only emptied */
+static struct grid_bucket *grid_bucket(int lat_cell, int lon_cell, bool create)
+{
+	unsigned int h;
+	struct grid_bucket *b;
+
+	if (create && 2 * (site_grid.nr + 1) > site_grid.size) {
+		int i, old_size = site_grid.size;
+		struct grid_bucket *old = site_grid.buckets;
+
+		site_grid.size = old_size ? old_size * 2 : 256;
+		site_grid.buckets = calloc(site_grid.size, sizeof(struct grid_bucket));
+		if (!site_grid.buckets)
+			exit(1);
+		for (i = 0; i < old_size; i++) {
+			if (!old[i].allocated)
+				continue;
+			for (h = grid_hash(old[i].lat_cell, old[i].lon_cell, site_grid.size);
+			     site_grid.buckets[h].allocated;
+			     h = (h + 1) & (site_grid.size - 1))
+				;
+			site_grid.buckets[h] = old[i];
+		}
+		free(old);
+	}
+	if (!site_grid.size)
+		return NULL;
+	for (h = grid_hash(lat_cell, lon_cell, site_grid.size);
+	     (b = site_grid.buckets + h)->allocated;
+	     h = (h + 1) & (site_grid.size - 1)) {
+		if (b->lat_cell == lat_cell && b->lon_cell == lon_cell)
+			return b;
+	}
+	if (!create)
+		return NULL;
+	b->lat_cell = lat_cell;
+	b->lon_cell = lon_cell;
+	b->allocated = 4;
+	b->sites = malloc(b->allocated * sizeof(struct dive_site *));
+	if (!b->sites)
+		exit(1);
+	site_grid.nr++;
+	return b;
+}
+
+static void site_grid_insert(struct dive_site *ds)
+{
+	struct grid_bucket *b;
+
+	if (!dive_site_has_gps_location(ds))
+		return;
+	b = grid_bucket(grid_cell(ds->latitude.udeg), grid_lon_cell(ds->longitude.udeg), true);
+	if (b->nr >= b->allocated) {
+		b->allocated *= 2;
+		b->sites = realloc(b->sites, b->allocated * sizeof(struct dive_site *));
+		if (!b->sites)
+			exit(1);
+	}
+	b->sites[b->nr++] = ds;
+}
+
+static bool grid_bucket_remove(struct grid_bucket *b, struct dive_site *ds)
+{
+	for (int i = 0; b && i < b->nr; i++) {
+		if (b->sites[i] == ds) {
+			/* keep the order, so that "first" keeps meaning something */
+			memmove(b->sites + i, b->sites + i + 1, (b->nr - i - 1) * sizeof(struct dive_site *));
+			b->nr--;
+			return true;
+		}
+	}
+	return false;
+}
+
+/* all writers of the coordinates go through set_dive_site_gps(), so the site is filed under its own cell */
+static void site_grid_remove(struct dive_site *ds)
+{
+	if (dive_site_has_gps_location(ds))
+		grid_bucket_remove(grid_bucket(grid_cell(ds->latitude.udeg), grid_lon_cell(ds->longitude.udeg), false), ds);
+}
+
+static bool is_in_dive_site_table(struct dive_site *ds)
+{
+	return ds && uuid_index_slot(ds) >= 0;
+}
+
+/* change the uuid of a dive site - use this for sites in the dive site table */
+void set_dive_site_uuid(struct dive_site *ds, uint32_t uuid)
+{
+	bool in_table = is_in_dive_site_table(ds);
+
+	if (ds->uuid == uuid)
+		return;
+	if (in_table)
+		uuid_index_remove(ds);
+	ds->uuid = uuid;
+	if (in_table)
+		uuid_index_insert(ds);
+}
+
+/* change the GPS location of a dive site - use this for sites in the dive site table */
+void set_dive_site_gps(struct dive_site *ds, degrees_t latitude, degrees_t longitude)
+{
+	bool in_table = is_in_dive_site_table(ds);
+
+	if (ds->latitude.udeg == latitude.udeg && ds->longitude.udeg == longitude.udeg)
+		return;
+	if (in_table)
+		site_grid_remove(ds);
+	ds->latitude = latitude;
+	ds->longitude = longitude;
+	if (in_table)
+		site_grid_insert(ds);
+}
+
+/*
+ * Call fn for all sites with a GPS fix that may be within distance meters of the given
+ * location. Returns false if the area is too large for the grid, in which case the
+ * caller has to fall back to walking the dive site table.
+ */
+static bool for_each_site_near(degrees_t latitude, degrees_t longitude, int distance,
+			       void (*fn)(struct dive_site *ds, void *data), void *data)
+{
+	double dlat = distance * 1.01 / METERS_PER_DEGREE;
+	double dlon = 0.0;
+	int lat_lo, lat_hi, lon_lo, lon_hi, lat_cell, lon_cell;
+
+	/* a degree of longitude is shortest at the poleward edge of the area */
+	if (dlat > 0.0) {
+		double coslat = cos(udeg_to_radians(abs(latitude.udeg)) + dlat * M_PI / 180.0);
+		if (dlat >= 1.0 || coslat < 2 * dlat)
+			return false;
+		dlon = dlat / coslat;
+	}
+	lat_lo = grid_cell(latitude.udeg - lrint(dlat * 1000000));
+	lat_hi = grid_cell(latitude.udeg + lrint(dlat * 1000000));
+	lon_lo = grid_cell(longitude.udeg - lrint(dlon * 1000000));
+	lon_hi = grid_cell(longitude.udeg + lrint(dlon * 1000000));
+	if ((lat_hi - lat_lo + 1) * (lon_hi - lon_lo + 1) > GRID_MAX_QUERY_CELLS)
+		return false;
+	for (lat_cell = lat_lo; lat_cell <= lat_hi; lat_cell++) {
+		for (lon_cell = lon_lo; lon_cell <= lon_hi; lon_cell++) {
+			struct grid_bucket *b = grid_bucket(lat_cell, grid_wrap_lon(lon_cell), false);
+			for (int i = 0; b && i < b->nr; i++)
+				if (dive_site_has_gps_location(b->sites[i]))
+					fn(b->sites[i], data);
+		}
+	}
+	return true;
+}
+
+struct gps_match {
+	degrees_t latitude, longitude;
+	const char *name;
+	bool check_name;
+	struct dive_site *ds;
+};
+
+static void match_gps(struct dive_site *ds, void *_match)
+{
+	struct gps_match *match = _match;
+
+	if (ds->latitude.udeg != match->latitude.udeg || ds->longitude.udeg != match->longitude.udeg)
+		return;
+	if (match->check_name && !same_string(ds->name, match->name))
+		return;
+	/* the grid doesn't keep the table order - of several matches, take the first in the table */
+	if (!match->ds || get_divesite_idx(ds) < get_divesite_idx(match->ds))
+		match->ds = ds;
+}
+
+static struct dive_site *find_site_by_gps(degrees_t latitude, degrees_t longitude, bool check_name, const char *name)
 {
 	int i;
 	struct dive_site *ds;
+	struct gps_match match = { latitude, longitude, name, check_name, NULL };
+
+	/* sites without GPS fix aren't in the grid */
+	if ((latitude.udeg || longitude.udeg) && for_each_site_near(latitude, longitude, 0, match_gps, &match))
+		return match.ds;
 	for_each_dive_site (i, ds) {
-		if (ds->latitude.udeg == latitude.udeg && ds->longitude.udeg == longitude.udeg) {
-			if (dsp)
-				*dsp = ds;
-			return ds->uuid;
-		}
+		if (ds->latitude.udeg == latitude.udeg && ds->longitude.udeg == longitude.udeg &&
+		    (!check_name || same_string(ds->name, name)))
+			return ds;
 	}
-	return 0;
+	return NULL;
+}
+
+/* there could be multiple sites at the same GPS fix - return the first one */
+uint32_t get_dive_site_uuid_by_gps(degrees_t latitude, degrees_t longitude, struct dive_site **dsp)
+{
+	struct dive_site *ds = find_site_by_gps(latitude, longitude, false, NULL);
+	if (!ds)
+		return 0;
+	if (dsp)
+		*dsp = ds;
+	return ds->uuid;
 }
 
 
@@ -45,47 +374,107 @@ uint32_t get_dive_site_uuid_by_gps(degrees_t latitude, degrees_t longitude, stru
  * this function allows us to verify if a very specific name/GPS combination already exists */
 uint32_t get_dive_site_uuid_by_gps_and_name(char *name, degrees_t latitude, degrees_t longitude)
 {
-	int i;
-	struct dive_site *ds;
-	for_each_dive_site (i, ds) {
-		if (ds->latitude.udeg == latitude.udeg && ds->longitude.udeg == longitude.udeg && same_string(ds->name, name))
-			return ds->uuid;
-	}
-	return 0;
+	struct dive_site *ds = find_site_by_gps(latitude, longitude, true, name);
+	return ds ? ds->uuid : 0;
 }
 
 // Calculate the distance in meters between two coordinates.
 unsigned int get_distance(degrees_t lat1, degrees_t lon1, degrees_t lat2, degrees_t lon2)
 {
+	double lat1_r = udeg_to_radians(lat1.udeg);
 	double lat2_r = udeg_to_radians(lat2.udeg);
 	double lat_d_r = udeg_to_radians(lat2.udeg-lat1.udeg);
 	double lon_d_r = udeg_to_radians(lon2.udeg-lon1.udeg);
 
 	double a = sin(lat_d_r/2) * sin(lat_d_r/2) +
-		cos(lat2_r) * cos(lat2_r) * sin(lon_d_r/2) * sin(lon_d_r/2);
-	double c = 2 * atan2(sqrt(a), sqrt(1.0 - a));
+		cos(lat1_r) * cos(lat2_r) * sin(lon_d_r/2) * sin(lon_d_r/2);
+	double c = 2 * atan2(sqrt(a), sqrt(MAX(1.0 - a, 0.0)));
 
 	// Earth radious in metres
 	return lrint(6371000 * c);
 }
 
+struct proximity_match {
+	degrees_t latitude, longitude;
+	unsigned int min_distance;
+	struct dive_site *ds;
+};
+
+static void match_proximity(struct dive_site *ds, void *_match)
+{
+	struct proximity_match *match = _match;
+	unsigned int cur_distance = get_distance(ds->latitude, ds->longitude, match->latitude, match->longitude);
+
+	/* the grid doesn't keep the table order - on a tie, take the first in the table */
+	if (cur_distance < match->min_distance ||
+	    (cur_distance == match->min_distance && match->ds && get_divesite_idx(ds) < get_divesite_idx(match->ds))) {
+		match->min_distance = cur_distance;
+		match->ds = ds;
+	}
+}
+
 /* find the closest one, no more than distance meters away - if more than one at same distance, pick the first */
 uint32_t get_dive_site_uuid_by_gps_proximity(degrees_t latitude, degrees_t longitude, int distance, struct dive_site **dsp)
 {
 	int i;
-	int uuid = 0;
 	struct dive_site *ds;
-	unsigned int cur_distance, min_distance = distance;
-	for_each_dive_site (i, ds) {
-		if (dive_site_has_gps_location(ds) &&
-		    (cur_distance = get_distance(ds->latitude, ds->longitude, latitude, longitude)) < min_distance) {
-			min_distance = cur_distance;
-			uuid = ds->uuid;
-			if (dsp)
-				*dsp = ds;
+	struct proximity_match match = { latitude, longitude, distance, NULL };
+
+	if (!for_each_site_near(latitude, longitude, distance, match_proximity, &match)) {
+		for_each_dive_site (i, ds) {
+			if (dive_site_has_gps_location(ds))
+				match_proximity(ds, &match);
 		}
 	}
-	return uuid;
+	if (!match.ds)
+		return 0;
+	if (dsp)
+		*dsp = match.ds;
+	return match.ds->uuid;
+}
+
+struct radius_match {
+	degrees_t latitude, longitude;
+	unsigned int distance;
+	int nr, allocated;
+	struct dive_site **sites;
+};
+
+static void match_radius(struct dive_site *ds, void *_match)
+{
+	struct radius_match *match = _match;
+
+	if (get_distance(ds->latitude, ds->longitude, match->latitude, match->longitude) >= match->distance)
+		return;
+	if (match->nr >= match->allocated) {
+		match->allocated = (match->nr + 16) * 3 / 2;
+		match->sites = realloc(match->sites, match->allocated * sizeof(struct dive_site *));
+		if (!match->sites)
+			exit(1);
+	}
+	match->sites[match->nr++] = ds;
+}
+
+/*
+ * Collect all dive sites less than distance meters away from the given location
+ * into an internally allocated array and return the number of sites found.
+ *
+ * NOTE! The returned array must be freed once used.
+ */
+int get_dive_sites_within_distance(degrees_t latitude, degrees_t longitude, int distance, struct dive_site ***dsp)
+{
+	int i;
+	struct dive_site *ds;
+	struct radius_match match = { latitude, longitude, distance, 0, 0, NULL };
+
+	if (!for_each_site_near(latitude, longitude, distance, match_radius, &match)) {
+		for_each_dive_site (i, ds) {
+			if (dive_site_has_gps_location(ds))
+				match_radius(ds, &match);
+		}
+	}
+	*dsp = match.sites;
+	return match.nr;
 }
 
 /* try to create a uniqe ID - fingers crossed */
@@ -136,6 +525,8 @@ struct dive_site *alloc_or_get_dive_site(uint32_t uuid)
 		ds->uuid = uuid;
 	else
 		ds->uuid = dive_site_getUniqId();
+	uuid_index_insert(ds);
+	site_grid_insert(ds);
 	return ds;
 }
 
@@ -166,12 +557,27 @@ bool is_dive_site_used(uint32_t uuid, bool select_only)
 	return found;
 }
 
+/* The dives show the name and location of their site, so editing it edits them */
+void invalidate_dive_site_dives(uint32_t uuid)
+{
+	int j;
+	struct dive *d;
+	for_each_dive(j, d) {
+		if (d->dive_site_uuid == uuid)
+			invalidate_dive_cache(d);
+	}
+}
+
 void delete_dive_site(uint32_t id)
 {
 	int nr = dive_site_table.nr;
 	for (int i = 0; i < nr; i++) {
 		struct dive_site *ds = get_dive_site(i);
 		if (ds->uuid == id) {
+			uuid_index_remove(ds);
+			site_grid_remove(ds);
+			/* the dives at the site lose their location */
+			invalidate_dive_value_index();
 			free(ds->name);
 			free(ds->notes);
 			free(ds);
@@ -230,8 +636,7 @@ uint32_t create_dive_site_with_gps(const char *name, degrees_t latitude, degrees
 	uint32_t uuid = create_divesite_uuid(name, divetime);
 	struct dive_site *ds = alloc_or_get_dive_site(uuid);
 	ds->name = copy_string(name);
-	ds->latitude = latitude;
-	ds->longitude = longitude;
+	set_dive_site_gps(ds, latitude, longitude);
 
 	return ds->uuid;
 }
@@ -268,16 +673,18 @@ void copy_dive_site_taxonomy(struct dive_site *orig, struct dive_site *copy)
 }
 void copy_dive_site(struct dive_site *orig, struct dive_site *copy)
 {
+	/* the location of the dives at a site in the table may change */
+	if (is_in_dive_site_table(copy))
+		invalidate_dive_value_index();
 	free(copy->name);
 	free(copy->notes);
 	free(copy->description);
 
-	copy->latitude = orig->latitude;
-	copy->longitude = orig->longitude;
+	set_dive_site_gps(copy, orig->latitude, orig->longitude);
 	copy->name = copy_string(orig->name);
 	copy->notes = copy_string(orig->notes);
 	copy->description = copy_string(orig->description);
-	copy->uuid = orig->uuid;
+	set_dive_site_uuid(copy, orig->uuid);
 	copy_dive_site_taxonomy(orig, copy);
 }
 
@@ -302,8 +709,13 @@ static void merge_string(char **a, char **b)
 
 void merge_dive_site(struct dive_site *a, struct dive_site *b)
 {
-	if (!a->latitude.udeg) a->latitude.udeg = b->latitude.udeg;
-	if (!a->longitude.udeg) a->longitude.udeg = b->longitude.udeg;
+	degrees_t latitude = a->latitude, longitude = a->longitude;
+
+	if (!latitude.udeg) latitude.udeg = b->latitude.udeg;
+	if (!longitude.udeg) longitude.udeg = b->longitude.udeg;
+	set_dive_site_gps(a, latitude, longitude);
+	if (is_in_dive_site_table(a))
+		invalidate_dive_value_index();
 	merge_string(&a->name, &b->name);
 	merge_string(&a->notes, &b->notes);
 	merge_string(&a->description, &b->description);
@@ -322,9 +734,8 @@ void clear_dive_site(struct dive_site *ds)
 	ds->name = NULL;
 	ds->notes = NULL;
 	ds->description = NULL;
-	ds->latitude.udeg = 0;
-	ds->longitude.udeg = 0;
-	ds->uuid = 0;
+	set_dive_site_gps(ds, (degrees_t){ 0 }, (degrees_t){ 0 });
+	set_dive_site_uuid(ds, 0);
 	ds->taxonomy.nr = 0;
 	free_taxonomy(&ds->taxonomy);
 }
@@ -333,15 +744,16 @@ void merge_dive_sites(uint32_t ref, uint32_t* uuids, int count)
 {
 	int curr_dive, i;
 	struct dive *d;
-	for(i = 0; i < count; i++){
-		if (uuids[i] == ref)
+	/* one pass over the dives; the list of merged sites is short */
+	for_each_dive(curr_dive, d) {
+		if (d->dive_site_uuid == ref)
 			continue;
-
-		for_each_dive(curr_dive, d) {
-			if (d->dive_site_uuid != uuids[i] )
+		for (i = 0; i < count; i++) {
+			if (d->dive_site_uuid != uuids[i])
 				continue;
 			d->dive_site_uuid = ref;
 			invalidate_dive_cache(d);
+			break;
 		}
 	}
 
@@ -42,20 +42,13 @@ static inline struct dive_site *get_dive_site(int nr)
 #define for_each_dive_site(_i, _x) \
 	for ((_i) = 0; ((_x) = get_dive_site(_i)) != NULL; (_i)++)
 
-static inline struct dive_site *get_dive_site_by_uuid(uint32_t uuid)
-{
-	int i;
-	struct dive_site *ds;
-	for_each_dive_site (i, ds)
-		if (ds->uuid == uuid)
-			return get_dive_site(i);
-	return NULL;
-}
+struct dive_site *get_dive_site_by_uuid(uint32_t uuid);
 
 void dive_site_table_sort();
 struct dive_site *alloc_or_get_dive_site(uint32_t uuid);
 int nr_of_dives_at_dive_site(uint32_t uuid, bool select_only);
 bool is_dive_site_used(uint32_t uuid, bool select_only);
+void invalidate_dive_site_dives(uint32_t uuid);
 void delete_dive_site(uint32_t id);
 uint32_t create_dive_site(const char *name, timestamp_t divetime);
 uint32_t create_dive_site_from_current_dive(const char *name);
@@ -64,6 +57,9 @@ uint32_t get_dive_site_uuid_by_name(const char *name, struct dive_site **dsp);
 uint32_t get_dive_site_uuid_by_gps(degrees_t latitude, degrees_t longitude, struct dive_site **dsp);
 uint32_t get_dive_site_uuid_by_gps_and_name(char *name, degrees_t latitude, degrees_t longitude);
 uint32_t get_dive_site_uuid_by_gps_proximity(degrees_t latitude, degrees_t longitude, int distance, struct dive_site **dsp);
+int get_dive_sites_within_distance(degrees_t latitude, degrees_t longitude, int distance, struct dive_site ***dsp);
+void set_dive_site_gps(struct dive_site *ds, degrees_t latitude, degrees_t longitude);
+void set_dive_site_uuid(struct dive_site *ds, uint32_t uuid);
 bool dive_site_is_empty(struct dive_site *ds);
 void copy_dive_site_taxonomy(struct dive_site *orig, struct dive_site *copy);
 void copy_dive_site(struct dive_site *orig, struct dive_site *copy);
@@ -237,13 +237,10 @@ static void fill_missing_tank_pressures(struct dive *dive, struct plot_info *pi,
 		double magic;
 		pr_track_t *segment;
 		int pressure;
-		int *save_pressure, *save_interpolated;
 
 		entry = pi->entry + i;
 
-		save_pressure = &(entry->pressure[cyl][SENSOR_PR]);
-		save_interpolated = &(entry->pressure[cyl][INTERPOLATED_PR]);
-		pressure = *save_pressure ? *save_pressure : *save_interpolated;
+		pressure = get_plot_pressure(pi, i, cyl);
 
 		if (pressure) {			// If there is a valid pressure value,
 			last_segment = NULL;	// get rid of interpolation data,
@@ -265,7 +262,7 @@ static void fill_missing_tank_pressures(struct dive *dive, struct plot_info *pi,
 			continue;
 
 		if (!segment->pressure_time) {		// Empty segment?
-			*save_pressure = cur_pr;	// Just use our current pressure
+			set_plot_pressure_data(pi, i, SENSOR_PR, cyl, cur_pr);	// Just use our current pressure
 			continue;			// and skip to next point.
 		}
 
@@ -292,7 +289,7 @@ static void fill_missing_tank_pressures(struct dive *dive, struct plot_info *pi,
 			magic = (interpolate.end - interpolate.start) /  (segment->t_end - segment->t_start);
 			cur_pr = lrint(segment->start + magic * (entry->sec - segment->t_start));
 		}
-		*save_interpolated = cur_pr; // and store the interpolated data in plot_info
+		set_plot_pressure_data(pi, i, INTERPOLATED_PR, cyl, cur_pr); // and store the interpolated data in plot_info
 	}
 }
 
@@ -359,8 +356,7 @@ void populate_pressure_information(struct dive *dive, struct divecomputer *dc, s
 	/* Get a rough range of where we have any pressures at all */
 	first = last = -1;
 	for (int i = 0; i < pi->nr; i++) {
-		struct plot_data *entry = pi->entry + i;
-		unsigned pressure = SENSOR_PRESSURE(entry, sensor);
+		unsigned pressure = get_plot_sensor_pressure(pi, i, sensor);
 
 		if (!pressure)
 			continue;
@@ -388,7 +384,7 @@ void populate_pressure_information(struct dive *dive, struct divecomputer *dc, s
 
 	for (int i = first; i <= last; i++) {
 		struct plot_data *entry = pi->entry + i;
-		unsigned pressure = SENSOR_PRESSURE(entry, sensor);
+		unsigned pressure = get_plot_sensor_pressure(pi, i, sensor);
 		int time = entry->sec;
 
 		while (ev && ev->time.seconds <= time) {
@@ -412,7 +408,7 @@ void populate_pressure_information(struct dive *dive, struct divecomputer *dc, s
 		// until we get back to this cylinder.
 		if (cyl != sensor) {
 			current = NULL;
-			SENSOR_PRESSURE(entry, sensor) = 0;
+			set_plot_pressure_data(pi, i, SENSOR_PR, sensor, 0);
 			continue;
 		}
 
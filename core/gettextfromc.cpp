@@ -5,6 +5,8 @@
 
 const char *gettextFromC::trGettext(const char *text)
 {
+	// the planner translates from several threads at once
+	QMutexLocker locker(&translationLock);
 	QByteArray &result = translationCache[QByteArray(text)];
 	if (result.isEmpty())
 		result = translationCache[QByteArray(text)] = trUtf8(text).toUtf8();
@@ -13,6 +15,7 @@ const char *gettextFromC::trGettext(const char *text)
 
 void gettextFromC::reset(void)
 {
+	QMutexLocker locker(&translationLock);
 	translationCache.clear();
 }
 
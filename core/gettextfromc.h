@@ -3,6 +3,7 @@
 #define GETTEXTFROMC_H
 
 #include <QHash>
+#include <QMutex>
 #include <QCoreApplication>
 
 extern "C" const char *trGettext(const char *text);
@@ -14,6 +15,8 @@ public:
 	const char *trGettext(const char *text);
 	void reset(void);
 	QHash<QByteArray, QByteArray> translationCache;
+private:
+	QMutex translationLock;
 };
 
 #endif // GETTEXTFROMC_H
@@ -6,6 +6,7 @@
 #include "core/helpers.h"
 #include <time.h>
 #include <unistd.h>
+#include <algorithm>
 #include <QDebug>
 #include <QVariant>
 #include <QUrlQuery>
@@ -247,8 +248,8 @@ static void copy_gps_location(struct gpsTracker &gps, struct dive *d)
 		d->dive_site_uuid = create_dive_site(qPrintable(gps.name), gps.when);
 		ds = get_dive_site_by_uuid(d->dive_site_uuid);
 	}
-	ds->latitude = gps.latitude;
-	ds->longitude = gps.longitude;
+	set_dive_site_gps(ds, gps.latitude, gps.longitude);
+	invalidate_dive_site_dives(ds->uuid);
 }
 
 #define SAME_GROUP 6 * 3600 /* six hours */
@@ -276,7 +277,10 @@ bool GpsLocation::applyLocations()
 	for_each_dive(i, d) {
 		if (dive_has_gps_location(d))
 			continue;
-		for (int j = last; j < cnt; j++) {
+		// the fixes are sorted, so skip right to the first one that can belong to this dive
+		int first = std::lower_bound(gpsTable.begin() + last, gpsTable.end(), d->when - SAME_GROUP,
+					     [](const struct gpsTracker &gt, timestamp_t when) { return gt.when < when; }) - gpsTable.begin();
+		for (int j = first; j < cnt; j++) {
 			if (time_during_dive_with_offset(d, gpsTable[j].when, SAME_GROUP)) {
 				if (verbose)
 					qDebug() << "processing gpsFix @" << get_dive_date_string(gpsTable[j].when) <<
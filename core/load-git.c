@@ -197,8 +197,7 @@ static void parse_dive_gps(char *line, struct membuffer *str, void *_dive)
 			ds->notes = add_to_string(ds->notes, translate("gettextFromC", "multiple GPS locations for this dive site; also %s\n"), coords);
 			free((void *)coords);
 		}
-		ds->latitude = latitude;
-		ds->longitude = longitude;
+		set_dive_site_gps(ds, latitude, longitude);
 	}
 
 }
@@ -307,9 +306,10 @@ static void parse_site_gps(char *line, struct membuffer *str, void *_ds)
 {
 	(void) str;
 	struct dive_site *ds = _ds;
+	degrees_t latitude = parse_degrees(line, &line);
+	degrees_t longitude = parse_degrees(line, &line);
 
-	ds->latitude = parse_degrees(line, &line);
-	ds->longitude = parse_degrees(line, &line);
+	set_dive_site_gps(ds, latitude, longitude);
 }
 
 static void parse_site_geo(char *line, struct membuffer *str, void *_ds)
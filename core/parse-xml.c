@@ -1076,7 +1076,7 @@ static void gps_lat(char *buffer, struct dive *dive)
 	} else {
 		if (ds->latitude.udeg && ds->latitude.udeg != latitude.udeg)
 			fprintf(stderr, "Oops, changing the latitude of existing dive site id %8x name %s; not good\n", ds->uuid, ds->name ?: "(unknown)");
-		ds->latitude = latitude;
+		set_dive_site_gps(ds, latitude, ds->longitude);
 	}
 }
 
@@ -1090,7 +1090,7 @@ static void gps_long(char *buffer, struct dive *dive)
 	} else {
 		if (ds->longitude.udeg && ds->longitude.udeg != longitude.udeg)
 			fprintf(stderr, "Oops, changing the longitude of existing dive site id %8x name %s; not good\n", ds->uuid, ds->name ?: "(unknown)");
-		ds->longitude = longitude;
+		set_dive_site_gps(ds, ds->latitude, longitude);
 	}
 
 }
@@ -1098,9 +1098,10 @@ static void gps_long(char *buffer, struct dive *dive)
 static void gps_location(char *buffer, struct dive_site *ds)
 {
 	char *end;
+	degrees_t latitude = parse_degrees(buffer, &end);
+	degrees_t longitude = parse_degrees(end, &end);
 
-	ds->latitude = parse_degrees(buffer, &end);
-	ds->longitude = parse_degrees(end, &end);
+	set_dive_site_gps(ds, latitude, longitude);
 }
 
 static void gps_in_dive(char *buffer, struct dive *dive)
@@ -1137,8 +1138,7 @@ static void gps_in_dive(char *buffer, struct dive *dive)
 			ds->notes = add_to_string(ds->notes, translate("gettextFromC", "multiple GPS locations for this dive site; also %s\n"), coords);
 			free((void *)coords);
 		} else {
-			ds->latitude = latitude;
-			ds->longitude = longitude;
+			set_dive_site_gps(ds, latitude, longitude);
 		}
 	}
 }
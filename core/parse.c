@@ -78,6 +78,8 @@ void clear_table(struct dive_table *table)
 	for (int i = 0; i < table->nr; i++)
 		free(table->dives[i]);
 	table->nr = 0;
+	if (table == &dive_table)
+		invalidate_dive_indexes();
 }
 
 /*
@@ -91,6 +93,8 @@ void record_dive_to_table(struct dive *dive, struct dive_table *table)
 
 	dives[nr] = fixup_dive(dive);
 	table->nr = nr + 1;
+	if (table == &dive_table)
+		dive_appended_to_table();
 }
 
 void record_dive(struct dive *dive)
@@ -484,11 +488,9 @@ void add_dive_site(char *ds_name, struct dive *dive)
 					struct dive_site *newds = get_dive_site_by_uuid(dive->dive_site_uuid);
 					if (cur_latitude.udeg || cur_longitude.udeg) {
 						// we started this uuid with GPS data, so lets use those
-						newds->latitude = cur_latitude;
-						newds->longitude = cur_longitude;
+						set_dive_site_gps(newds, cur_latitude, cur_longitude);
 					} else {
-						newds->latitude = ds->latitude;
-						newds->longitude = ds->longitude;
+						set_dive_site_gps(newds, ds->latitude, ds->longitude);
 					}
 					newds->notes = add_to_string(newds->notes, translate("gettextFromC", "additional name for site: %s\n"), ds->name);
 				}
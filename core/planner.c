@@ -20,27 +20,32 @@
 
 #define TIMESTEP 2 /* second */
 
-int decostoplevels_metric[] = { 0, 3000, 6000, 9000, 12000, 15000, 18000, 21000, 24000, 27000,
+static const int decostoplevels_metric[] = { 0, 3000, 6000, 9000, 12000, 15000, 18000, 21000, 24000, 27000,
 				  30000, 33000, 36000, 39000, 42000, 45000, 48000, 51000, 54000, 57000,
 				  60000, 63000, 66000, 69000, 72000, 75000, 78000, 81000, 84000, 87000,
 				  90000, 100000, 110000, 120000, 130000, 140000, 150000, 160000, 170000,
 				  180000, 190000, 200000, 220000, 240000, 260000, 280000, 300000,
 				  320000, 340000, 360000, 380000 };
-int decostoplevels_imperial[] = { 0, 3048, 6096, 9144, 12192, 15240, 18288, 21336, 24384, 27432,
+static const int decostoplevels_imperial[] = { 0, 3048, 6096, 9144, 12192, 15240, 18288, 21336, 24384, 27432,
 				30480, 33528, 36576, 39624, 42672, 45720, 48768, 51816, 54864, 57912,
 				60960, 64008, 67056, 70104, 73152, 76200, 79248, 82296, 85344, 88392,
 				91440, 101600, 111760, 121920, 132080, 142240, 152400, 162560, 172720,
 				182880, 193040, 203200, 223520, 243840, 264160, 284480, 304800,
 				325120, 345440, 365760, 386080 };
+#define STOPLEVELS (sizeof(decostoplevels_metric) / sizeof(int))
+
+struct gaschanges {
+	int depth;
+	int gasidx;
+};
 
 double plangflow, plangfhigh;
 
-extern double regressiona();
-extern double regressionb();
-extern void reset_regression();
+extern double regressiona(const struct deco_state *ds);
+extern double regressionb(const struct deco_state *ds);
+extern void reset_regression(struct deco_state *ds);
 
 char *disclaimer;
-int plot_depth = 0;
 #if DEBUG_PLAN
 void dump_plan(struct diveplan *diveplan)
 {
@@ -123,11 +128,213 @@ void interpolate_transition(struct deco_state *ds, struct dive *dive, duration_t
 		add_segment(ds, depth_to_bar(depth, dive), gasmix, 1, po2.mbar, dive, prefs.bottomsac);
 	}
 	if (d1.mm > d0.mm)
-		calc_crushing_pressure(ds, depth_to_bar(d1.mm, &displayed_dive));
+		calc_crushing_pressure(ds, depth_to_bar(d1.mm, dive));
+}
+
+/*
+ * A plan that is changed interactively, e.g. by dragging a waypoint in the
+ * profile, mostly starts like the one before. With a plan cache, plan()
+ * keeps the deco state after each sample of the manually entered part of
+ * the dive and the ascent it calculated, together with everything that went
+ * into it. The next plan then resumes from the last sample before the first
+ * change and only calculates the ascent again if it starts differently.
+ */
+
+/* what tissue_at_end() adds for a sample */
+struct segment_input {
+	int time;
+	int depth;
+	int setpoint;
+	int o2, he;
+};
+
+/* what the ascent of plan() starts from, besides the deco state */
+struct ascent_input {
+	int depth, bottom_time, avg_depth, timestep;
+	int current_cylinder, best_first_ascend_cylinder, po2;
+	int stopidx, gi, gaschangenr;
+	int stoplevels[STOPLEVELS + MAX_CYLINDERS];
+	struct gaschanges gaschanges[MAX_CYLINDERS];
+	int plan_surface_pressure, surface_pressure, salinity, divemode, deco_mode;
+	struct gasmix gasmix[MAX_CYLINDERS];
+	/* the preferences the ascent reads */
+	int ascrate75, ascrate50, ascratestops, ascratelast6m;
+	int bottomsac, decosac, o2consumption, pscr_ratio, min_switch_duration;
+	bool last_stop, doo2breaks, switch_at_req_stop, safetystop;
+};
+
+/* the deco state tissue_at_end() started from and the one after each sample */
+struct tissue_cache {
+	struct deco_state start;
+	int surface_pressure, salinity, divemode, deco_mode;
+	int resumed;	/* the samples the last resume_tissues() skipped */
+	int nr, allocated;
+	struct segment_input *input;
+	struct deco_state *segment_ds;
+};
+
+struct plan_cache {
+	/* plan() calls tissue_at_end() twice, with different VPM-B gradients */
+	struct tissue_cache bottom[2];
+
+	/* the last calculated ascent */
+	bool has_ascent, ascent_restored;
+	struct ascent_input ascent;
+	struct deco_state ascent_start;
+	struct deco_state ascent_end;
+	struct divedatapoint *tail;
+	struct decostop *stops;
+	int nr_stops;
+	int clock, previous_point_time, current_cylinder, first_stop_depth, error;
+	bool decodive;
+};
+
+struct plan_cache *alloc_plan_cache(void)
+{
+	return calloc(1, sizeof(struct plan_cache));
+}
+
+static void free_tail(struct plan_cache *cache)
+{
+	while (cache->tail) {
+		struct divedatapoint *next = cache->tail->next;
+		free(cache->tail);
+		cache->tail = next;
+	}
+}
+
+void free_plan_cache(struct plan_cache *cache)
+{
+	int i;
+
+	if (!cache)
+		return;
+	for (i = 0; i < 2; i++) {
+		free(cache->bottom[i].input);
+		free(cache->bottom[i].segment_ds);
+	}
+	free_tail(cache);
+	free(cache->stops);
+	free(cache);
+}
+
+/* How much of the last plan came from the cache: the samples of the dive whose
+ * tissues were restored and whether the whole ascent was. */
+int plan_cache_resumed_samples(const struct plan_cache *cache)
+{
+	return cache->bottom[0].resumed;
+}
+
+bool plan_cache_ascent_restored(const struct plan_cache *cache)
+{
+	return cache->ascent_restored;
+}
+
+/*
+ * Do the two deco states develop the same while the bottom part of the dive is
+ * added? Fields that are only calculated from the others are not compared, nor
+ * are the VPM-B gradients: vpmb_start_gradient() calculates them again before
+ * they are used, and restore_deco_state() keeps those the last plan left behind.
+ */
+static bool same_tissues(const struct deco_state *a, const struct deco_state *b)
+{
+	return !memcmp(a->tissue_n2_sat, b->tissue_n2_sat, sizeof(a->tissue_n2_sat)) &&
+	       !memcmp(a->tissue_he_sat, b->tissue_he_sat, sizeof(a->tissue_he_sat)) &&
+	       !memcmp(a->max_n2_crushing_pressure, b->max_n2_crushing_pressure, sizeof(a->max_n2_crushing_pressure)) &&
+	       !memcmp(a->max_he_crushing_pressure, b->max_he_crushing_pressure, sizeof(a->max_he_crushing_pressure)) &&
+	       !memcmp(a->crushing_onset_tension, b->crushing_onset_tension, sizeof(a->crushing_onset_tension)) &&
+	       !memcmp(a->n2_regen_radius, b->n2_regen_radius, sizeof(a->n2_regen_radius)) &&
+	       !memcmp(a->he_regen_radius, b->he_regen_radius, sizeof(a->he_regen_radius)) &&
+	       a->max_ambient_pressure == b->max_ambient_pressure &&
+	       a->first_ceiling_pressure.mbar == b->first_ceiling_pressure.mbar &&
+	       a->max_bottom_ceiling_pressure.mbar == b->max_bottom_ceiling_pressure.mbar &&
+	       a->gf_low_pressure_this_dive == b->gf_low_pressure_this_dive &&
+	       a->params.gf_low == b->params.gf_low &&
+	       a->params.gf_high == b->params.gf_high &&
+	       a->params.vpmb_conservatism == b->params.vpmb_conservatism;
+}
+
+/* the same, including the VPM-B gradients the ascent starts with */
+static bool same_deco_state(const struct deco_state *a, const struct deco_state *b)
+{
+	return same_tissues(a, b) &&
+	       !memcmp(a->bottom_n2_gradient, b->bottom_n2_gradient, sizeof(a->bottom_n2_gradient)) &&
+	       !memcmp(a->bottom_he_gradient, b->bottom_he_gradient, sizeof(a->bottom_he_gradient)) &&
+	       !memcmp(a->initial_n2_gradient, b->initial_n2_gradient, sizeof(a->initial_n2_gradient)) &&
+	       !memcmp(a->initial_he_gradient, b->initial_he_gradient, sizeof(a->initial_he_gradient));
+}
+
+/* like restore_deco_state(), the gradient factor regression is kept */
+static void restore_checkpoint(const struct deco_state *checkpoint, struct deco_state *ds)
+{
+	struct deco_regression regression = ds->regression;
+
+	*ds = *checkpoint;
+	ds->regression = regression;
+}
+
+static void get_segment_input(struct dive *dive, int i, struct segment_input *input)
+{
+	struct sample *sample = dive->dc.sample + i;
+	duration_t t0 = { .seconds = i ? sample[-1].time.seconds : 0 };
+	struct gasmix gas;
+
+	get_gas_at_time(dive, &dive->dc, t0, &gas);
+	memset(input, 0, sizeof(*input));
+	input->time = sample->time.seconds;
+	input->depth = sample->depth.mm;
+	input->setpoint = i ? sample[-1].setpoint.mbar : sample->setpoint.mbar;
+	input->o2 = gas.o2.permille;
+	input->he = gas.he.permille;
+}
+
+/* Restore the deco state after the last sample that is the same as in the last plan. Returns the number of samples to skip. */
+static int resume_tissues(struct tissue_cache *cache, struct deco_state *ds, struct dive *dive)
+{
+	int i;
+
+	if (!same_tissues(ds, &cache->start) ||
+	    cache->surface_pressure != dive->surface_pressure.mbar ||
+	    cache->salinity != dive->salinity ||
+	    cache->divemode != dive->dc.divemode ||
+	    cache->deco_mode != ds->params.deco_mode) {
+		cache->start = *ds;
+		cache->surface_pressure = dive->surface_pressure.mbar;
+		cache->salinity = dive->salinity;
+		cache->divemode = dive->dc.divemode;
+		cache->deco_mode = ds->params.deco_mode;
+		cache->nr = 0;
+		cache->resumed = 0;
+		return 0;
+	}
+	for (i = 0; i < cache->nr && i < dive->dc.samples; i++) {
+		struct segment_input input;
+
+		get_segment_input(dive, i, &input);
+		if (memcmp(&input, cache->input + i, sizeof(input)))
+			break;
+	}
+	cache->nr = i;
+	cache->resumed = i;
+	if (i)
+		restore_checkpoint(cache->segment_ds + i - 1, ds);
+	return i;
+}
+
+static void add_tissue_checkpoint(struct tissue_cache *cache, struct deco_state *ds, struct dive *dive, int i)
+{
+	if (i >= cache->allocated) {
+		cache->allocated = (i + 1) * 3 / 2 + 8;
+		cache->input = realloc(cache->input, cache->allocated * sizeof(struct segment_input));
+		cache->segment_ds = realloc(cache->segment_ds, cache->allocated * sizeof(struct deco_state));
+	}
+	get_segment_input(dive, i, cache->input + i);
+	cache->segment_ds[i] = *ds;
+	cache->nr = i + 1;
 }
 
 /* returns the tissue tolerance at the end of this (partial) dive */
-int tissue_at_end(struct deco_state *ds, struct dive *dive, struct deco_state **cached_datap)
+int tissue_at_end(struct deco_state *ds, struct dive *dive, struct deco_state **cached_datap, struct tissue_cache *cache)
 {
 	struct divecomputer *dc;
 	struct sample *sample, *psample;
@@ -136,21 +343,31 @@ int tissue_at_end(struct deco_state *ds, struct dive *dive, struct deco_state **
 	duration_t t0 = {}, t1 = {};
 	struct gasmix gas;
 	int surface_interval = 0;
+	struct deco_parameters params;
 
 	if (!dive)
 		return 0;
+	/* a cached state might be from before the parameters changed */
+	params = ds->params;
 	if (*cached_datap) {
 		restore_deco_state(*cached_datap, ds, true);
 	} else {
 		surface_interval = init_decompression(ds, dive);
 		cache_deco_state(ds, cached_datap);
 	}
+	ds->params = params;
 	dc = &dive->dc;
 	if (!dc->samples)
 		return 0;
 	psample = sample = dc->sample;
 
-	for (i = 0; i < dc->samples; i++, sample++) {
+	i = cache ? resume_tissues(cache, ds, dive) : 0;
+	if (i) {
+		psample = dc->sample + i - 1;
+		sample = dc->sample + i;
+		t0 = psample->time;
+	}
+	for (; i < dc->samples; i++, sample++) {
 		o2pressure_t setpoint;
 
 		if (i)
@@ -172,7 +389,7 @@ int tissue_at_end(struct deco_state *ds, struct dive *dive, struct deco_state **
 		 * portion of the dive.
 		 * Remember the value for later.
 		 */
-		if ((decoMode() == VPMB) && (lastdepth.mm > sample->depth.mm)) {
+		if ((ds->params.deco_mode == VPMB) && (lastdepth.mm > sample->depth.mm)) {
 			pressure_t ceiling_pressure;
 			nuclear_regeneration(ds, t0.seconds);
 			vpmb_start_gradient(ds);
@@ -189,6 +406,8 @@ int tissue_at_end(struct deco_state *ds, struct dive *dive, struct deco_state **
 		interpolate_transition(ds, dive, t0, t1, lastdepth, sample->depth, &gas, setpoint);
 		psample = sample;
 		t0 = t1;
+		if (cache)
+			add_tissue_checkpoint(cache, ds, dive, i);
 	}
 	return surface_interval;
 }
@@ -292,7 +511,7 @@ static void create_dive_from_plan(struct diveplan *diveplan, struct dive *dive,
 	 * O2 setpoint for this sample will be filled later from next dp */
 	cyl = &dive->cylinder[0];
 	sample = prepare_sample(dc);
-	sample->sac.mliter = prefs.bottomsac;
+	sample->sac.mliter = diveplan->bottomsac;
 	if (track_gas && cyl->type.workingpressure.mbar)
 		sample->pressure[0].mbar = cyl->end.mbar;
 	sample->manually_entered = true;
@@ -331,7 +550,7 @@ static void create_dive_from_plan(struct diveplan *diveplan, struct dive *dive,
 			sample->time.seconds = lasttime + 1;
 			sample->depth = lastdepth;
 			sample->manually_entered = dp->entered;
-			sample->sac.mliter = dp->entered ? prefs.bottomsac : prefs.decosac;
+			sample->sac.mliter = dp->entered ? diveplan->bottomsac : diveplan->decosac;
 			finish_sample(dc);
 			lastcylid = dp->cylinderid;
 		}
@@ -345,7 +564,7 @@ static void create_dive_from_plan(struct diveplan *diveplan, struct dive *dive,
 		if (dp->entered) last_manual_point = dp->time;
 		sample->depth = lastdepth = depth;
 		sample->manually_entered = dp->entered;
-		sample->sac.mliter = dp->entered ? prefs.bottomsac : prefs.decosac;
+		sample->sac.mliter = dp->entered ? diveplan->bottomsac : diveplan->decosac;
 		if (track_gas && !sample[-1].setpoint.mbar) {    /* Don't track gas usage for CCR legs of dive */
 			update_cylinder_pressure(dive, sample[-1].depth.mm, depth.mm, time - sample[-1].time.seconds,
 					dp->entered ? diveplan->bottomsac : diveplan->decosac, cyl, !dp->entered);
@@ -416,18 +635,13 @@ struct divedatapoint *plan_add_segment(struct diveplan *diveplan, int duration,
 	return dp;
 }
 
-struct gaschanges {
-	int depth;
-	int gasidx;
-};
-
 
-static struct gaschanges *analyze_gaslist(struct diveplan *diveplan, int *gaschangenr, int depth, int *asc_cylinder)
+static struct gaschanges *analyze_gaslist(struct diveplan *diveplan, struct dive *dive, int *gaschangenr, int depth, int *asc_cylinder)
 {
 	int nr = 0;
 	struct gaschanges *gaschanges = NULL;
 	struct divedatapoint *dp = diveplan->dp;
-	int best_depth = displayed_dive.cylinder[*asc_cylinder].depth.mm;
+	int best_depth = dive->cylinder[*asc_cylinder].depth.mm;
 	bool total_time_zero = true;
 	while (dp) {
 		if (dp->time == 0 && total_time_zero) {
@@ -462,7 +676,7 @@ static struct gaschanges *analyze_gaslist(struct diveplan *diveplan, int *gascha
 	for (nr = 0; nr < *gaschangenr; nr++) {
 		int idx = gaschanges[nr].gasidx;
 		printf("gaschange nr %d: @ %5.2lfm gasidx %d (%s)\n", nr, gaschanges[nr].depth / 1000.0,
-		       idx, gasname(&displayed_dive.cylinder[idx].gasmix));
+		       idx, gasname(&dive->cylinder[idx].gasmix));
 	}
 #endif
 	return gaschanges;
@@ -543,15 +757,15 @@ int ascent_velocity(int depth, int avg_depth, int bottom_time)
 	}
 }
 
-void track_ascent_gas(int depth, cylinder_t *cylinder, int avg_depth, int bottom_time, bool safety_stop)
+void track_ascent_gas(int depth, struct dive *dive, cylinder_t *cylinder, int avg_depth, int bottom_time, bool safety_stop, int sac)
 {
 	while (depth > 0) {
 		int deltad = ascent_velocity(depth, avg_depth, bottom_time) * TIMESTEP;
 		if (deltad > depth)
 			deltad = depth;
-		update_cylinder_pressure(&displayed_dive, depth, depth - deltad, TIMESTEP, prefs.decosac, cylinder, true);
+		update_cylinder_pressure(dive, depth, depth - deltad, TIMESTEP, sac, cylinder, true);
 		if (depth <= 5000 && depth >= (5000 - deltad) && safety_stop) {
-			update_cylinder_pressure(&displayed_dive, 5000, 5000, 180, prefs.decosac, cylinder, true);
+			update_cylinder_pressure(dive, 5000, 5000, 180, sac, cylinder, true);
 			safety_stop = false;
 		}
 		depth -= deltad;
@@ -563,21 +777,20 @@ bool trial_ascent(struct deco_state *ds, int wait_time, int trial_depth, int sto
 {
 
 	bool clear_to_ascend = true;
-	struct deco_state *trial_cache = NULL;
+	// The trial runs on a copy on the stack; only the gradient factor regression is kept, see restore_deco_state()
+	struct deco_state trial_state = *ds;
 
 	// For consistency with other VPM-B implementations, we should not start the ascent while the ceiling is
 	// deeper than the next stop (thus the offgasing during the ascent is ignored).
 	// However, we still need to make sure we don't break the ceiling due to on-gassing during ascent.
-	cache_deco_state(ds, &trial_cache);
 	if (wait_time)
-		add_segment(ds, depth_to_bar(trial_depth, dive),
+		add_segment(&trial_state, depth_to_bar(trial_depth, dive),
 			    gasmix,
 			    wait_time, po2, dive, prefs.decosac);
-	if (decoMode() == VPMB && (deco_allowed_depth(tissue_tolerance_calc(ds, dive,depth_to_bar(stoplevel, dive)),
+	if (ds->params.deco_mode == VPMB && (deco_allowed_depth(tissue_tolerance_calc(&trial_state, dive,depth_to_bar(stoplevel, dive)),
 						      surface_pressure, dive, 1)
 				   > stoplevel)) {
-		restore_deco_state(trial_cache, ds, false);
-		free(trial_cache);
+		ds->regression = trial_state.regression;
 		return false;
 	}
 
@@ -585,10 +798,10 @@ bool trial_ascent(struct deco_state *ds, int wait_time, int trial_depth, int sto
 		int deltad = ascent_velocity(trial_depth, avg_depth, bottom_time) * TIMESTEP;
 		if (deltad > trial_depth) /* don't test against depth above surface */
 			deltad = trial_depth;
-		add_segment(ds, depth_to_bar(trial_depth, dive),
+		add_segment(&trial_state, depth_to_bar(trial_depth, dive),
 			    gasmix,
 			    TIMESTEP, po2, dive, prefs.decosac);
-		if (deco_allowed_depth(tissue_tolerance_calc(ds, dive, depth_to_bar(trial_depth, dive)),
+		if (deco_allowed_depth(tissue_tolerance_calc(&trial_state, dive, depth_to_bar(trial_depth, dive)),
 				       surface_pressure, dive, 1) > trial_depth - deltad) {
 			/* We should have stopped */
 			clear_to_ascend = false;
@@ -596,8 +809,7 @@ bool trial_ascent(struct deco_state *ds, int wait_time, int trial_depth, int sto
 		}
 		trial_depth -= deltad;
 	}
-	restore_deco_state(trial_cache, ds, false);
-	free(trial_cache);
+	ds->regression = trial_state.regression;
 	return clear_to_ascend;
 }
 
@@ -605,10 +817,10 @@ bool trial_ascent(struct deco_state *ds, int wait_time, int trial_depth, int sto
  * Also return true if this cannot be calculated because the cylinder doesn't have
  * size or a starting pressure.
  */
-bool enough_gas(int current_cylinder)
+bool enough_gas(struct dive *dive, int current_cylinder)
 {
 	cylinder_t *cyl;
-	cyl = &displayed_dive.cylinder[current_cylinder];
+	cyl = &dive->cylinder[current_cylinder];
 
 	if (!cyl->start.mbar)
 		return true;
@@ -641,6 +853,46 @@ int wait_until(struct deco_state *ds, struct dive *dive, int clock, int min, int
 	return wait_until(ds, dive, clock, min, leap / 2, stepsize, depth, target_depth, avg_depth, bottom_time, gasmix, po2, surface_pressure);
 }
 
+/* Find the time the ceiling is clear to ascent to target_depth, an integer multiple of stepsize after clock.
+ * With Buehlmann, the leading compartments predict it in closed form (see clear_time()) and two trial
+ * ascents confirm the prediction: the ascent has to pass at the predicted time and fail one step earlier,
+ * so that the result is the same wait_until() would find. If they don't, or with VPM-B, wait_until()
+ * searches for it.
+ */
+int stop_end_time(struct deco_state *ds, struct dive *dive, int clock, int leap, int stepsize, int depth, int target_depth, int avg_depth, int bottom_time, struct gasmix *gasmix, int po2, double surface_pressure)
+{
+	if (ds->params.deco_mode != VPMB) {
+		struct deco_sequence ascent;
+		int trial_depth = depth;
+
+		// The same steps as in trial_ascent()
+		clear_deco_sequence(&ascent);
+		while (trial_depth > target_depth) {
+			int deltad = ascent_velocity(trial_depth, avg_depth, bottom_time) * TIMESTEP;
+			if (deltad > trial_depth)
+				deltad = trial_depth;
+			add_segment_to_sequence(ds, &ascent, depth_to_bar(trial_depth, dive), gasmix, TIMESTEP, po2, dive);
+			trial_depth -= deltad;
+		}
+
+		double wait = clear_time(ds, depth_to_bar(depth, dive), gasmix, po2, dive, &ascent, trial_depth, surface_pressure, 48 * 3600);
+		if (wait < 48 * 3600) {
+			// Round up to the next multiple of stepsize, but wait at least a second
+			int end = clock + MAX((int)ceil(wait), 1);
+			end += stepsize - 1 - (end - 1) % stepsize;
+			if (trial_ascent(ds, end - clock, depth, target_depth, avg_depth, bottom_time, gasmix, po2, surface_pressure, dive)) {
+				if (end - stepsize <= clock ||
+				    !trial_ascent(ds, end - stepsize - clock, depth, target_depth, avg_depth, bottom_time, gasmix, po2, surface_pressure, dive))
+					return end;
+				// The prediction was late, search below it
+				return wait_until(ds, dive, clock, clock, end - stepsize - clock, stepsize, depth, target_depth, avg_depth, bottom_time, gasmix, po2, surface_pressure);
+			}
+			return wait_until(ds, dive, clock, end, leap, stepsize, depth, target_depth, avg_depth, bottom_time, gasmix, po2, surface_pressure);
+		}
+	}
+	return wait_until(ds, dive, clock, clock, leap, stepsize, depth, target_depth, avg_depth, bottom_time, gasmix, po2, surface_pressure);
+}
+
 // Work out the stops. Return value is if there were any mandatory stops.
 
 
@@ -652,6 +904,129 @@ void printdecotable(struct decostop *table)
 	}
 }
 
+static void get_ascent_input(struct ascent_input *input, const struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, int depth, int bottom_time, int avg_depth, int timestep,
+			     int current_cylinder, int best_first_ascend_cylinder, int po2, int stopidx, int gi, int gaschangenr,
+			     const int *stoplevels, const struct gaschanges *gaschanges)
+{
+	int i;
+
+	memset(input, 0, sizeof(*input));
+	input->depth = depth;
+	input->bottom_time = bottom_time;
+	input->avg_depth = avg_depth;
+	input->timestep = timestep;
+	input->current_cylinder = current_cylinder;
+	input->best_first_ascend_cylinder = best_first_ascend_cylinder;
+	input->po2 = po2;
+	input->stopidx = stopidx;
+	input->gi = gi;
+	input->gaschangenr = gaschangenr;
+	memcpy(input->stoplevels, stoplevels, (stopidx + 1) * sizeof(int));
+	if (gaschangenr)
+		memcpy(input->gaschanges, gaschanges, gaschangenr * sizeof(struct gaschanges));
+	input->plan_surface_pressure = diveplan->surface_pressure;
+	input->surface_pressure = dive->surface_pressure.mbar;
+	input->salinity = dive->salinity;
+	input->divemode = dive->dc.divemode;
+	input->deco_mode = ds->params.deco_mode;
+	for (i = 0; i < MAX_CYLINDERS; i++)
+		input->gasmix[i] = dive->cylinder[i].gasmix;
+	input->ascrate75 = prefs.ascrate75;
+	input->ascrate50 = prefs.ascrate50;
+	input->ascratestops = prefs.ascratestops;
+	input->ascratelast6m = prefs.ascratelast6m;
+	input->bottomsac = diveplan->bottomsac;
+	input->decosac = diveplan->decosac;
+	input->o2consumption = prefs.o2consumption;
+	input->pscr_ratio = prefs.pscr_ratio;
+	input->min_switch_duration = prefs.min_switch_duration;
+	input->last_stop = prefs.last_stop;
+	input->doo2breaks = prefs.doo2breaks;
+	input->switch_at_req_stop = prefs.switch_at_req_stop;
+	input->safetystop = prefs.safetystop;
+}
+
+/* The unused stop levels and gas changes are zero, see get_ascent_input() */
+static bool same_ascent_input(const struct ascent_input *a, const struct ascent_input *b)
+{
+	int i;
+
+	if (a->depth != b->depth || a->bottom_time != b->bottom_time || a->avg_depth != b->avg_depth ||
+	    a->timestep != b->timestep || a->current_cylinder != b->current_cylinder ||
+	    a->best_first_ascend_cylinder != b->best_first_ascend_cylinder || a->po2 != b->po2 ||
+	    a->stopidx != b->stopidx || a->gi != b->gi || a->gaschangenr != b->gaschangenr ||
+	    a->plan_surface_pressure != b->plan_surface_pressure || a->surface_pressure != b->surface_pressure ||
+	    a->salinity != b->salinity || a->divemode != b->divemode || a->deco_mode != b->deco_mode)
+		return false;
+	if (memcmp(a->stoplevels, b->stoplevels, sizeof(a->stoplevels)))
+		return false;
+	for (i = 0; i < MAX_CYLINDERS; i++) {
+		if (a->gaschanges[i].depth != b->gaschanges[i].depth || a->gaschanges[i].gasidx != b->gaschanges[i].gasidx ||
+		    a->gasmix[i].o2.permille != b->gasmix[i].o2.permille || a->gasmix[i].he.permille != b->gasmix[i].he.permille)
+			return false;
+	}
+	return a->ascrate75 == b->ascrate75 && a->ascrate50 == b->ascrate50 &&
+	       a->ascratestops == b->ascratestops && a->ascratelast6m == b->ascratelast6m &&
+	       a->bottomsac == b->bottomsac && a->decosac == b->decosac &&
+	       a->o2consumption == b->o2consumption && a->pscr_ratio == b->pscr_ratio &&
+	       a->min_switch_duration == b->min_switch_duration && a->last_stop == b->last_stop &&
+	       a->doo2breaks == b->doo2breaks && a->switch_at_req_stop == b->switch_at_req_stop &&
+	       a->safetystop == b->safetystop;
+}
+
+/* If the ascent starts like the last one, add it to the plan again. Otherwise remember its start for save_ascent(). */
+static bool restore_ascent(struct plan_cache *cache, const struct ascent_input *input, struct deco_state *ds,
+			   struct diveplan *diveplan, struct decostop *decostoptable)
+{
+	struct divedatapoint *dp, **tail;
+
+	if (!cache->has_ascent || !same_ascent_input(input, &cache->ascent) ||
+	    !same_deco_state(ds, &cache->ascent_start)) {
+		cache->has_ascent = cache->ascent_restored = false;
+		cache->ascent_start = *ds;
+		return false;
+	}
+	cache->ascent_restored = true;
+	tail = &diveplan->dp;
+	while (*tail)
+		tail = &(*tail)->next;
+	for (dp = cache->tail; dp; dp = dp->next) {
+		*tail = malloc(sizeof(struct divedatapoint));
+		**tail = *dp;
+		tail = &(*tail)->next;
+	}
+	*tail = NULL;
+	memcpy(decostoptable, cache->stops, cache->nr_stops * sizeof(struct decostop));
+	*ds = cache->ascent_end;
+	return true;
+}
+
+/* Remember the ascent, i.e. the data points after the last one before it */
+static void save_ascent(struct plan_cache *cache, const struct ascent_input *input, const struct deco_state *end,
+			struct divedatapoint *last, const struct decostop *decostoptable, int nr_stops)
+{
+	struct divedatapoint *dp, **tail;
+
+	cache->has_ascent = true;
+	cache->ascent = *input;
+	cache->ascent_end = *end;
+	free_tail(cache);
+	tail = &cache->tail;
+	for (dp = last->next; dp; dp = dp->next) {
+		*tail = malloc(sizeof(struct divedatapoint));
+		**tail = *dp;
+		tail = &(*tail)->next;
+	}
+	*tail = NULL;
+	free(cache->stops);
+	cache->nr_stops = nr_stops;
+	cache->stops = malloc(nr_stops * sizeof(struct decostop));
+	memcpy(cache->stops, decostoptable, nr_stops * sizeof(struct decostop));
+}
+
+/* The deco model comes from ds->params and the dive from diveplan. The ascent rates, stop and gas switch
+ * options and the units of the stop levels are planner preferences read from prefs: they must not change
+ * while plans are calculated, which is why the batch planner applies its settings before starting. */
 bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, int timestep, struct decostop *decostoptable, struct deco_state **cached_datap, bool is_planner, bool show_disclaimer)
 {
 
@@ -661,7 +1036,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 	bool is_final_plan = true;
 	int bottom_time;
 	int previous_deco_time;
-	struct deco_state *bottom_cache = NULL;
+	struct deco_state bottom_state;
 	struct sample *sample;
 	int po2;
 	int transitiontime, gi;
@@ -670,8 +1045,8 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 	int depth;
 	struct gaschanges *gaschanges = NULL;
 	int gaschangenr;
-	int *decostoplevels;
-	int decostoplevelcount;
+	int decostoplevels[sizeof(decostoplevels_metric) / sizeof(int)];
+	int decostoplevelcount = sizeof(decostoplevels) / sizeof(int);
 	int *stoplevels = NULL;
 	bool stopping = false;
 	bool pendinggaschange = false;
@@ -689,24 +1064,29 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 	int laststoptime = timestep;
 	bool o2breaking = false;
 	int decostopcounter = 0;
+	struct plan_cache *cache = diveplan->cache;
+	struct ascent_input ascent_input;
+	struct divedatapoint *last_dp;
+	bool ascent_cached = false;
 
-	set_gf(diveplan->gflow, diveplan->gfhigh);
-	set_vpmb_conservatism(diveplan->vpmb_conservatism);
+	if (cache)
+		cache->ascent_restored = false;
 	if (!diveplan->surface_pressure)
 		diveplan->surface_pressure = SURFACE_PRESSURE;
 	dive->surface_pressure.mbar = diveplan->surface_pressure;
+	/* The deco model and the default parameters are the ones the caller set with
+	 * init_deco_parameters(), so that plans can be calculated on other threads */
+	set_deco_parameters(ds, diveplan->gflow, diveplan->gfhigh, diveplan->vpmb_conservatism);
 	clear_deco(ds, dive->surface_pressure.mbar / 1000.0);
 	ds->max_bottom_ceiling_pressure.mbar = ds->first_ceiling_pressure.mbar = 0;
 	create_dive_from_plan(diveplan, dive, is_planner);
 
 	// Do we want deco stop array in metres or feet?
-	if (prefs.units.length == METERS ) {
-		decostoplevels = decostoplevels_metric;
-		decostoplevelcount = sizeof(decostoplevels_metric) / sizeof(int);
-	} else {
-		decostoplevels = decostoplevels_imperial;
-		decostoplevelcount = sizeof(decostoplevels_imperial) / sizeof(int);
-	}
+	// It is a copy, so that plans can be calculated concurrently.
+	if (prefs.units.length == METERS )
+		memcpy(decostoplevels, decostoplevels_metric, sizeof(decostoplevels));
+	else
+		memcpy(decostoplevels, decostoplevels_imperial, sizeof(decostoplevels));
 
 	/* If the user has selected last stop to be at 6m/20', we need to get rid of the 3m/10' stop.
 	 * Otherwise reinstate the last stop 3m/10' stop.
@@ -751,7 +1131,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 		gaschanges = NULL;
 		gaschangenr = 0;
 	} else {
-		gaschanges = analyze_gaslist(diveplan, &gaschangenr, depth, &best_first_ascend_cylinder);
+		gaschanges = analyze_gaslist(diveplan, dive, &gaschangenr, depth, &best_first_ascend_cylinder);
 	}
 	/* Find the first potential decostopdepth above current depth */
 	for (stopidx = 0; stopidx < decostoplevelcount; stopidx++)
@@ -766,29 +1146,29 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 	gi = gaschangenr - 1;
 
 	/* Set tissue tolerance and initial vpmb gradient at start of ascent phase */
-	diveplan->surface_interval = tissue_at_end(ds, dive, cached_datap);
+	diveplan->surface_interval = tissue_at_end(ds, dive, cached_datap, cache ? &cache->bottom[0] : NULL);
 	nuclear_regeneration(ds, clock);
 	vpmb_start_gradient(ds);
 
-	if (decoMode() == RECREATIONAL) {
+	if (ds->params.deco_mode == RECREATIONAL) {
 		bool safety_stop = prefs.safetystop && max_depth >= 10000;
-		track_ascent_gas(depth, &dive->cylinder[current_cylinder], avg_depth, bottom_time, safety_stop);
+		track_ascent_gas(depth, dive, &dive->cylinder[current_cylinder], avg_depth, bottom_time, safety_stop, diveplan->decosac);
 		// How long can we stay at the current depth and still directly ascent to the surface?
 		do {
 			add_segment(ds, depth_to_bar(depth, dive),
 				    &dive->cylinder[current_cylinder].gasmix,
 				    timestep, po2, dive, prefs.bottomsac);
-			update_cylinder_pressure(dive, depth, depth, timestep, prefs.bottomsac, &dive->cylinder[current_cylinder], false);
+			update_cylinder_pressure(dive, depth, depth, timestep, diveplan->bottomsac, &dive->cylinder[current_cylinder], false);
 			clock += timestep;
 		} while (trial_ascent(ds, 0, depth, 0, avg_depth, bottom_time, &dive->cylinder[current_cylinder].gasmix,
 				      po2, diveplan->surface_pressure / 1000.0, dive) &&
-			 enough_gas(current_cylinder) && clock < 6 * 3600);
+			 enough_gas(dive, current_cylinder) && clock < 6 * 3600);
 
 		// We did stay one DECOTIMESTEP too many.
 		// In the best of all worlds, we would roll back also the last add_segment in terms of caching deco state, but
 		// let's ignore that since for the eventual ascent in recreational mode, nobody looks at the ceiling anymore,
 		// so we don't really have to compute the deco state.
-		update_cylinder_pressure(dive, depth, depth, -timestep, prefs.bottomsac, &dive->cylinder[current_cylinder], false);
+		update_cylinder_pressure(dive, depth, depth, -timestep, diveplan->bottomsac, &dive->cylinder[current_cylinder], false);
 		clock -= timestep;
 		plan_add_segment(diveplan, clock - previous_point_time, depth, current_cylinder, po2, true);
 		previous_point_time = clock;
@@ -816,7 +1196,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 		} while (depth > 0);
 		plan_add_segment(diveplan, clock - previous_point_time, 0, current_cylinder, po2, false);
 		create_dive_from_plan(diveplan, dive, is_planner);
-		add_plan_to_notes(diveplan, dive, show_disclaimer, error);
+		add_plan_to_notes(diveplan, dive, ds->params.deco_mode, show_disclaimer, error);
 		fixup_dc_duration(&dive->dc);
 
 		free(stoplevels);
@@ -835,24 +1215,42 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 	}
 
 	// VPM-B or Buehlmann Deco
-	tissue_at_end(ds, dive, cached_datap);
+	tissue_at_end(ds, dive, cached_datap, cache ? &cache->bottom[1] : NULL);
 	previous_deco_time = 100000000;
 	ds->deco_time = 10000000;
-	cache_deco_state(ds, &bottom_cache);  // Lets us make several iterations
+	bottom_state = *ds;  // Lets us make several iterations
 	bottom_depth = depth;
 	bottom_gi = gi;
 	bottom_gas = gas;
 	bottom_stopidx = stopidx;
 
+	for (last_dp = diveplan->dp; last_dp && last_dp->next; last_dp = last_dp->next)
+		;
+	/* Only the manually entered part of the dive might have changed, e.g. while a waypoint is dragged */
+	if (cache) {
+		get_ascent_input(&ascent_input, ds, diveplan, dive, depth, bottom_time, avg_depth, timestep, current_cylinder,
+				 best_first_ascend_cylinder, po2, stopidx, gi, gaschangenr, stoplevels, gaschanges);
+		ascent_cached = restore_ascent(cache, &ascent_input, ds, diveplan, decostoptable);
+	}
+	if (ascent_cached) {
+		decostopcounter = cache->nr_stops - 1;
+		clock = cache->clock;
+		previous_point_time = cache->previous_point_time;
+		current_cylinder = cache->current_cylinder;
+		first_stop_depth = cache->first_stop_depth;
+		error = cache->error;
+		decodive = cache->decodive;
+	}
+
 	//CVA
-	do {
+	while (!ascent_cached) {
 		decostopcounter = 0;
-		is_final_plan = (decoMode() == BUEHLMANN) || (previous_deco_time - ds->deco_time < 10);  // CVA time converges
+		is_final_plan = (ds->params.deco_mode == BUEHLMANN) || (previous_deco_time - ds->deco_time < 10);  // CVA time converges
 		if (ds->deco_time != 10000000)
 			vpmb_next_gradient(ds, ds->deco_time, diveplan->surface_pressure / 1000.0);
 
 		previous_deco_time = ds->deco_time;
-		restore_deco_state(bottom_cache, ds, true);
+		restore_deco_state(&bottom_state, ds, true);
 
 		depth = bottom_depth;
 		gi = bottom_gi;
@@ -879,7 +1277,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 			report_error(translate("gettextFromC", "Can't find gas %s"), gasname(&gas));
 			current_cylinder = 0;
 		}
-		reset_regression();
+		reset_regression(ds);
 		while (1) {
 			/* We will break out when we hit the surface */
 			do {
@@ -903,7 +1301,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 				depth -= deltad;
 				/* Print VPM-Gradient as gradient factor, this has to be done from within deco.c */
 				if (decodive)
-					plot_depth = depth;
+					ds->regression.plot_depth = depth;
 			} while (depth > 0 && depth > stoplevels[stopidx]);
 
 			if (depth <= 0)
@@ -997,7 +1395,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 					pendinggaschange = false;
 				}
 
-				int new_clock = wait_until(ds, dive, clock, clock, laststoptime * 2 + 1, timestep, depth, stoplevels[stopidx], avg_depth, bottom_time, &dive->cylinder[current_cylinder].gasmix, po2, diveplan->surface_pressure / 1000.0);
+				int new_clock = stop_end_time(ds, dive, clock, laststoptime * 2 + 1, timestep, depth, stoplevels[stopidx], avg_depth, bottom_time, &dive->cylinder[current_cylinder].gasmix, po2, diveplan->surface_pressure / 1000.0);
 				laststoptime = new_clock - clock;
 				/* Finish infinite deco */
 				if (laststoptime >= 48 * 3600 && depth >= 6000) {
@@ -1068,22 +1466,32 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 		 * if the ascent rate is slower, which is completely nonsensical.
 		 * Assume final ascent takes 20s, which is the time taken to ascend at 9m/min from 3m */
 		ds->deco_time = clock - bottom_time - stoplevels[stopidx + 1] / last_ascend_rate + 20;
-	} while (!is_final_plan);
+		if (is_final_plan)
+			break;
+	}
 	decostoptable[decostopcounter].depth = 0;
+	if (cache && !ascent_cached) {
+		save_ascent(cache, &ascent_input, ds, last_dp, decostoptable, decostopcounter + 1);
+		cache->clock = clock;
+		cache->previous_point_time = previous_point_time;
+		cache->current_cylinder = current_cylinder;
+		cache->first_stop_depth = first_stop_depth;
+		cache->error = error;
+		cache->decodive = decodive;
+	}
 
 	plan_add_segment(diveplan, clock - previous_point_time, 0, current_cylinder, po2, false);
-	if (decoMode() == VPMB) {
-		diveplan->eff_gfhigh = lrint(100.0 * regressionb());
-		diveplan->eff_gflow = lrint(100.0 * (regressiona() * first_stop_depth + regressionb()));
+	if (ds->params.deco_mode == VPMB) {
+		diveplan->eff_gfhigh = lrint(100.0 * regressionb(ds));
+		diveplan->eff_gflow = lrint(100.0 * (regressiona(ds) * first_stop_depth + regressionb(ds)));
 	}
 
 	create_dive_from_plan(diveplan, dive, is_planner);
-	add_plan_to_notes(diveplan, dive, show_disclaimer, error);
+	add_plan_to_notes(diveplan, dive, ds->params.deco_mode, show_disclaimer, error);
 	fixup_dc_duration(&dive->dc);
 
 	free(stoplevels);
 	free(gaschanges);
-	free(bottom_cache);
 	return decodive;
 }
 
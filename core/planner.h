@@ -21,9 +21,13 @@ extern void get_gas_at_time(struct dive *dive, struct divecomputer *dc, duration
 extern int get_cylinderid_at_time(struct dive *dive, struct divecomputer *dc, duration_t time);
 extern int get_gasidx(struct dive *dive, struct gasmix *mix);
 extern bool diveplan_empty(struct diveplan *diveplan);
-extern void add_plan_to_notes(struct diveplan *diveplan, struct dive *dive, bool show_disclaimer, int error);
+extern void add_plan_to_notes(struct diveplan *diveplan, struct dive *dive, enum deco_mode deco_mode, bool show_disclaimer, int error);
 
 extern void free_dps(struct diveplan *diveplan);
+extern struct plan_cache *alloc_plan_cache(void);
+extern void free_plan_cache(struct plan_cache *cache);
+extern int plan_cache_resumed_samples(const struct plan_cache *cache);
+extern bool plan_cache_ascent_restored(const struct plan_cache *cache);
 extern struct dive *planned_dive;
 extern char *cache_data;
 extern char *disclaimer;
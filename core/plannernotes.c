@@ -77,7 +77,7 @@ int add_icd_entry(char *icdbuffer, unsigned int maxsize, struct icd_data *icdval
 	return len;
 }
 
-void add_plan_to_notes(struct diveplan *diveplan, struct dive *dive, bool show_disclaimer, int error)
+void add_plan_to_notes(struct diveplan *diveplan, struct dive *dive, enum deco_mode deco_mode, bool show_disclaimer, int error)
 {
 	const unsigned int sz_buffer = 2000000;
 	const unsigned int sz_temp = 100000;
@@ -87,6 +87,7 @@ void add_plan_to_notes(struct diveplan *diveplan, struct dive *dive, bool show_d
 	char *icdbuffer = (char *)malloc(sz_icdbuf);
 	const char *deco, *segmentsymbol;
 	static char buf[1000];
+	char disclaimer_text[sizeof(buf)];
 	int len, lastdepth = 0, lasttime = 0, lastsetpoint = -1, newdepth = 0, lastprintdepth = 0, lastprintsetpoint = -1;
 	int icdlen = 0;
 	struct gasmix lastprintgasmix = {{ -1 }, { -1 }};
@@ -103,17 +104,23 @@ void add_plan_to_notes(struct diveplan *diveplan, struct dive *dive, bool show_d
 	struct divedatapoint *lastbottomdp = NULL;
 	struct icd_data icdvalues;
 
-	if (decoMode() == VPMB) {
+	if (deco_mode == VPMB) {
 		deco = translate("gettextFromC", "VPM-B");
 	} else {
 		deco = translate("gettextFromC", "BUHLMANN");
 	}
 
-	snprintf(buf, sizeof(buf), translate("gettextFromC", "DISCLAIMER / WARNING: THIS IS A NEW IMPLEMENTATION OF THE %s "
+	snprintf(disclaimer_text, sizeof(disclaimer_text), translate("gettextFromC", "DISCLAIMER / WARNING: THIS IS A NEW IMPLEMENTATION OF THE %s "
 		"ALGORITHM AND A DIVE PLANNER IMPLEMENTATION BASED ON THAT WHICH HAS "
 		"RECEIVED ONLY A LIMITED AMOUNT OF TESTING. WE STRONGLY RECOMMEND NOT TO "
 		"PLAN DIVES SIMPLY BASED ON THE RESULTS GIVEN HERE."), deco);
+	/* plans can be calculated concurrently, only one of them has to update the text
+	 * that the planner looks for in the notes. The notes use the local copy. */
+	lock_planner();
+	if (strcmp(buf, disclaimer_text))
+		strcpy(buf, disclaimer_text);
 	disclaimer = buf;
+	unlock_planner();
 
 	if (!dp)
 		goto finished;
@@ -127,7 +134,7 @@ void add_plan_to_notes(struct diveplan *diveplan, struct dive *dive, bool show_d
 		goto finished;
 	}
 
-	len = show_disclaimer ? snprintf(buffer, sz_buffer, "<div><b>%s</b><br></div>", disclaimer) : 0;
+	len = show_disclaimer ? snprintf(buffer, sz_buffer, "<div><b>%s</b><br></div>", disclaimer_text) : 0;
 
 	if (diveplan->surface_interval < 0) {
 		len += snprintf(buffer + len, sz_buffer - len, "<div><b>%s (%s) %s<br>",
@@ -156,7 +163,7 @@ void add_plan_to_notes(struct diveplan *diveplan, struct dive *dive, bool show_d
 		free((void *)current_date);
 	}
 
-	if (prefs.display_variations && decoMode() != RECREATIONAL)
+	if (prefs.display_variations && deco_mode != RECREATIONAL)
 		len += snprintf_loc(buffer + len, sz_buffer - len, translate("gettextFromC", "Runtime: %dmin%s"),
 			diveplan_duration(diveplan), "VARIATIONS<br></div>");
 	else
@@ -403,10 +410,10 @@ void add_plan_to_notes(struct diveplan *diveplan, struct dive *dive, bool show_d
 	len += snprintf_loc(buffer + len, sz_buffer - len, "<br>%s: %i<br></div>", temp, dive->otu);
 
 	/* Print the settings for the diveplan next. */
-	if (decoMode() == BUEHLMANN) {
+	if (deco_mode == BUEHLMANN) {
 		snprintf_loc(temp, sz_temp, translate("gettextFromC", "Deco model: Bühlmann ZHL-16C with GFLow = %d%% and GFHigh = %d%%"),
 			     diveplan->gflow, diveplan->gfhigh);
-	} else if (decoMode() == VPMB){
+	} else if (deco_mode == VPMB){
 		int temp_len;
 		if (diveplan->vpmb_conservatism == 0)
 			temp_len = snprintf(temp, sz_temp, "%s", translate("gettextFromC", "Deco model: VPM-B at nominal conservatism"));
@@ -416,7 +423,7 @@ void add_plan_to_notes(struct diveplan *diveplan, struct dive *dive, bool show_d
 			temp_len += snprintf_loc(temp + temp_len, sz_temp - temp_len,  translate("gettextFromC", ", effective GF=%d/%d"), diveplan->eff_gflow,
 				diveplan->eff_gfhigh);
 
-	} else if (decoMode() == RECREATIONAL){
+	} else if (deco_mode == RECREATIONAL){
 		snprintf_loc(temp, sz_temp, translate("gettextFromC", "Deco model: Recreational mode based on Bühlmann ZHL-16B with GFLow = %d%% and GFHigh = %d%%"),
 			     diveplan->gflow, diveplan->gfhigh);
 	}
@@ -433,8 +440,8 @@ void add_plan_to_notes(struct diveplan *diveplan, struct dive *dive, bool show_d
 	int sacdecimals;
 	const char* sacunit;
 
-	bottomsacvalue = get_volume_units(prefs.bottomsac, &sacdecimals, &sacunit);
-	decosacvalue = get_volume_units(prefs.decosac, NULL, NULL);
+	bottomsacvalue = get_volume_units(diveplan->bottomsac, &sacdecimals, &sacunit);
+	decosacvalue = get_volume_units(diveplan->decosac, NULL, NULL);
 
 	/* Reduce number of decimals from 1 to 0 for bar/min, keep 2 for cuft/min */
 	if (sacdecimals==1) sacdecimals--;
@@ -483,10 +490,10 @@ void add_plan_to_notes(struct diveplan *diveplan, struct dive *dive, bool show_d
 			/* not for recreational mode and if no other warning was set before. */
 			else
 				if (lastbottomdp && gasidx == lastbottomdp->cylinderid
-					&& dive->dc.divemode == OC && decoMode() != RECREATIONAL) {
+					&& dive->dc.divemode == OC && deco_mode != RECREATIONAL) {
 					/* Calculate minimum gas volume. */
 					volume_t mingasv;
-					mingasv.mliter = lrint(prefs.sacfactor / 100.0 * prefs.problemsolvingtime * prefs.bottomsac
+					mingasv.mliter = lrint(prefs.sacfactor / 100.0 * prefs.problemsolvingtime * diveplan->bottomsac
 						* depth_to_bar(lastbottomdp->depth.mm, dive)
 						+ prefs.sacfactor / 100.0 * cyl->deco_gas_used.mliter);
 					/* Calculate minimum gas pressure for cyclinder. */
@@ -81,6 +81,8 @@ struct preferences {
 	bool calcceiling3m;
 	bool calcalltissues;
 	bool calcndltts;
+	bool calcndltts_iterative;
+	int profile_cache_size; // MB of calculated profiles to keep
 	short gflow;
 	short gfhigh;
 	int animation_speed;
@@ -28,7 +28,8 @@
 int selected_dive = -1; /* careful: 0 is a valid value */
 unsigned int dc_number = 0;
 
-static struct plot_data *last_pi_entry_new = NULL;
+/* the plot data of the last profile, freed when the next one is created */
+static struct plot_info last_pi_new;
 void populate_pressure_information(struct dive *, struct divecomputer *, struct plot_info *, int);
 
 #ifdef DEBUG_PI
@@ -163,13 +164,15 @@ void remember_event(const char *eventname)
 }
 
 /* UNUSED! */
-static int get_local_sac(struct plot_data *entry1, struct plot_data *entry2, struct dive *dive) __attribute__((unused));
+static int get_local_sac(struct plot_info *pi, int idx1, int idx2, struct dive *dive) __attribute__((unused));
 
 /* Get local sac-rate (in ml/min) between entry1 and entry2 */
-static int get_local_sac(struct plot_data *entry1, struct plot_data *entry2, struct dive *dive)
+static int get_local_sac(struct plot_info *pi, int idx1, int idx2, struct dive *dive)
 {
 	int index = 0;
 	cylinder_t *cyl;
+	struct plot_data *entry1 = pi->entry + idx1;
+	struct plot_data *entry2 = pi->entry + idx2;
 	int duration = entry2->sec - entry1->sec;
 	int depth, airuse;
 	pressure_t a, b;
@@ -177,8 +180,8 @@ static int get_local_sac(struct plot_data *entry1, struct plot_data *entry2, str
 
 	if (duration <= 0)
 		return 0;
-	a.mbar = GET_PRESSURE(entry1, 0);
-	b.mbar = GET_PRESSURE(entry2, 0);
+	a.mbar = get_plot_pressure(pi, idx1, 0);
+	b.mbar = get_plot_pressure(pi, idx2, 0);
 	if (!b.mbar || a.mbar <= b.mbar)
 		return 0;
 
@@ -196,46 +199,31 @@ static int get_local_sac(struct plot_data *entry1, struct plot_data *entry2, str
 
 #define HALF_INTERVAL 9 * 30
 /*
- * Run the min/max calculations: over a 9 minute interval
- * around the entry point (indices 0, 1, 2 respectively).
+ * The min/max calculations run over a 9 minute interval around each
+ * entry. The window slides along with the entry, so the candidates are
+ * kept in a queue of entry indices whose depths only increase (for the
+ * minimum) or decrease (for the maximum): the head is the extreme of
+ * the window, and every entry is added and dropped only once.
  */
-static void analyze_plot_info_minmax(struct plot_info *pi, int entry_index)
-{
-	struct plot_data *plot_entry = pi->entry + entry_index;  // fixed
-	struct plot_data *p = plot_entry;  // moves with 'entry'
-	int start = p->sec - HALF_INTERVAL, end = p->sec + HALF_INTERVAL;
-	int min, max;
-
-	/* Go back 'seconds' in time */
-	while (entry_index > 0) {
-		if (p[-1].sec < start)
-			break;
-		entry_index--;
-		p--;
-	}
-
-	// indexes to the min/max entries
-	min = max = entry_index;
-
-	/* Then go forward until we hit an entry past the time */
-	while (entry_index < pi->nr) {
-		int time = p->sec;
-		int depth = p->depth;
+struct minmax_queue {
+	int *index;
+	int head, tail;
+	int sign;	/* 1 for the minimum, -1 for the maximum */
+};
 
-		if (time > end)
-			break;
-
-		if (depth < pi->entry[min].depth)
-			min = entry_index;
-		if (depth > pi->entry[max].depth)
-			max = entry_index;
-
-		p++;
-		entry_index++;
-	}
+static void minmax_add(struct minmax_queue *q, const struct plot_data *entry, int idx)
+{
+	/* on equal depths the earlier entry stays in front */
+	while (q->tail > q->head && q->sign * (entry[q->index[q->tail - 1]].depth - entry[idx].depth) > 0)
+		q->tail--;
+	q->index[q->tail++] = idx;
+}
 
-	plot_entry->min = min;
-	plot_entry->max = max;
+static int minmax_get(struct minmax_queue *q, int first)
+{
+	while (q->index[q->head] < first)
+		q->head++;
+	return q->index[q->head];
 }
 
 static velocity_t velocity(int speed)
@@ -268,14 +256,34 @@ static velocity_t velocity(int speed)
 
 struct plot_info *analyze_plot_info(struct plot_info *pi)
 {
-	int i;
+	int i, first = 0, last = 0;
 	int nr = pi->nr;
+	struct minmax_queue min = { .sign = 1 }, max = { .sign = -1 };
 
-	/* Smoothing function: 5-point triangular smooth */
-	for (i = 2; i < nr; i++) {
+	min.index = malloc(2 * nr * sizeof(int));
+	if (!min.index)
+		return pi;
+	max.index = min.index + nr;
+
+	for (i = 0; i < nr; i++) {
 		struct plot_data *entry = pi->entry + i;
 		int depth;
 
+		/* get minmax data */
+		while (first < i && pi->entry[first].sec < entry->sec - HALF_INTERVAL)
+			first++;
+		while (last < nr && pi->entry[last].sec <= entry->sec + HALF_INTERVAL) {
+			minmax_add(&min, pi->entry, last);
+			minmax_add(&max, pi->entry, last);
+			last++;
+		}
+		entry->min = minmax_get(&min, first);
+		entry->max = minmax_get(&max, first);
+
+		if (i < 2)
+			continue;
+
+		/* Smoothing function: 5-point triangular smooth */
 		if (i < nr - 2) {
 			depth = entry[-2].depth + 2 * entry[-1].depth + 3 * entry[0].depth + 2 * entry[1].depth + entry[2].depth;
 			entry->smoothed = (depth + 4) / 9;
@@ -298,10 +306,7 @@ struct plot_info *analyze_plot_info(struct plot_info *pi)
 			entry->speed = 0;
 		}
 	}
-
-	/* get minmax data */
-	for (i = 0; i < nr; i++)
-		analyze_plot_info_minmax(pi, i);
+	free(min.index);
 
 	return pi;
 }
@@ -484,6 +489,22 @@ struct plot_info calculate_max_limits_new(struct dive *dive, struct divecomputer
 	return pi;
 }
 
+/* the cylinders that get pressure data: the ones of the dive and any that a sensor refers to */
+static int plot_cylinders(struct dive *dive, struct divecomputer *dc)
+{
+	int i, nr = nr_cylinders(dive);
+
+	for (i = 0; i < dc->samples; i++) {
+		struct sample *sample = dc->sample + i;
+
+		if (sample->pressure[0].mbar && sample->sensor[0] >= nr)
+			nr = sample->sensor[0] + 1;
+		if (sample->pressure[1].mbar && sample->sensor[1] >= nr)
+			nr = sample->sensor[1] + 1;
+	}
+	return MIN(nr, MAX_CYLINDERS);
+}
+
 /* copy the previous entry (we know this exists), update time and depth
  * and zero out the sensor pressure (since this is a synthetic entry)
  * increment the entry pointer and the count of synthetic entries. */
@@ -492,7 +513,6 @@ struct plot_info calculate_max_limits_new(struct dive *dive, struct divecomputer
 	entry->sec = _time;         \
 	entry->depth = _depth;      \
 	entry->running_sum = (entry - 1)->running_sum + (_time - (entry - 1)->sec) * (_depth + (entry - 1)->depth) / 2; \
-	memset(entry->pressure, 0, sizeof(entry->pressure)); \
 	entry->sac = _sac;          \
 	entry->ndl = -1;          \
 	entry->bearing = -1;          \
@@ -506,7 +526,6 @@ struct plot_data *populate_plot_entries(struct dive *dive, struct divecomputer *
 	int lastdepth, lasttime, lasttemp = 0;
 	struct plot_data *plot_data;
 	struct event *ev = dc->events;
-	(void) dive;
 	maxtime = pi->maxtime;
 
 	/*
@@ -524,6 +543,9 @@ struct plot_data *populate_plot_entries(struct dive *dive, struct divecomputer *
 	if (!plot_data)
 		return NULL;
 	pi->nr = nr;
+	pi->nr_cylinders = plot_cylinders(dive, dc);
+	pi->pressures = calloc(nr * pi->nr_cylinders, sizeof(struct plot_pressure_data));
+	pi->ceilings = pi->percentages = NULL;
 	idx = 2; /* the two extra events at the start */
 
 	lastdepth = 0;
@@ -588,9 +610,9 @@ struct plot_data *populate_plot_entries(struct dive *dive, struct divecomputer *
 			entry->pressures.o2 = sample->setpoint.mbar / 1000.0;
 		}
 		if (sample->pressure[0].mbar)
-			SENSOR_PRESSURE(entry, sample->sensor[0]) = sample->pressure[0].mbar;
+			set_plot_pressure_data(pi, idx, SENSOR_PR, sample->sensor[0], sample->pressure[0].mbar);
 		if (sample->pressure[1].mbar)
-			SENSOR_PRESSURE(entry, sample->sensor[1]) = sample->pressure[1].mbar;
+			set_plot_pressure_data(pi, idx, SENSOR_PR, sample->sensor[1], sample->pressure[1].mbar);
 		if (sample->temperature.mkelvin)
 			entry->temperature = lasttemp = sample->temperature.mkelvin;
 		else
@@ -638,10 +660,12 @@ struct plot_data *populate_plot_entries(struct dive *dive, struct divecomputer *
  *
  * Everything in between has a cylinder pressure for at least some of the cylinders.
  */
-static int sac_between(struct dive *dive, struct plot_data *first, struct plot_data *last, unsigned int gases)
+static int sac_between(struct dive *dive, struct plot_info *pi, int first_idx, int last_idx, unsigned int gases)
 {
 	int i, airuse;
 	double pressuretime;
+	struct plot_data *first = pi->entry + first_idx;
+	struct plot_data *last = pi->entry + last_idx;
 
 	if (first == last)
 		return 0;
@@ -656,8 +680,8 @@ static int sac_between(struct dive *dive, struct plot_data *first, struct plot_d
 		if (!(gases & (1u << i)))
 			continue;
 
-		a.mbar = GET_PRESSURE(first, i);
-		b.mbar = GET_PRESSURE(last, i);
+		a.mbar = get_plot_pressure(pi, first_idx, i);
+		b.mbar = get_plot_pressure(pi, last_idx, i);
 		cyl = dive->cylinder + i;
 		cyluse = gas_volume(cyl, a) - gas_volume(cyl, b);
 		if (cyluse > 0)
@@ -684,14 +708,14 @@ static int sac_between(struct dive *dive, struct plot_data *first, struct plot_d
 }
 
 /* Which of the set of gases have pressure data */
-static unsigned int have_pressures(struct plot_data *entry, unsigned int gases)
+static unsigned int have_pressures(struct plot_info *pi, int idx, unsigned int gases)
 {
 	int i;
 
 	for (i = 0; i < MAX_CYLINDERS; i++) {
 		unsigned int mask = 1 << i;
 		if (gases & mask) {
-			if (!GET_PRESSURE(entry, i))
+			if (!get_plot_pressure(pi, idx, i))
 				gases &= ~mask;
 		}
 	}
@@ -715,7 +739,7 @@ static void fill_sac(struct dive *dive, struct plot_info *pi, int idx, unsigned
 	 * We may not have pressure data for all the cylinders,
 	 * but we'll calculate the SAC for the ones we do have.
 	 */
-	gases = have_pressures(entry, gases);
+	gases = have_pressures(pi, idx, gases);
 	if (!gases)
 		return;
 
@@ -732,7 +756,7 @@ static void fill_sac(struct dive *dive, struct plot_info *pi, int idx, unsigned
 			break;
 		if (prev->sec < time)
 			break;
-		if (have_pressures(prev, gases) != gases)
+		if (have_pressures(pi, prev - pi->entry, gases) != gases)
 			break;
 		idx--;
 		first = prev;
@@ -747,13 +771,13 @@ static void fill_sac(struct dive *dive, struct plot_info *pi, int idx, unsigned
 			break;
 		if (next->sec > time)
 			break;
-		if (have_pressures(next, gases) != gases)
+		if (have_pressures(pi, next - pi->entry, gases) != gases)
 			break;
 		last = next;
 	}
 
 	/* Ok, now calculate the SAC between 'first' and 'last' */
-	entry->sac = sac_between(dive, first, last, gases);
+	entry->sac = sac_between(dive, pi, first - pi->entry, last - pi->entry, gases);
 }
 
 /*
@@ -803,18 +827,16 @@ static void populate_secondary_sensor_data(struct divecomputer *dc, struct plot_
  */
 static void add_plot_pressure(struct plot_info *pi, int time, int cyl, pressure_t p)
 {
-	struct plot_data *entry;
+	int i;
 	if (pi->nr <= 0) {
 		fprintf(stderr, "add_plot_pressure(): called with pi->nr <= 0\n");
 		return;
 	}
-	for (int i = 0; i < pi->nr; i++) {
-		entry = pi->entry + i;
-
-		if (entry->sec >= time)
+	for (i = 0; i < pi->nr - 1; i++) {
+		if (pi->entry[i].sec >= time)
 			break;
 	}
-	SENSOR_PRESSURE(entry, cyl) = p.mbar;
+	set_plot_pressure_data(pi, i, SENSOR_PR, cyl, p.mbar);
 }
 
 static void setup_gas_sensor_pressure(struct dive *dive, struct divecomputer *dc, struct plot_info *pi)
@@ -905,8 +927,53 @@ static void setup_gas_sensor_pressure(struct dive *dive, struct divecomputer *dc
 }
 
 #ifndef SUBSURFACE_MOBILE
-/* calculate DECO STOP / TTS / NDL */
-static void calculate_ndl_tts(struct deco_state *ds, struct dive *dive, struct plot_data *entry, struct gasmix *gasmix, double surface_pressure)
+/* The ascents between two deco stops, which are the same for every point of the profile */
+#define ASCENT_CACHE_SIZE 16
+struct ascent_cache {
+	int next;
+	struct ascent_segments {
+		int from, to;
+		int o2pressure;
+		struct gasmix gasmix;
+		int duration;
+		struct deco_sequence seq;
+	} entry[ASCENT_CACHE_SIZE];
+};
+
+/* add the ascent from one deco stop to the next and return its duration */
+static int add_cached_ascent(struct deco_state *ds, struct ascent_cache *cache, struct dive *dive, int from, int to,
+			     int mm_per_step, int s_per_step, struct gasmix *gasmix, int o2pressure)
+{
+	struct ascent_segments *segments;
+	int i, depth;
+
+	for (i = 0; i < ASCENT_CACHE_SIZE; i++) {
+		segments = cache->entry + i;
+		if (segments->duration && segments->from == from && segments->to == to &&
+		    segments->o2pressure == o2pressure && same_gasmix(&segments->gasmix, gasmix)) {
+			add_deco_sequence(ds, &segments->seq);
+			return segments->duration;
+		}
+	}
+
+	segments = cache->entry + cache->next;
+	cache->next = (cache->next + 1) % ASCENT_CACHE_SIZE;
+	segments->from = from;
+	segments->to = to;
+	segments->o2pressure = o2pressure;
+	segments->gasmix = *gasmix;
+	segments->duration = 0;
+	clear_deco_sequence(&segments->seq);
+	for (depth = from; depth > to; depth -= mm_per_step, segments->duration += s_per_step)
+		add_segment_to_sequence(ds, &segments->seq, depth_to_bar(depth, dive), gasmix, s_per_step, o2pressure, dive);
+	add_deco_sequence(ds, &segments->seq);
+	return segments->duration;
+}
+
+/* calculate DECO STOP / TTS / NDL
+ * With an ascent cache, the NDL is solved for and the ascents between the
+ * deco stops are taken from the cache. Without, both are simulated step by step. */
+static void calculate_ndl_tts(struct deco_state *ds, struct dive *dive, struct plot_data *entry, struct gasmix *gasmix, double surface_pressure, struct ascent_cache *ascent_cache)
 {
 	/* FIXME: This should be configurable */
 	/* ascent speed up to first deco stop */
@@ -934,6 +1001,16 @@ static void calculate_ndl_tts(struct deco_state *ds, struct dive *dive, struct p
 			entry->ndl = MAX_PROFILE_DECO;
 			return;
 		}
+		if (ascent_cache) {
+			double ndl = ndl_time(ds, depth_to_bar(entry->depth, dive), gasmix, entry->o2pressure.mbar,
+					      dive, surface_pressure, time_stepsize, MAX_PROFILE_DECO);
+			int steps = MAX(1, (int)ceil(ndl / time_stepsize));
+
+			/* the same whole steps as below */
+			while (entry->ndl_calc < MAX_PROFILE_DECO && steps--)
+				entry->ndl_calc += time_stepsize;
+			return;
+		}
 		/* stop if the ndl is above max_ndl seconds, and call it plenty of time */
 		while (entry->ndl_calc < MAX_PROFILE_DECO &&
 		       deco_allowed_depth(tissue_tolerance_calc(ds, dive, depth_to_bar(entry->depth, dive)),
@@ -978,51 +1055,300 @@ static void calculate_ndl_tts(struct deco_state *ds, struct dive *dive, struct p
 
 		if (deco_allowed_depth(tissue_tolerance_calc(ds, dive, depth_to_bar(ascent_depth,dive)), surface_pressure, dive, 1) <= next_stop) {
 			/* move to the next stop and add the travel between stops */
-			for (; ascent_depth > next_stop; ascent_depth -= ascent_mm_per_deco_step, entry->tts_calc += ascent_s_per_deco_step)
-				add_segment(ds, depth_to_bar(ascent_depth, dive),
-					    gasmix, ascent_s_per_deco_step, entry->o2pressure.mbar, dive, prefs.decosac);
+			if (ascent_cache)
+				entry->tts_calc += add_cached_ascent(ds, ascent_cache, dive, ascent_depth, next_stop, ascent_mm_per_deco_step,
+								     ascent_s_per_deco_step, gasmix, entry->o2pressure.mbar);
+			else
+				for (; ascent_depth > next_stop; ascent_depth -= ascent_mm_per_deco_step, entry->tts_calc += ascent_s_per_deco_step)
+					add_segment(ds, depth_to_bar(ascent_depth, dive),
+						    gasmix, ascent_s_per_deco_step, entry->o2pressure.mbar, dive, prefs.decosac);
 			ascent_depth = next_stop;
 			next_stop -= deco_stepsize;
 		}
 	}
 }
 
+/*
+ * With Buehlmann, the deco results of a plot entry only depend on the
+ * entries before it. So we keep the deco state every few minutes of the
+ * last calculated profile and, if the next profile starts out the same,
+ * restart the calculation from the last of those checkpoints before the
+ * first entry that changed.
+ */
+#define DECO_CHECKPOINT_INTERVAL 300
+
+/* what goes into the deco calculation of a plot entry */
+struct deco_input {
+	int sec, depth, o2pressure, ndl;
+	struct gasmix gasmix;
+};
+
+/* everything else the deco calculation depends on */
+struct deco_key {
+	double surface_pressure;
+	int dive_surface_pressure, salinity;
+	enum dive_comp_type divemode;
+	enum deco_mode deco_mode;
+	bool planner, print_mode, calcndltts, calcndltts_iterative, calcceiling3m, tissue_ceilings;
+	short vpmb_conservatism;
+	double gf_low, gf_high;
+	double gf_low_pressure_this_dive;
+	double tissue_n2_sat[16];
+	double tissue_he_sat[16];
+};
+
+struct deco_checkpoint {
+	int idx;	/* the state after this entry */
+	int last_ndl_tts_calc_time;
+	struct deco_state ds;
+};
+
+static struct {
+	struct deco_key key;
+	int nr;
+	struct deco_input *input;
+	struct plot_data *result;
+	int *ceilings, *percentages;
+	int nr_checkpoints, allocated;
+	struct deco_checkpoint *checkpoint;
+	int resumed;	/* entries the last calculation took over from the one before */
+} last_deco;
+
+/* How many plot entries of the last profile calculated with the cache came from
+ * the one before it, see resume_deco_calculation() */
+int deco_resumed_entries(void)
+{
+	return last_deco.resumed;
+}
+
+static struct deco_input *get_deco_input(struct dive *dive, struct divecomputer *dc, struct plot_info *pi)
+{
+	int i;
+	struct gasmix *gasmix = NULL;
+	struct event *ev = NULL;
+	struct deco_input *input = malloc(pi->nr * sizeof(*input));
+
+	for (i = 0; i < pi->nr; i++) {
+		struct plot_data *entry = pi->entry + i;
+
+		gasmix = get_gasmix(dive, dc, entry->sec, &ev, gasmix);
+		input[i].sec = entry->sec;
+		input[i].depth = entry->depth;
+		input[i].o2pressure = entry->o2pressure.mbar;
+		input[i].ndl = entry->ndl;
+		input[i].gasmix = *gasmix;
+	}
+	return input;
+}
+
+static bool same_deco_input(const struct deco_input *a, const struct deco_input *b)
+{
+	return a->sec == b->sec && a->depth == b->depth && a->o2pressure == b->o2pressure &&
+	       a->ndl == b->ndl && a->gasmix.o2.permille == b->gasmix.o2.permille &&
+	       a->gasmix.he.permille == b->gasmix.he.permille;
+}
+
+static void get_deco_key(struct deco_key *key, const struct deco_state *ds, const struct profile_deco_settings *settings, struct dive *dive,
+			 const struct plot_info *pi, double surface_pressure, bool print_mode)
+{
+	/* compared with memcmp(), so clear the padding */
+	memset(key, 0, sizeof(*key));
+	key->surface_pressure = surface_pressure;
+	key->dive_surface_pressure = dive->surface_pressure.mbar;
+	key->salinity = dive->salinity;
+	key->divemode = dive->dc.divemode;
+	key->deco_mode = ds->params.deco_mode;
+	key->planner = ds->params.planner;
+	key->print_mode = print_mode;
+	key->calcndltts = settings->calcndltts;
+	key->calcndltts_iterative = settings->calcndltts_iterative;
+	key->calcceiling3m = settings->calcceiling3m;
+	key->tissue_ceilings = pi->ceilings != NULL;
+	/* field by field, the padding of the parameters isn't cleared */
+	key->vpmb_conservatism = ds->params.vpmb_conservatism;
+	key->gf_low = ds->params.gf_low;
+	key->gf_high = ds->params.gf_high;
+	key->gf_low_pressure_this_dive = ds->gf_low_pressure_this_dive;
+	memcpy(key->tissue_n2_sat, ds->tissue_n2_sat, sizeof(key->tissue_n2_sat));
+	memcpy(key->tissue_he_sat, ds->tissue_he_sat, sizeof(key->tissue_he_sat));
+}
+
+static void copy_deco_results(struct plot_info *pi, int idx)
+{
+	struct plot_data *dst = pi->entry + idx;
+	const struct plot_data *src = last_deco.result + idx;
+
+	dst->ceiling = src->ceiling;
+	if (pi->ceilings)
+		memcpy(pi->ceilings + idx * 16, last_deco.ceilings + idx * 16, 16 * sizeof(int));
+	memcpy(pi->percentages + idx * 16, last_deco.percentages + idx * 16, 16 * sizeof(int));
+	dst->ndl = src->ndl;
+	dst->in_deco_calc = src->in_deco_calc;
+	dst->ndl_calc = src->ndl_calc;
+	dst->tts_calc = src->tts_calc;
+	dst->stoptime_calc = src->stoptime_calc;
+	dst->stopdepth_calc = src->stopdepth_calc;
+	dst->ambpressure = src->ambpressure;
+	dst->gfline = src->gfline;
+}
+
+/* Set up the deco state to continue the calculation of the last profile
+ * where this one starts to differ. Returns the first entry to calculate. */
+static int resume_deco_calculation(struct deco_state *ds, const struct profile_deco_settings *settings, struct dive *dive, struct plot_info *pi,
+				   const struct deco_input *input, double surface_pressure, bool print_mode, int *last_ndl_tts_calc_time)
+{
+	int i, c, first;
+	struct deco_key key;
+
+	get_deco_key(&key, ds, settings, dive, pi, surface_pressure, print_mode);
+	if (!last_deco.nr || memcmp(&key, &last_deco.key, sizeof(key))) {
+		last_deco.key = key;
+		last_deco.nr_checkpoints = 0;
+		return 1;
+	}
+
+	/* The last entry gets its NDL and TTS calculated in any case */
+	first = MIN(pi->nr, last_deco.nr) - 1;
+	for (i = 0; i < first; i++) {
+		if (!same_deco_input(input + i, last_deco.input + i))
+			break;
+	}
+	first = i;
+
+	for (c = last_deco.nr_checkpoints; c > 0; c--) {
+		if (last_deco.checkpoint[c - 1].idx < first)
+			break;
+	}
+	last_deco.nr_checkpoints = c;
+	if (!c)
+		return 1;
+
+	struct deco_checkpoint *checkpoint = last_deco.checkpoint + c - 1;
+	for (i = 1; i <= checkpoint->idx; i++)
+		copy_deco_results(pi, i);
+	*ds = checkpoint->ds;
+	*last_ndl_tts_calc_time = checkpoint->last_ndl_tts_calc_time;
+	return checkpoint->idx + 1;
+}
+
+static void add_deco_checkpoint(const struct deco_state *ds, int idx, int last_ndl_tts_calc_time)
+{
+	struct deco_checkpoint *checkpoint;
+
+	if (last_deco.nr_checkpoints == last_deco.allocated) {
+		last_deco.allocated = last_deco.allocated * 3 / 2 + 16;
+		last_deco.checkpoint = realloc(last_deco.checkpoint, last_deco.allocated * sizeof(*last_deco.checkpoint));
+	}
+	checkpoint = last_deco.checkpoint + last_deco.nr_checkpoints++;
+	checkpoint->idx = idx;
+	checkpoint->last_ndl_tts_calc_time = last_ndl_tts_calc_time;
+	checkpoint->ds = *ds;
+}
+
+/* keep the inputs and results of this profile for the next one */
+static void save_deco_results(struct plot_info *pi, struct deco_input *input)
+{
+	free(last_deco.input);
+	last_deco.input = input;
+	last_deco.result = realloc(last_deco.result, pi->nr * sizeof(*last_deco.result));
+	memcpy(last_deco.result, pi->entry, pi->nr * sizeof(*last_deco.result));
+	if (pi->ceilings) {
+		last_deco.ceilings = realloc(last_deco.ceilings, pi->nr * 16 * sizeof(int));
+		memcpy(last_deco.ceilings, pi->ceilings, pi->nr * 16 * sizeof(int));
+	}
+	last_deco.percentages = realloc(last_deco.percentages, pi->nr * 16 * sizeof(int));
+	memcpy(last_deco.percentages, pi->percentages, pi->nr * 16 * sizeof(int));
+	last_deco.nr = pi->nr;
+}
+
+/* The deco parameters of the profile: the planner's while planning,
+ * the ones from the preferences otherwise. Set before init_decompression().
+ */
+void init_profile_deco_parameters(struct deco_state *ds, const struct deco_state *planner_ds)
+{
+	init_deco_parameters(ds);
+	/* the planner's state might be from before the planner was opened, so only take its parameters */
+	if (ds->params.planner && planner_ds) {
+		ds->params.gf_low = planner_ds->params.gf_low;
+		ds->params.gf_high = planner_ds->params.gf_high;
+		ds->params.vpmb_conservatism = planner_ds->params.vpmb_conservatism;
+	}
+}
+
+/* The preferences of the deco calculation and, if the parameters of ds are
+ * those of the planner, where the plan's deco state is */
+void init_profile_deco_settings(struct profile_deco_settings *settings, const struct deco_state *ds, const struct deco_state *planner_ds)
+{
+	memset(settings, 0, sizeof(*settings));
+	settings->calcalltissues = prefs.calcalltissues;
+	settings->calcceiling3m = prefs.calcceiling3m;
+	settings->calcndltts = prefs.calcndltts;
+	settings->calcndltts_iterative = prefs.calcndltts_iterative;
+	if (ds && ds->params.planner && planner_ds) {
+		settings->planner_deco_time = planner_ds->deco_time;
+		settings->planner_first_ceiling_pressure = planner_ds->first_ceiling_pressure;
+	}
+}
+
 /* Let's try to do some deco calculations.
+ * Everything but the dive comes from ds and settings, so this may run on any thread.
  */
-void calculate_deco_information(struct deco_state *ds, struct deco_state *planner_ds, struct dive *dive, struct divecomputer *dc, struct plot_info *pi, bool print_mode)
+void calculate_deco_information(struct deco_state *ds, const struct profile_deco_settings *settings, struct dive *dive, struct divecomputer *dc, struct plot_info *pi, bool print_mode)
 {
 	int i, count_iteration = 0;
 	double surface_pressure = (dc->surface_pressure.mbar ? dc->surface_pressure.mbar : get_surface_pressure_in_mbar(dive, true)) / 1000.0;
 	bool first_iteration = true;
 	int prev_deco_time = 10000000, time_deep_ceiling = 0;
-	if (!in_planner()) {
+	bool planner = ds->params.planner;
+	enum deco_mode deco_mode = ds->params.deco_mode;
+	if (!planner) {
 		ds->deco_time = 0;
 	} else {
-		ds->deco_time = planner_ds->deco_time;
-		ds->first_ceiling_pressure = planner_ds->first_ceiling_pressure;
+		ds->deco_time = settings->planner_deco_time;
+		ds->first_ceiling_pressure = settings->planner_first_ceiling_pressure;
 	}
 	struct deco_state *cache_data_initial = NULL;
-	lock_planner();
+	struct deco_input *input = get_deco_input(dive, dc, pi);
+	/* the ceilings of all tissues are only shown with calcalltissues */
+	if (settings->calcalltissues && !pi->ceilings)
+		pi->ceilings = calloc(pi->nr * 16, sizeof(int));
+	if (!pi->percentages)
+		pi->percentages = calloc(pi->nr * 16, sizeof(int));
+	int start = 1, start_ndl_tts_calc_time = 0, next_checkpoint = DECO_CHECKPOINT_INTERVAL;
+	/* Buehlmann doesn't iterate, so it can pick up the last profile where this one differs.
+	 * If the profile is being calculated on another thread, go without the cache */
+	bool use_cache = deco_mode != VPMB && trylock_deco_cache();
+	if (use_cache) {
+		start = resume_deco_calculation(ds, settings, dive, pi, input, surface_pressure, print_mode, &start_ndl_tts_calc_time);
+		last_deco.resumed = start - 1;
+		if (last_deco.nr_checkpoints)
+			next_checkpoint = pi->entry[start - 1].sec + DECO_CHECKPOINT_INTERVAL;
+	}
+	/* The shortcuts for NDL and TTS only work with Buehlmann */
+	struct ascent_cache *ascent_cache = NULL;
+	if (!settings->calcndltts_iterative && deco_mode != VPMB)
+		ascent_cache = calloc(1, sizeof(*ascent_cache));
 	/* For VPM-B outside the planner, cache the initial deco state for CVA iterations */
-	if (decoMode() == VPMB) {
+	if (deco_mode == VPMB) {
 		cache_deco_state(ds, &cache_data_initial);
 	}
 	/* For VPM-B outside the planner, iterate until deco time converges (usually one or two iterations after the initial)
 	 * Set maximum number of iterations to 10 just in case */
 	while ((abs(prev_deco_time - ds->deco_time) >= 30) && (count_iteration < 10)) {
-		int last_ndl_tts_calc_time = 0, first_ceiling = 0, current_ceiling, last_ceiling = 0, final_tts = 0 , time_clear_ceiling = 0;
-		if (decoMode() == VPMB)
+		int last_ndl_tts_calc_time = start_ndl_tts_calc_time, first_ceiling = 0, current_ceiling, last_ceiling = 0, final_tts = 0 , time_clear_ceiling = 0;
+		if (deco_mode == VPMB)
 			ds->first_ceiling_pressure.mbar = depth_to_mbar(first_ceiling, dive);
-		struct gasmix *gasmix = NULL;
-		struct event *ev = NULL;
 
-		for (i = 1; i < pi->nr; i++) {
+		for (i = start; i < pi->nr; i++) {
 			struct plot_data *entry = pi->entry + i;
 			int j, t0 = (entry - 1)->sec, t1 = entry->sec;
 			int time_stepsize = 20;
+			struct gasmix *gasmix = &input[i].gasmix;
 
-			gasmix = get_gasmix(dive, dc, t1, &ev, gasmix);
-
+			if (use_cache && t0 >= next_checkpoint) {
+				add_deco_checkpoint(ds, i - 1, last_ndl_tts_calc_time);
+				next_checkpoint = t0 + DECO_CHECKPOINT_INTERVAL;
+			}
 			entry->ambpressure = depth_to_bar(entry->depth, dive);
 			entry->gfline = get_gf(ds, entry->ambpressure, dive) * (100.0 - AMB_PERCENTAGE) + AMB_PERCENTAGE;
 			if (t0 > t1) {
@@ -1044,21 +1370,21 @@ void calculate_deco_information(struct deco_state *ds, struct deco_state *planne
 				entry->ceiling = (entry - 1)->ceiling;
 			} else {
 				/* Keep updating the VPM-B gradients until the start of the ascent phase of the dive. */
-				if (decoMode() == VPMB && last_ceiling >= first_ceiling && first_iteration == true) {
+				if (deco_mode == VPMB && last_ceiling >= first_ceiling && first_iteration == true) {
 					nuclear_regeneration(ds, t1);
 					vpmb_start_gradient(ds);
 					/* For CVA iterations, calculate next gradient */
-					if (!first_iteration || in_planner())
+					if (!first_iteration || planner)
 						vpmb_next_gradient(ds, ds->deco_time, surface_pressure / 1000.0);
 				}
-				entry->ceiling = deco_allowed_depth(tissue_tolerance_calc(ds, dive, depth_to_bar(entry->depth, dive)), surface_pressure, dive, !prefs.calcceiling3m);
-				if (prefs.calcceiling3m)
+				entry->ceiling = deco_allowed_depth(tissue_tolerance_calc(ds, dive, depth_to_bar(entry->depth, dive)), surface_pressure, dive, !settings->calcceiling3m);
+				if (settings->calcceiling3m)
 					current_ceiling = deco_allowed_depth(tissue_tolerance_calc(ds, dive, depth_to_bar(entry->depth, dive)), surface_pressure, dive, true);
 				else
 					current_ceiling = entry->ceiling;
 				last_ceiling = current_ceiling;
 				/* If using VPM-B, take first_ceiling_pressure as the deepest ceiling */
-				if (decoMode() == VPMB) {
+				if (deco_mode == VPMB) {
 					if  (current_ceiling >= first_ceiling ||
 					     (time_deep_ceiling == t0 && entry->depth == (entry - 1)->depth)) {
 						time_deep_ceiling = t1;
@@ -1070,7 +1396,7 @@ void calculate_deco_information(struct deco_state *ds, struct deco_state *planne
 							/* For CVA calculations, deco time = dive time remaining is a good guess,
 							   but we want to over-estimate deco_time for the first iteration so it
 							   converges correctly, so add 30min*/
-							if (!in_planner())
+							if (!planner)
 								ds->deco_time = pi->maxtime - t1 + 1800;
 							vpmb_next_gradient(ds, ds->deco_time, surface_pressure / 1000.0);
 						}
@@ -1084,8 +1410,9 @@ void calculate_deco_information(struct deco_state *ds, struct deco_state *planne
 			}
 			for (j = 0; j < 16; j++) {
 				double m_value = ds->buehlmann_inertgas_a[j] + entry->ambpressure / ds->buehlmann_inertgas_b[j];
-				entry->ceilings[j] = deco_allowed_depth(ds->tolerated_by_tissue[j], surface_pressure, dive, 1);
-				entry->percentages[j] = ds->tissue_inertgas_saturation[j] < entry->ambpressure ?
+				if (pi->ceilings)
+					pi->ceilings[i * 16 + j] = deco_allowed_depth(ds->tolerated_by_tissue[j], surface_pressure, dive, 1);
+				pi->percentages[i * 16 + j] = ds->tissue_inertgas_saturation[j] < entry->ambpressure ?
 					lrint(ds->tissue_inertgas_saturation[j] / entry->ambpressure * AMB_PERCENTAGE) :
 					lrint(AMB_PERCENTAGE + (ds->tissue_inertgas_saturation[j] - entry->ambpressure) / (m_value - entry->ambpressure) * (100.0 - AMB_PERCENTAGE));
 			}
@@ -1094,8 +1421,8 @@ void calculate_deco_information(struct deco_state *ds, struct deco_state *planne
 			* We don't for print-mode because this info doesn't show up there
 			* If the ceiling hasn't cleared by the last data point, we need tts for VPM-B CVA calculation
 			* It is not necessary to do these calculation on the first VPMB iteration, except for the last data point */
-			if ((prefs.calcndltts && !print_mode && (decoMode() != VPMB || in_planner() || !first_iteration)) ||
-			    (decoMode() == VPMB && !in_planner() && i == pi->nr - 1)) {
+			if ((settings->calcndltts && !print_mode && (deco_mode != VPMB || planner || !first_iteration)) ||
+			    (deco_mode == VPMB && !planner && i == pi->nr - 1)) {
 				/* only calculate ndl/tts on every 30 seconds */
 				if ((entry->sec - last_ndl_tts_calc_time) < 30 && i != pi->nr - 1) {
 					struct plot_data *prev_entry = (entry - 1);
@@ -1110,15 +1437,15 @@ void calculate_deco_information(struct deco_state *ds, struct deco_state *planne
 				/* We are going to mess up deco state, so store it for later restore */
 				struct deco_state *cache_data = NULL;
 				cache_deco_state(ds, &cache_data);
-				calculate_ndl_tts(ds, dive, entry, gasmix, surface_pressure);
-				if (decoMode() == VPMB && !in_planner() && i == pi->nr - 1)
+				calculate_ndl_tts(ds, dive, entry, gasmix, surface_pressure, ascent_cache);
+				if (deco_mode == VPMB && !planner && i == pi->nr - 1)
 					final_tts = entry->tts_calc;
 				/* Restore "real" deco state for next real time step */
-				restore_deco_state(cache_data, ds, decoMode() == VPMB);
+				restore_deco_state(cache_data, ds, deco_mode == VPMB);
 				free(cache_data);
 			}
 		}
-		if (decoMode() == VPMB && !in_planner()) {
+		if (deco_mode == VPMB && !planner) {
 			int this_deco_time;
 			prev_deco_time = ds->deco_time;
 			// Do we need to update deco_time?
@@ -1145,10 +1472,16 @@ void calculate_deco_information(struct deco_state *ds, struct deco_state *planne
 		}
 	}
 	free(cache_data_initial);
+	free(ascent_cache);
+	if (use_cache) {
+		save_deco_results(pi, input);
+		unlock_deco_cache();
+	} else {
+		free(input);
+	}
 #if DECO_CALC_DEBUG & 1
 	dump_tissues(ds);
 #endif
-	unlock_planner();
 }
 #endif
 
@@ -1300,24 +1633,55 @@ static void debug_print_profiledata(struct plot_info *pi)
 }
 #endif
 
+static void *copy_array(const void *src, size_t size)
+{
+	void *dst;
+
+	if (!src || !size)
+		return NULL;
+	dst = malloc(size);
+	if (dst)
+		memcpy(dst, src, size);
+	return dst;
+}
+
+/* deep copy, so that the copy survives the next create_plot_info_new() */
+void copy_plot_info_data(struct plot_info *dst, const struct plot_info *src)
+{
+	*dst = *src;
+	dst->entry = copy_array(src->entry, src->nr * sizeof(struct plot_data));
+	dst->pressures = copy_array(src->pressures, src->nr * src->nr_cylinders * sizeof(struct plot_pressure_data));
+	dst->ceilings = copy_array(src->ceilings, src->nr * 16 * sizeof(int));
+	dst->percentages = copy_array(src->percentages, src->nr * 16 * sizeof(int));
+}
+
+void free_plot_info_data(struct plot_info *pi)
+{
+	free(pi->entry);
+	free(pi->pressures);
+	free(pi->ceilings);
+	free(pi->percentages);
+	pi->entry = NULL;
+	pi->pressures = NULL;
+	pi->ceilings = pi->percentages = NULL;
+}
+
 /*
  * Create a plot-info with smoothing and ranged min/max
  *
  * This also makes sure that we have extra empty events on both
  * sides, so that you can do end-points without having to worry
  * about it.
+ *
+ * Unlike create_plot_info_new(), the caller owns the plot data and frees
+ * it with free_plot_info_data(), so this can run on a copy of the dive
+ * outside the GUI thread. The deco information is only calculated with
+ * a deco state that init_decompression() has set up and the settings of
+ * init_profile_deco_settings(), a NULL ds leaves it out.
  */
-void create_plot_info_new(struct dive *dive, struct divecomputer *dc, struct plot_info *pi, bool fast, struct deco_state *planner_ds)
+void calculate_plot_info(struct dive *dive, struct divecomputer *dc, struct plot_info *pi, bool fast, struct deco_state *ds, const struct profile_deco_settings *settings)
 {
 	int o2, he, o2max;
-#ifndef SUBSURFACE_MOBILE
-	struct deco_state plot_deco_state;
-	init_decompression(&plot_deco_state, dive);
-#else
-	(void)planner_ds;
-#endif
-	/* Create the new plot data */
-	free((void *)last_pi_entry_new);
 
 	get_dive_gas(dive, &o2, &he, &o2max);
 	if (dc->divemode == FREEDIVE){
@@ -1331,7 +1695,7 @@ void create_plot_info_new(struct dive *dive, struct divecomputer *dc, struct plo
 			pi->dive_type = AIR;
 	}
 
-	last_pi_entry_new = populate_plot_entries(dive, dc, pi);
+	populate_plot_entries(dive, dc, pi);
 
 	check_setpoint_events(dive, dc, pi);     /* Populate setpoints */
 	setup_gas_sensor_pressure(dive, dc, pi); /* Try to populate our gas pressure knowledge */
@@ -1342,7 +1706,11 @@ void create_plot_info_new(struct dive *dive, struct divecomputer *dc, struct plo
 	fill_o2_values(dive, dc, pi);			 /* .. and insert the O2 sensor data having 0 values. */
 	calculate_sac(dive, dc, pi);			 /* Calculate sac */
 #ifndef SUBSURFACE_MOBILE
-	calculate_deco_information(&plot_deco_state, planner_ds, dive, dc, pi, false); /* and ceiling information, using gradient factor values in Preferences) */
+	if (ds)
+		calculate_deco_information(ds, settings, dive, dc, pi, false); /* and ceiling information, using gradient factor values in Preferences) */
+#else
+	(void)ds;
+	(void)settings;
 #endif
 	calculate_gas_information_new(dive, dc, pi);	 /* Calculate gas partial pressures */
 
@@ -1354,6 +1722,24 @@ void create_plot_info_new(struct dive *dive, struct divecomputer *dc, struct plo
 	analyze_plot_info(pi);
 }
 
+/* The plot data stays valid until the next call */
+void create_plot_info_new(struct dive *dive, struct divecomputer *dc, struct plot_info *pi, bool fast, struct deco_state *planner_ds)
+{
+	struct deco_state *ds = NULL;
+	struct profile_deco_settings settings;
+#ifndef SUBSURFACE_MOBILE
+	struct deco_state plot_deco_state;
+	init_profile_deco_parameters(&plot_deco_state, planner_ds);
+	init_decompression(&plot_deco_state, dive);
+	ds = &plot_deco_state;
+#endif
+	init_profile_deco_settings(&settings, ds, planner_ds);
+	/* Create the new plot data */
+	free_plot_info_data(&last_pi_new);
+	calculate_plot_info(dive, dc, pi, fast, ds, &settings);
+	last_pi_new = *pi;
+}
+
 struct divecomputer *select_dc(struct dive *dive)
 {
 	unsigned int max = number_of_computers(dive);
@@ -1368,6 +1754,7 @@ struct divecomputer *select_dc(struct dive *dive)
 
 static void plot_string(struct plot_info *pi, struct plot_data *entry, struct membuffer *b)
 {
+	int idx = entry - pi->entry;
 	int pressurevalue, mod, ead, end, eadd;
 	const char *depth_unit, *pressure_unit, *temp_unit, *vertical_speed_unit;
 	double depthvalue, tempvalue, speedvalue, sacvalue;
@@ -1378,7 +1765,7 @@ static void plot_string(struct plot_info *pi, struct plot_data *entry, struct me
 	put_format_loc(b, translate("gettextFromC", "@: %d:%02d\nD: %.1f%s\n"), FRACTION(entry->sec, 60), depthvalue, depth_unit);
 	for (cyl = 0; cyl < MAX_CYLINDERS; cyl++) {
 		struct gasmix *mix;
-		int mbar = GET_PRESSURE(entry, cyl);
+		int mbar = get_plot_pressure(pi, idx, cyl);
 		if (!mbar)
 			continue;
 		mix = &displayed_dive.cylinder[cyl].gasmix;
@@ -1491,8 +1878,9 @@ static void plot_string(struct plot_info *pi, struct plot_data *entry, struct me
 		if (prefs.calcalltissues) {
 			int k;
 			for (k = 0; k < 16; k++) {
-				if (entry->ceilings[k]) {
-					depthvalue = get_depth_units(entry->ceilings[k], NULL, &depth_unit);
+				int ceiling = get_plot_ceiling(pi, idx, k);
+				if (ceiling) {
+					depthvalue = get_depth_units(ceiling, NULL, &depth_unit);
 					put_format_loc(b, translate("gettextFromC", "Tissue %.0fmin: %.1f%s\n"), buehlmann_N2_t_halflife[k], depthvalue, depth_unit);
 				}
 			}
@@ -1510,26 +1898,49 @@ static void plot_string(struct plot_info *pi, struct plot_data *entry, struct me
 	strip_mb(b);
 }
 
-struct plot_data *get_plot_details_new(struct plot_info *pi, int time, struct membuffer *mb)
+/*
+ * The first entry at or after the given time, or the last one with
+ * useful data if there is none. The entries are sorted by time, so
+ * this is a binary search. Returns -1 if there are no useful entries.
+ */
+int get_plot_entry_index(const struct plot_info *pi, int time)
 {
-	struct plot_data *entry = NULL;
-	int i;
-
 	/* The two first and the two last plot entries do not have useful data */
-	for (i = 2; i < pi->nr - 2; i++) {
-		entry = pi->entry + i;
-		if (entry->sec >= time)
-			break;
+	int low = 2, high = pi->nr - 3;
+
+	if (high < low)
+		return -1;
+	while (low < high) {
+		int mid = (low + high) / 2;
+
+		if (pi->entry[mid].sec >= time)
+			high = mid;
+		else
+			low = mid + 1;
 	}
-	if (entry)
-		plot_string(pi, entry, mb);
-	return entry;
+	return low;
+}
+
+void get_plot_entry_details(struct plot_info *pi, int idx, struct membuffer *mb)
+{
+	plot_string(pi, pi->entry + idx, mb);
+}
+
+struct plot_data *get_plot_details_new(struct plot_info *pi, int time, struct membuffer *mb)
+{
+	int idx = get_plot_entry_index(pi, time);
+
+	if (idx < 0)
+		return NULL;
+	get_plot_entry_details(pi, idx, mb);
+	return pi->entry + idx;
 }
 
 /* Compare two plot_data entries and writes the results into a string */
-void compare_samples(struct plot_data *e1, struct plot_data *e2, char *buf, int bufsize, int sum)
+void compare_samples(struct plot_info *pi, int idx1, int idx2, char *buf, int bufsize, int sum)
 {
 	struct plot_data *start, *stop, *data;
+	int start_idx, stop_idx;
 	const char *depth_unit, *pressure_unit, *vertical_speed_unit;
 	char *buf2 = malloc(bufsize);
 	int avg_speed, max_asc_speed, max_desc_speed;
@@ -1542,21 +1953,23 @@ void compare_samples(struct plot_data *e1, struct plot_data *e2, char *buf, int
 
 	if (bufsize > 0)
 		buf[0] = '\0';
-	if (e1 == NULL || e2 == NULL) {
+	if (idx1 < 0 || idx2 < 0) {
 		free(buf2);
 		return;
 	}
 
-	if (e1->sec < e2->sec) {
-		start = e1;
-		stop = e2;
-	} else if (e1->sec > e2->sec) {
-		start = e2;
-		stop = e1;
+	if (pi->entry[idx1].sec < pi->entry[idx2].sec) {
+		start_idx = idx1;
+		stop_idx = idx2;
+	} else if (pi->entry[idx1].sec > pi->entry[idx2].sec) {
+		start_idx = idx2;
+		stop_idx = idx1;
 	} else {
 		free(buf2);
 		return;
 	}
+	start = pi->entry + start_idx;
+	stop = pi->entry + stop_idx;
 	count = 0;
 	avg_speed = 0;
 	max_asc_speed = 0;
@@ -1570,7 +1983,7 @@ void compare_samples(struct plot_data *e1, struct plot_data *e2, char *buf, int
 	bar_used = 0;
 
 	last_sec = start->sec;
-	last_pressure = GET_PRESSURE(start, 0);
+	last_pressure = get_plot_pressure(pi, start_idx, 0);
 
 	data = start;
 	while (data != stop) {
@@ -1591,12 +2004,13 @@ void compare_samples(struct plot_data *e1, struct plot_data *e2, char *buf, int
 		if (data->depth > max_depth)
 			max_depth = data->depth;
 		/* Try to detect gas changes - this hack might work for some side mount scenarios? */
-		if (GET_PRESSURE(data, 0) < last_pressure + 2000)
-			bar_used += last_pressure - GET_PRESSURE(data, 0);
+		int pressure = get_plot_pressure(pi, start_idx + count, 0);
+		if (pressure < last_pressure + 2000)
+			bar_used += last_pressure - pressure;
 
 		count += 1;
 		last_sec = data->sec;
-		last_pressure = GET_PRESSURE(data, 0);
+		last_pressure = pressure;
 	}
 	avg_depth /= stop->sec - start->sec;
 	avg_speed /= stop->sec - start->sec;
@@ -1643,15 +2057,15 @@ void compare_samples(struct plot_data *e1, struct plot_data *e2, char *buf, int
 			double volume_value;
 			int volume_precision;
 			const char *volume_unit;
-			struct plot_data *first = start;
-			struct plot_data *last = stop;
-			while (first < stop && GET_PRESSURE(first, 0) == 0)
+			int first = start_idx;
+			int last = stop_idx;
+			while (first < stop_idx && get_plot_pressure(pi, first, 0) == 0)
 				first++;
-			while (last > first && GET_PRESSURE(last, 0) == 0)
+			while (last > first && get_plot_pressure(pi, last, 0) == 0)
 				last--;
 
-			pressure_t first_pressure = { GET_PRESSURE(first, 0) };
-			pressure_t stop_pressure = { GET_PRESSURE(last, 0) };
+			pressure_t first_pressure = { get_plot_pressure(pi, first, 0) };
+			pressure_t stop_pressure = { get_plot_pressure(pi, last, 0) };
 			int volume_used = gas_volume(cyl, first_pressure) - gas_volume(cyl, stop_pressure);
 
 			/* Mean pressure in ATM */
@@ -3,6 +3,7 @@
 #define PROFILE_H
 
 #include "dive.h"
+#include "display.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -22,17 +23,10 @@ struct plot_info;
 struct plot_data {
 	unsigned int in_deco : 1;
 	int sec;
-	/*
-	 * pressure[x][0] is sensor pressure for cylinder x
-	 * pressure[x][1] is interpolated pressure
-	 */
-	int pressure[MAX_CYLINDERS][2];
 	int temperature;
 	/* Depth info */
 	int depth;
 	int ceiling;
-	int ceilings[16];
-	int percentages[16];
 	int ndl;
 	int tts;
 	int rbt;
@@ -65,17 +59,56 @@ struct plot_data {
 	double density;
 };
 
+/*
+ * The cylinder pressures and the tissue ceilings and saturations of an
+ * entry are not in struct plot_data, but in arrays of struct plot_info
+ * that are only allocated for the cylinders of the dive and the graphs
+ * that are calculated. Read them with the accessors below.
+ */
+enum plot_pressure {
+	SENSOR_PR = 0,
+	INTERPOLATED_PR = 1,
+	NUM_PLOT_PRESSURES = 2
+};
+
+struct plot_pressure_data {
+	int data[NUM_PLOT_PRESSURES];
+};
+
+/*
+ * What the deco calculation of the profile looks at besides the deco state.
+ * Like the deco state, it is set up on the GUI thread, so that the profile
+ * can then be calculated on another one.
+ */
+struct profile_deco_settings {
+	bool calcalltissues;
+	bool calcceiling3m;
+	bool calcndltts;
+	bool calcndltts_iterative;
+	/* where the planner's deco state is, while planning */
+	int planner_deco_time;
+	pressure_t planner_first_ceiling_pressure;
+};
+
 struct ev_select {
 	char *ev_name;
 	bool plot_ev;
 };
 
 struct plot_info calculate_max_limits_new(struct dive *dive, struct divecomputer *given_dc);
-void compare_samples(struct plot_data *e1, struct plot_data *e2, char *buf, int bufsize, int sum);
+void compare_samples(struct plot_info *pi, int idx1, int idx2, char *buf, int bufsize, int sum);
 struct plot_data *populate_plot_entries(struct dive *dive, struct divecomputer *dc, struct plot_info *pi);
+void copy_plot_info_data(struct plot_info *dst, const struct plot_info *src);
+void free_plot_info_data(struct plot_info *pi);
 struct plot_info *analyze_plot_info(struct plot_info *pi);
 void create_plot_info_new(struct dive *dive, struct divecomputer *dc, struct plot_info *pi, bool fast, struct deco_state *planner_ds);
-void calculate_deco_information(struct deco_state *ds, struct deco_state *planner_de, struct dive *dive, struct divecomputer *dc, struct plot_info *pi, bool print_mode);
+void calculate_plot_info(struct dive *dive, struct divecomputer *dc, struct plot_info *pi, bool fast, struct deco_state *ds, const struct profile_deco_settings *settings);
+void init_profile_deco_parameters(struct deco_state *ds, const struct deco_state *planner_ds);
+void init_profile_deco_settings(struct profile_deco_settings *settings, const struct deco_state *ds, const struct deco_state *planner_ds);
+void calculate_deco_information(struct deco_state *ds, const struct profile_deco_settings *settings, struct dive *dive, struct divecomputer *dc, struct plot_info *pi, bool print_mode);
+int deco_resumed_entries(void);
+int get_plot_entry_index(const struct plot_info *pi, int time);
+void get_plot_entry_details(struct plot_info *pi, int idx, struct membuffer *);
 struct plot_data *get_plot_details_new(struct plot_info *pi, int time, struct membuffer *);
 
 /*
@@ -93,11 +126,46 @@ int get_maxtime(struct plot_info *pi);
  * partial pressure graphs */
 int get_maxdepth(struct plot_info *pi);
 
-#define SENSOR_PR 0
-#define INTERPOLATED_PR 1
-#define SENSOR_PRESSURE(_entry,_idx) (_entry)->pressure[_idx][SENSOR_PR]
-#define INTERPOLATED_PRESSURE(_entry,_idx) (_entry)->pressure[_idx][INTERPOLATED_PR]
-#define GET_PRESSURE(_entry,_idx) (SENSOR_PRESSURE(_entry,_idx) ? SENSOR_PRESSURE(_entry,_idx) : INTERPOLATED_PRESSURE(_entry,_idx))
+static inline int get_plot_pressure_data(const struct plot_info *pi, int idx, enum plot_pressure sensor, int cylinder)
+{
+	if (cylinder >= pi->nr_cylinders)
+		return 0;
+	return pi->pressures[idx * pi->nr_cylinders + cylinder].data[sensor];
+}
+
+static inline void set_plot_pressure_data(struct plot_info *pi, int idx, enum plot_pressure sensor, int cylinder, int value)
+{
+	if (cylinder < pi->nr_cylinders)
+		pi->pressures[idx * pi->nr_cylinders + cylinder].data[sensor] = value;
+}
+
+static inline int get_plot_sensor_pressure(const struct plot_info *pi, int idx, int cylinder)
+{
+	return get_plot_pressure_data(pi, idx, SENSOR_PR, cylinder);
+}
+
+static inline int get_plot_interpolated_pressure(const struct plot_info *pi, int idx, int cylinder)
+{
+	return get_plot_pressure_data(pi, idx, INTERPOLATED_PR, cylinder);
+}
+
+static inline int get_plot_pressure(const struct plot_info *pi, int idx, int cylinder)
+{
+	int res = get_plot_sensor_pressure(pi, idx, cylinder);
+	return res ? res : get_plot_interpolated_pressure(pi, idx, cylinder);
+}
+
+/* the tissue ceilings are only calculated with prefs.calcalltissues */
+static inline int get_plot_ceiling(const struct plot_info *pi, int idx, int tissue)
+{
+	return pi->ceilings ? pi->ceilings[idx * 16 + tissue] : 0;
+}
+
+static inline int get_plot_percentage(const struct plot_info *pi, int idx, int tissue)
+{
+	return pi->percentages ? pi->percentages[idx * 16 + tissue] : 0;
+}
+
 #define SAC_WINDOW 45 /* sliding window in seconds for current SAC calculation */
 
 #ifdef __cplusplus
@@ -403,6 +403,12 @@ extern "C" bool string_sequence_contains(const char *string_sequence, const char
 	return false;
 }
 
+/* the trimmed, case folded form of text, so that equal names compare equal with strcmp */
+extern "C" char *casefold_string(const char *text)
+{
+	return copy_qstring(QString(text).trimmed().toCaseFolded());
+}
+
 static bool lessThan(const QPair<QString, int> &a, const QPair<QString, int> &b)
 {
 	return a.second < b.second;
@@ -1680,31 +1686,6 @@ char *intdup(int index)
 	return strdup(tmpbuf);
 }
 
-QHash<int, double> factor_cache;
-
-QReadWriteLock factorCacheLock;
-extern "C" double cache_value(int tissue, int timestep, enum inertgas inertgas)
-{
-	double value;
-	int key = (timestep << 5) + (tissue << 1);
-	if (inertgas == HE)
-		++key;
-	factorCacheLock.lockForRead();
-	value = factor_cache.value(key);
-	factorCacheLock.unlock();
-	return value;
-}
-
-extern "C" void cache_insert(int tissue, int timestep, enum inertgas inertgas, double value)
-{
-	int key = (timestep << 5) + (tissue << 1);
-	if (inertgas == HE)
-		++key;
-	factorCacheLock.lockForWrite();
-	factor_cache.insert(key, value);
-	factorCacheLock.unlock();
-}
-
 extern "C" void print_qt_versions()
 {
 	printf("%s\n", qPrintable(QStringLiteral("built with Qt Version %1, runtime from Qt Version %2").arg(QT_VERSION_STR).arg(qVersion())));
@@ -1722,6 +1703,30 @@ extern "C" void unlock_planner()
 	planLock.unlock();
 }
 
+QMutex decoCacheLock;
+
+extern "C" bool trylock_deco_cache()
+{
+	return decoCacheLock.tryLock();
+}
+
+extern "C" void unlock_deco_cache()
+{
+	decoCacheLock.unlock();
+}
+
+QMutex decoSnapshotsLock;
+
+extern "C" void lock_deco_snapshots()
+{
+	decoSnapshotsLock.lock();
+}
+
+extern "C" void unlock_deco_snapshots()
+{
+	decoSnapshotsLock.unlock();
+}
+
 char *copy_qstring(const QString &s)
 {
 	return strdup(qPrintable(s));
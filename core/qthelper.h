@@ -80,11 +80,14 @@ const char *subsurface_user_agent();
 enum deco_mode decoMode();
 int parse_seabear_header(const char *filename, char **params, int pnr);
 const char *get_current_date();
-double cache_value(int tissue, int timestep, enum inertgas gas);
-void cache_insert(int tissue, int timestep, enum inertgas gas, double value);
 void print_qt_versions();
 void lock_planner();
 void unlock_planner();
+bool trylock_deco_cache();
+void unlock_deco_cache();
+void lock_deco_snapshots();
+void unlock_deco_snapshots();
+char *casefold_string(const char *text);
 
 #ifdef __cplusplus
 }
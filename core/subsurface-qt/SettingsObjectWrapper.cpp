@@ -352,6 +352,16 @@ bool TechnicalDetailsSettings::calcndltts() const
 	return prefs.calcndltts;
 }
 
+bool TechnicalDetailsSettings::calcndlttsIterative() const
+{
+	return prefs.calcndltts_iterative;
+}
+
+int TechnicalDetailsSettings::profileCacheSize() const
+{
+	return prefs.profile_cache_size;
+}
+
 bool TechnicalDetailsSettings::buehlmann() const
 {
 	return prefs.planner_deco_mode == BUEHLMANN;
@@ -557,6 +567,30 @@ void TechnicalDetailsSettings::setCalcndltts(bool value)
 	emit calcndlttsChanged(value);
 }
 
+void TechnicalDetailsSettings::setCalcndlttsIterative(bool value)
+{
+	if (value == prefs.calcndltts_iterative)
+		return;
+
+	QSettings s;
+	s.beginGroup(group);
+	s.setValue("calcndltts_iterative", value);
+	prefs.calcndltts_iterative = value;
+	emit calcndlttsIterativeChanged(value);
+}
+
+void TechnicalDetailsSettings::setProfileCacheSize(int value)
+{
+	if (value == prefs.profile_cache_size)
+		return;
+
+	QSettings s;
+	s.beginGroup(group);
+	s.setValue("profile_cache_size", value);
+	prefs.profile_cache_size = value;
+	emit profileCacheSizeChanged(value);
+}
+
 void TechnicalDetailsSettings::setBuehlmann(bool value)
 {
 	if (value == (prefs.planner_deco_mode == BUEHLMANN))
@@ -2211,6 +2245,8 @@ void SettingsObjectWrapper::load()
 	GET_BOOL("calcceiling", calcceiling);
 	GET_BOOL("calcceiling3m", calcceiling3m);
 	GET_BOOL("calcndltts", calcndltts);
+	GET_BOOL("calcndltts_iterative", calcndltts_iterative);
+	GET_INT("profile_cache_size", profile_cache_size);
 	GET_BOOL("calcalltissues", calcalltissues);
 	GET_BOOL("hrgraph", hrgraph);
 	GET_BOOL("tankbar", tankbar);
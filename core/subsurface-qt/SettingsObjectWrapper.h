@@ -125,6 +125,8 @@ class TechnicalDetailsSettings : public QObject {
 	Q_PROPERTY(bool calcceiling3m    READ calcceiling3m   WRITE setCalcceiling3m   NOTIFY calcceiling3mChanged)
 	Q_PROPERTY(bool calcalltissues   READ calcalltissues  WRITE setCalcalltissues  NOTIFY calcalltissuesChanged)
 	Q_PROPERTY(bool calcndltts       READ calcndltts      WRITE setCalcndltts      NOTIFY calcndlttsChanged)
+	Q_PROPERTY(bool calcndltts_iterative READ calcndlttsIterative WRITE setCalcndlttsIterative NOTIFY calcndlttsIterativeChanged)
+	Q_PROPERTY(int profile_cache_size READ profileCacheSize WRITE setProfileCacheSize NOTIFY profileCacheSizeChanged)
 	Q_PROPERTY(bool buehlmann        READ buehlmann       WRITE setBuehlmann       NOTIFY buehlmannChanged)
 	Q_PROPERTY(int gflow            READ gflow           WRITE setGflow           NOTIFY gflowChanged)
 	Q_PROPERTY(int gfhigh           READ gfhigh          WRITE setGfhigh          NOTIFY gfhighChanged)
@@ -155,6 +157,8 @@ public:
 	bool calcceiling3m() const;
 	bool calcalltissues() const;
 	bool calcndltts() const;
+	bool calcndlttsIterative() const;
+	int profileCacheSize() const;
 	bool buehlmann() const;
 	int gflow() const;
 	int gfhigh() const;
@@ -183,6 +187,8 @@ public slots:
 	void setCalcceiling3m(bool value);
 	void setCalcalltissues(bool value);
 	void setCalcndltts(bool value);
+	void setCalcndlttsIterative(bool value);
+	void setProfileCacheSize(int value);
 	void setBuehlmann(bool value);
 	void setGflow(int value);
 	void setGfhigh(int value);
@@ -211,6 +217,8 @@ signals:
 	void calcceiling3mChanged(bool value);
 	void calcalltissuesChanged(bool value);
 	void calcndlttsChanged(bool value);
+	void calcndlttsIterativeChanged(bool value);
+	void profileCacheSizeChanged(int value);
 	void buehlmannChanged(bool value);
 	void gflowChanged(int value);
 	void gfhighChanged(int value);
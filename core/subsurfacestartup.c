@@ -36,6 +36,8 @@ struct preferences default_prefs = {
 	.calcceiling = false,
 	.calcceiling3m = false,
 	.calcndltts = false,
+	.calcndltts_iterative = false,
+	.profile_cache_size = 32,
 	.gflow = 30,
 	.gfhigh = 75,
 	.animation_speed = 500,
@@ -122,6 +124,8 @@ static int sortfn(const void *_a, const void *_b)
 void sort_table(struct dive_table *table)
 {
 	qsort(table->dives, table->nr, sizeof(struct dive *), sortfn);
+	if (table == &dive_table)
+		invalidate_dive_indexes();
 }
 
 const char *monthname(int mon)
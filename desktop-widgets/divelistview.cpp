@@ -424,13 +424,19 @@ void DiveListView::reload(DiveTripModel::Layout layout, bool forceSort)
 
 	QSortFilterProxyModel *m = qobject_cast<QSortFilterProxyModel *>(model());
 	QAbstractItemModel *oldModel = m->sourceModel();
-	if (oldModel) {
-		oldModel->deleteLater();
-	}
-	tripModel = new DiveTripModel(this);
-	tripModel->setLayout(layout);
+	if (oldModel && oldModel == tripModel && tripModel->layout() == layout) {
+		// same layout - only update the rows that changed, which keeps the
+		// selection and the expanded trips
+		tripModel->updateModelData();
+	} else {
+		if (oldModel) {
+			oldModel->deleteLater();
+		}
+		tripModel = new DiveTripModel(this);
+		tripModel->setLayout(layout);
 
-	m->setSourceModel(tripModel);
+		m->setSourceModel(tripModel);
+	}
 
 	if (!forceSort)
 		return;
@@ -944,15 +950,8 @@ void DiveListView::matchImagesToDives(QStringList fileNames)
 		return;
 	updateLastImageTimeOffset(shiftDialog.amount());
 
-	Q_FOREACH (const QString &fileName, fileNames) {
-		int j = 0;
-		struct dive *dive;
-		for_each_dive (j, dive) {
-			if (!dive->selected)
-				continue;
-			dive_create_picture(dive, copy_qstring(fileName), shiftDialog.amount(), shiftDialog.matchAll());
-		}
-	}
+	Q_FOREACH (const QString &fileName, fileNames)
+		create_picture_for_selected_dives(qPrintable(fileName), shiftDialog.amount(), shiftDialog.matchAll());
 
 	mark_divelist_changed(true);
 	copy_dive(current_dive, &displayed_dive);
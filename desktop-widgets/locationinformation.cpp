@@ -166,8 +166,7 @@ void LocationInformationWidget::acceptChanges()
 		currentDs = get_dive_site_by_uuid(create_dive_site_from_current_dive(uiString));
 		displayed_dive.dive_site_uuid = currentDs->uuid;
 	}
-	currentDs->latitude = displayed_dive_site.latitude;
-	currentDs->longitude = displayed_dive_site.longitude;
+	set_dive_site_gps(currentDs, displayed_dive_site.latitude, displayed_dive_site.longitude);
 	if (!same_string(uiString, currentDs->name)) {
 		emit nameChanged(QString(currentDs->name), ui.diveSiteName->text());
 		free(currentDs->name);
@@ -204,10 +203,13 @@ void LocationInformationWidget::acceptChanges()
 	if (!ui.diveSiteCoordinates->text().isEmpty()) {
 		double lat, lon;
 		if (parseGpsText(ui.diveSiteCoordinates->text(), &lat, &lon)) {
-			currentDs->latitude.udeg = lrint(lat * 1000000.0);
-			currentDs->longitude.udeg = lrint(lon * 1000000.0);
+			degrees_t latitude, longitude;
+			latitude.udeg = lrint(lat * 1000000.0);
+			longitude.udeg = lrint(lon * 1000000.0);
+			set_dive_site_gps(currentDs, latitude, longitude);
 		}
 	}
+	invalidate_dive_site_dives(currentDs->uuid);
 	if (dive_site_is_empty(currentDs)) {
 		LocationInformationModel::instance()->removeRow(get_divesite_idx(currentDs));
 		displayed_dive.dive_site_uuid = 0;
@@ -45,11 +45,12 @@ static void copy_gps_location(struct dive *from, struct dive *to)
 		if (!ds) {
 			// simply link to the one created for the fake dive
 			to->dive_site_uuid = gds->uuid;
+			invalidate_dive_cache(to);
 		} else {
-			ds->latitude = gds->latitude;
-			ds->longitude = gds->longitude;
+			set_dive_site_gps(ds, gds->latitude, gds->longitude);
 			if (same_string(ds->name, ""))
 				ds->name = copy_string(gds->name);
+			invalidate_dive_site_dives(ds->uuid);
 		}
 	}
 }
@@ -72,7 +73,16 @@ static bool merge_locations_into_dives(void)
 
 	for_each_dive (i, dive) {
 		if (!dive_has_gps_location(dive)) {
-			for (j = tracer; (gpsfix = get_dive_from_table(j, &gps_location_table)) !=NULL; j++) {
+			// the fixes are sorted, so skip right to the first one that can belong to this dive
+			int lo = tracer, hi = gps_location_table.nr;
+			while (lo < hi) {
+				int mid = (lo + hi) / 2;
+				if (gps_location_table.dives[mid]->when < dive->when - SAME_GROUP)
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+			for (j = lo; (gpsfix = get_dive_from_table(j, &gps_location_table)) !=NULL; j++) {
 				if (time_during_dive_with_offset(dive, gpsfix->when, SAME_GROUP)) {
 					if (verbose)
 						qDebug() << "processing gpsfix @" << get_dive_date_string(gpsfix->when) <<
@@ -745,11 +745,11 @@ uint32_t MainTab::updateDiveSite(uint32_t pickedUuid, int divenr)
 			copy_dive_site(origDs, newDs);
 			free(newDs->name);
 			newDs->name = copy_qstring(ui.location->text());
-			newDs->uuid = pickedUuid;
+			set_dive_site_uuid(newDs, pickedUuid);
 			qDebug() << "Creating and copying dive site";
 		} else if (newDs->latitude.udeg == 0 && newDs->longitude.udeg == 0) {
-			newDs->latitude.udeg = origDs->latitude.udeg;
-			newDs->longitude.udeg = origDs->longitude.udeg;
+			set_dive_site_gps(newDs, origDs->latitude, origDs->longitude);
+			invalidate_dive_site_dives(newDs->uuid);
 			qDebug() << "Copying GPS information";
 		}
 	}
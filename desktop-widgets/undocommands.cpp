@@ -84,6 +84,7 @@ void UndoShiftTime::undo()
 	for (int i = 0; i < diveList.count(); i++) {
 		struct dive* d = get_dive_by_uniq_id(diveList.at(i));
 		d->when -= timeChanged;
+		invalidate_dive_cache(d);
 	}
 	mark_divelist_changed(true);
 	MainWindow::instance()->refreshDisplay();
@@ -94,6 +95,7 @@ void UndoShiftTime::redo()
 	for (int i = 0; i < diveList.count(); i++) {
 		struct dive* d = get_dive_by_uniq_id(diveList.at(i));
 		d->when += timeChanged;
+		invalidate_dive_cache(d);
 	}
 	mark_divelist_changed(true);
 	MainWindow::instance()->refreshDisplay();
@@ -114,6 +116,7 @@ void UndoRenumberDives::undo()
 	foreach (int key, oldNumbers.keys()) {
 		struct dive* d = get_dive_by_uniq_id(key);
 		d->number = oldNumbers.value(key).first;
+		invalidate_dive_cache(d);
 	}
 	mark_divelist_changed(true);
 	MainWindow::instance()->refreshDisplay();
@@ -124,6 +127,7 @@ void UndoRenumberDives::redo()
 	foreach (int key, oldNumbers.keys()) {
 		struct dive* d = get_dive_by_uniq_id(key);
 		d->number = oldNumbers.value(key).second;
+		invalidate_dive_cache(d);
 	}
 	mark_divelist_changed(true);
 	MainWindow::instance()->refreshDisplay();
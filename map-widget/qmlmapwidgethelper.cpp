@@ -2,6 +2,7 @@
 #include <QApplication>
 #include <QClipboard>
 #include <QDebug>
+#include <QSet>
 #include <QVector>
 
 #include "qmlmapwidgethelper.h"
@@ -160,16 +161,26 @@ void MapWidgetHelper::selectedLocationChanged(MapLocation *location)
 	int idx;
 	struct dive *dive;
 	m_selectedDiveIds.clear();
+#ifndef SUBSURFACE_MOBILE
+	// ask the dive site index for the sites inside the small circle
+	// instead of measuring the distance to every dive's site
 	QGeoCoordinate locationCoord = location->coordinate();
+	degrees_t latitude, longitude;
+	latitude.udeg = lrint(locationCoord.latitude() * 1000000.0);
+	longitude.udeg = lrint(locationCoord.longitude() * 1000000.0);
+	struct dive_site **sites;
+	int nr = get_dive_sites_within_distance(latitude, longitude, lrint(m_smallCircleRadius), &sites);
+	QSet<uint32_t> uuids;
+	for (int i = 0; i < nr; i++)
+		uuids.insert(sites[i]->uuid);
+	free(sites);
+#endif
 	for_each_dive (idx, dive) {
 		struct dive_site *ds = get_dive_site_for_dive(dive);
 		if (!dive_site_has_gps_location(ds))
 			continue;
 #ifndef SUBSURFACE_MOBILE
-		const qreal latitude = ds->latitude.udeg * 0.000001;
-		const qreal longitude = ds->longitude.udeg * 0.000001;
-		QGeoCoordinate dsCoord(latitude, longitude);
-		if (locationCoord.distanceTo(dsCoord) < m_smallCircleRadius)
+		if (uuids.contains(ds->uuid))
 			m_selectedDiveIds.append(idx);
 	}
 #else // the mobile version doesn't support multi-dive selection
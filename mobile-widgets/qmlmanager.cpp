@@ -716,8 +716,10 @@ void QMLManager::refreshDiveList()
 static void setupDivesite(struct dive *d, struct dive_site *ds, double lat, double lon, const char *locationtext)
 {
 	if (ds) {
-		ds->latitude.udeg = lrint(lat * 1000000);
-		ds->longitude.udeg = lrint(lon * 1000000);
+		degrees_t latData, lonData;
+		latData.udeg = lrint(lat * 1000000);
+		lonData.udeg = lrint(lon * 1000000);
+		set_dive_site_gps(ds, latData, lonData);
 	} else {
 		degrees_t latData, lonData;
 		latData.udeg = lrint(lat);
@@ -443,10 +443,10 @@ void PartialGasPressureAxis::settingsChanged()
 		return;
 
 	double max = showPhe ? model->pheMax() : -1;
-	if (showPn2 && model->pn2Max() > max)
-		max = model->pn2Max();
-	if (showPo2 && model->po2Max() > max)
-		max = model->po2Max();
+	if (showPn2)
+		max = qMax(max, model->pn2Max());
+	if (showPo2)
+		max = qMax(max, model->po2Max());
 
 	qreal pp = floor(max * 10.0) / 10.0 + 0.2;
 	if (IS_FP_SAME(maximum(), pp))
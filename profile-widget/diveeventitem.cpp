@@ -253,15 +253,15 @@ void DiveEventItem::recalculatePos(bool instant)
 	if (!vAxis || !hAxis || !internalEvent || !dataModel)
 		return;
 
-	QModelIndexList result = dataModel->match(dataModel->index(0, DivePlotDataModel::TIME), Qt::DisplayRole, internalEvent->time.seconds);
-	if (result.isEmpty()) {
+	int row = dataModel->rowAtTime(internalEvent->time.seconds);
+	if (row < 0) {
 		Q_ASSERT("can't find a spot in the dataModel");
 		hide();
 		return;
 	}
 	if (!isVisible() && !shouldBeHidden())
 		show();
-	int depth = dataModel->data(dataModel->index(result.first().row(), DivePlotDataModel::DEPTH)).toInt();
+	int depth = dataModel->data().entry[row].depth;
 	qreal x = hAxis->posAtValue(internalEvent->time.seconds);
 	qreal y = vAxis->posAtValue(depth);
 	if (!instant)
@@ -16,6 +16,9 @@
 #include "libdivecomputer/parser.h"
 #include "profile-widget/profilewidget2.h"
 
+#include <cmath>
+#include <algorithm>
+
 AbstractProfilePolygonItem::AbstractProfilePolygonItem() : QObject(), QGraphicsPolygonItem(), hAxis(NULL), vAxis(NULL), dataModel(NULL), hDataColumn(-1), vDataColumn(-1)
 {
 	setCacheMode(DeviceCoordinateCache);
@@ -95,6 +98,73 @@ bool AbstractProfilePolygonItem::shouldCalculateStuff(const QModelIndex &topLeft
 	return true;
 }
 
+qreal AbstractProfilePolygonItem::pixelWidth()
+{
+	if (!scene() || scene()->views().isEmpty())
+		return 0.0;
+	ProfileWidget2 *view = qobject_cast<ProfileWidget2 *>(scene()->views().first());
+	// printing renders the scene at a much higher resolution than the screen
+	if (!view || view->getPrintMode())
+		return 0.0;
+	qreal scale = view->transform().m11();
+	return scale > 0.0 ? 1.0 / scale : 0.0;
+}
+
+QPolygonF AbstractProfilePolygonItem::decimate(const QPolygonF &poly, QVector<int> *rows)
+{
+	qreal width = pixelWidth();
+	if (width <= 0.0 || poly.count() < 8)
+		return poly;
+
+	// the x positions of the events, that the polygon has to go through exactly
+	QVector<qreal> events;
+	struct divecomputer *dc = select_dc(&displayed_dive);
+	for (struct event *ev = dc->events; ev; ev = ev->next)
+		events.append(hAxis->posAtValue(ev->time.seconds));
+
+	QPolygonF res;
+	QVector<int> resRows;
+	auto flush = [&](int first, int low, int high, int last) {
+		int idx[4] = { first, low, high, last };
+		std::sort(idx, idx + 4);
+		for (int k = 0; k < 4; k++) {
+			if (k && idx[k] == idx[k - 1])
+				continue;
+			res.append(poly[idx[k]]);
+			if (rows)
+				resRows.append(rows->at(idx[k]));
+		}
+	};
+
+	int first = 0, low = 0, high = 0, ev = 0;
+	for (int i = 0; i < poly.count(); i++) {
+		const QPointF &p = poly[i];
+		while (ev < events.count() && events[ev] < p.x())
+			ev++;
+		bool exact = ev < events.count() && events[ev] == p.x();
+
+		if (i > first && (exact || floor(p.x() / width) != floor(poly[first].x() / width))) {
+			flush(first, low, high, i - 1);
+			first = low = high = i;
+		}
+		if (p.y() < poly[low].y())
+			low = i;
+		if (p.y() > poly[high].y())
+			high = i;
+		// the point of an event gets a column of its own
+		if (exact) {
+			flush(first, low, high, i);
+			first = low = high = i + 1;
+		}
+	}
+	if (first < poly.count())
+		flush(first, low, high, poly.count() - 1);
+
+	if (rows)
+		*rows = resRows;
+	return res;
+}
+
 void AbstractProfilePolygonItem::modelDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight)
 {
 	Q_UNUSED(topLeft);
@@ -105,13 +175,15 @@ void AbstractProfilePolygonItem::modelDataChanged(const QModelIndex &topLeft, co
 	// is an array of QPointF's, so we basically get the point from the model, convert
 	// to our coordinates, store. no painting is done here.
 	QPolygonF poly;
+	QVector<double> horizontalValues = dataModel->columnData(hDataColumn);
+	QVector<double> verticalValues = dataModel->columnData(vDataColumn);
+	polygonRows.clear();
 	for (int i = 0, modelDataCount = dataModel->rowCount(); i < modelDataCount; i++) {
-		qreal horizontalValue = dataModel->index(i, hDataColumn).data().toReal();
-		qreal verticalValue = dataModel->index(i, vDataColumn).data().toReal();
-		QPointF point(hAxis->posAtValue(horizontalValue), vAxis->posAtValue(verticalValue));
+		QPointF point(hAxis->posAtValue(horizontalValues[i]), vAxis->posAtValue(verticalValues[i]));
 		poly.append(point);
+		polygonRows.append(i);
 	}
-	setPolygon(poly);
+	setPolygon(decimate(poly, &polygonRows));
 
 	qDeleteAll(texts);
 	texts.clear();
@@ -148,9 +220,9 @@ void DiveProfileItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *o
 	pen.setWidth(2);
 	QPolygonF poly = polygon();
 	// This paints the colors of the velocities.
-	for (int i = 1, count = dataModel->rowCount(); i < count; i++) {
-		QModelIndex colorIndex = dataModel->index(i, DivePlotDataModel::COLOR);
-		pen.setBrush(QBrush(colorIndex.data(Qt::BackgroundRole).value<QColor>()));
+	for (int i = 1, count = polygonRows.count(); i < count; i++) {
+		int velocity = lrint(dataModel->value(polygonRows[i], DivePlotDataModel::COLOR));
+		pen.setBrush(QBrush(getColor((color_index_t)(VELOCITY_COLORS_START_IDX + velocity))));
 		painter->setPen(pen);
 		if (i < poly.count())
 			painter->drawLine(poly[i - 1], poly[i]);
@@ -161,10 +233,10 @@ void DiveProfileItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *o
 int DiveProfileItem::maxCeiling(int row)
 {
 	int max = -1;
-	plot_data *entry = dataModel->data().entry + row;
 	for (int tissue = 0; tissue < 16; tissue++) {
-		if (max < entry->ceilings[tissue])
-			max = entry->ceilings[tissue];
+		int ceiling = get_plot_ceiling(&dataModel->data(), row, tissue);
+		if (max < ceiling)
+			max = ceiling;
 	}
 	return max;
 }
@@ -204,9 +276,9 @@ void DiveProfileItem::modelDataChanged(const QModelIndex &topLeft, const QModelI
 #endif
 	/* Show any ceiling we may have encountered */
 	if (prefs.dcceiling && !prefs.redceiling) {
-		QPolygonF p = polygon();
-		plot_data *entry = dataModel->data().entry + dataModel->rowCount() - 1;
-		for (int i = dataModel->rowCount() - 1; i >= 0; i--, entry--) {
+		QPolygonF p;
+		plot_data *entry = dataModel->data().entry;
+		for (int i = 0; i < dataModel->rowCount(); i++, entry++) {
 			if (!entry->in_deco) {
 				/* not in deco implies this is a safety stop, no ceiling */
 				p.append(QPointF(hAxis->posAtValue(entry->sec), vAxis->posAtValue(0)));
@@ -214,7 +286,9 @@ void DiveProfileItem::modelDataChanged(const QModelIndex &topLeft, const QModelI
 				p.append(QPointF(hAxis->posAtValue(entry->sec), vAxis->posAtValue(qMin(entry->stopdepth, entry->depth))));
 			}
 		}
-		setPolygon(p);
+		p = decimate(p);
+		std::reverse(p.begin(), p.end());
+		setPolygon(polygon() + p);
 	}
 
 	// This is the blueish gradient that the Depth Profile should have.
@@ -294,11 +368,13 @@ void DiveHeartrateItem::modelDataChanged(const QModelIndex &topLeft, const QMode
 	texts.clear();
 	// Ignore empty values. a heart rate of 0 would be a bad sign.
 	QPolygonF poly;
+	QVector<double> horizontalValues = dataModel->columnData(hDataColumn);
+	QVector<double> verticalValues = dataModel->columnData(vDataColumn);
 	for (int i = 0, modelDataCount = dataModel->rowCount(); i < modelDataCount; i++) {
-		int hr = dataModel->index(i, vDataColumn).data().toInt();
+		int hr = lrint(verticalValues[i]);
 		if (!hr)
 			continue;
-		sec = dataModel->index(i, hDataColumn).data().toInt();
+		sec = lrint(horizontalValues[i]);
 		QPointF point(hAxis->posAtValue(sec), vAxis->posAtValue(hr));
 		poly.append(point);
 		if (hr == hist[2].hr)
@@ -327,7 +403,7 @@ void DiveHeartrateItem::modelDataChanged(const QModelIndex &topLeft, const QMode
 		createTextItem(sec, hr);
 		last_printed_hr = hr;
 	}
-	setPolygon(poly);
+	setPolygon(decimate(poly));
 
 	if (texts.count())
 		texts.last()->setAlignment(Qt::AlignLeft | Qt::AlignBottom);
@@ -373,12 +449,15 @@ void DivePercentageItem::modelDataChanged(const QModelIndex &topLeft, const QMod
 
 	// Ignore empty values. a heart rate of 0 would be a bad sign.
 	QPolygonF poly;
+	polygonRows.clear();
+	QVector<double> horizontalValues = dataModel->columnData(hDataColumn);
 	for (int i = 0, modelDataCount = dataModel->rowCount(); i < modelDataCount; i++) {
-		sec = dataModel->index(i, hDataColumn).data().toInt();
+		sec = lrint(horizontalValues[i]);
 		QPointF point(hAxis->posAtValue(sec), vAxis->posAtValue(64 - 4 * tissueIndex));
 		poly.append(point);
+		polygonRows.append(i);
 	}
-	setPolygon(poly);
+	setPolygon(decimate(poly, &polygonRows));
 
 	if (texts.count())
 		texts.last()->setAlignment(Qt::AlignLeft | Qt::AlignBottom);
@@ -420,12 +499,13 @@ void DivePercentageItem::paint(QPainter *painter, const QStyleOptionGraphicsItem
 	mypen.setCapStyle(Qt::FlatCap);
 	mypen.setCosmetic(false);
 	QPolygonF poly = polygon();
-	for (int i = 1, modelDataCount = dataModel->rowCount(); i < modelDataCount; i++) {
+	for (int i = 1, count = polygonRows.count(); i < count; i++) {
 		if (i < poly.count()) {
-			double value = dataModel->index(i, vDataColumn).data().toDouble();
+			int row = polygonRows[i];
+			double value = dataModel->value(row, vDataColumn);
 			struct gasmix *gasmix = NULL;
 			struct event *ev = NULL;
-			int sec = dataModel->index(i, DivePlotDataModel::TIME).data().toInt();
+			int sec = lrint(dataModel->value(row, DivePlotDataModel::TIME));
 			gasmix = get_gasmix(&displayed_dive, displayed_dc, sec, &ev, gasmix);
 			int inert = 1000 - get_o2(gasmix);
 			mypen.setBrush(QBrush(ColorScale(value, inert)));
@@ -456,15 +536,17 @@ void DiveAmbPressureItem::modelDataChanged(const QModelIndex &topLeft, const QMo
 
 	// Ignore empty values. a heart rate of 0 would be a bad sign.
 	QPolygonF poly;
+	QVector<double> horizontalValues = dataModel->columnData(hDataColumn);
+	QVector<double> verticalValues = dataModel->columnData(vDataColumn);
 	for (int i = 0, modelDataCount = dataModel->rowCount(); i < modelDataCount; i++) {
-		int hr = dataModel->index(i, vDataColumn).data().toInt();
+		int hr = lrint(verticalValues[i]);
 		if (!hr)
 			continue;
-		sec = dataModel->index(i, hDataColumn).data().toInt();
+		sec = lrint(horizontalValues[i]);
 		QPointF point(hAxis->posAtValue(sec), vAxis->posAtValue(hr));
 		poly.append(point);
 	}
-	setPolygon(poly);
+	setPolygon(decimate(poly));
 
 	if (texts.count())
 		texts.last()->setAlignment(Qt::AlignLeft | Qt::AlignBottom);
@@ -504,15 +586,17 @@ void DiveGFLineItem::modelDataChanged(const QModelIndex &topLeft, const QModelIn
 
 	// Ignore empty values. a heart rate of 0 would be a bad sign.
 	QPolygonF poly;
+	QVector<double> horizontalValues = dataModel->columnData(hDataColumn);
+	QVector<double> verticalValues = dataModel->columnData(vDataColumn);
 	for (int i = 0, modelDataCount = dataModel->rowCount(); i < modelDataCount; i++) {
-		int hr = dataModel->index(i, vDataColumn).data().toInt();
+		int hr = lrint(verticalValues[i]);
 		if (!hr)
 			continue;
-		sec = dataModel->index(i, hDataColumn).data().toInt();
+		sec = lrint(horizontalValues[i]);
 		QPointF point(hAxis->posAtValue(sec), vAxis->posAtValue(hr));
 		poly.append(point);
 	}
-	setPolygon(poly);
+	setPolygon(decimate(poly));
 
 	if (texts.count())
 		texts.last()->setAlignment(Qt::AlignLeft | Qt::AlignBottom);
@@ -552,12 +636,14 @@ void DiveTemperatureItem::modelDataChanged(const QModelIndex &topLeft, const QMo
 	texts.clear();
 	// Ignore empty values. things do not look good with '0' as temperature in kelvin...
 	QPolygonF poly;
+	QVector<double> horizontalValues = dataModel->columnData(hDataColumn);
+	QVector<double> verticalValues = dataModel->columnData(vDataColumn);
 	for (int i = 0, modelDataCount = dataModel->rowCount(); i < modelDataCount; i++) {
-		int mkelvin = dataModel->index(i, vDataColumn).data().toInt();
+		int mkelvin = lrint(verticalValues[i]);
 		if (!mkelvin)
 			continue;
 		last_valid_temp = mkelvin;
-		sec = dataModel->index(i, hDataColumn).data().toInt();
+		sec = lrint(horizontalValues[i]);
 		QPointF point(hAxis->posAtValue(sec), vAxis->posAtValue(mkelvin));
 		poly.append(point);
 
@@ -574,7 +660,7 @@ void DiveTemperatureItem::modelDataChanged(const QModelIndex &topLeft, const QMo
 			createTextItem(sec, mkelvin);
 		last_printed_temp = mkelvin;
 	}
-	setPolygon(poly);
+	setPolygon(decimate(poly));
 
 	/* it would be nice to print the end temperature, if it's
 	* different or if the last temperature print has been more
@@ -644,7 +730,7 @@ void DiveMeanDepthItem::modelDataChanged(const QModelIndex &topLeft, const QMode
 		poly.append(point);
 	}
 	lastRunningSum = meandepthvalue;
-	setPolygon(poly);
+	setPolygon(decimate(poly));
 	createTextItem();
 }
 
@@ -693,7 +779,7 @@ void DiveGasPressureItem::modelDataChanged(const QModelIndex &topLeft, const QMo
 		struct plot_data *entry = dataModel->data().entry + i;
 
 		for (int cyl = 0; cyl < MAX_CYLINDERS; cyl++) {
-			int mbar = GET_PRESSURE(entry, cyl);
+			int mbar = get_plot_pressure(&dataModel->data(), i, cyl);
 			int time = entry->sec;
 
 			if (!mbar)
@@ -753,7 +839,7 @@ void DiveGasPressureItem::modelDataChanged(const QModelIndex &topLeft, const QMo
 		struct plot_data *entry = dataModel->data().entry + i;
 
 		for (int cyl = 0; cyl < MAX_CYLINDERS; cyl++) {
-			int mbar = GET_PRESSURE(entry, cyl);
+			int mbar = get_plot_pressure(&dataModel->data(), i, cyl);
 
 			if (!mbar)
 				continue;
@@ -981,9 +1067,11 @@ void PartialPressureGasItem::modelDataChanged(const QModelIndex &topLeft, const
 	if (thresholdPtrMin)
 		threshold_min = *thresholdPtrMin;
 	bool inAlertFragment = false;
+	QVector<double> horizontalValues = dataModel->columnData(hDataColumn);
+	QVector<double> verticalValues = dataModel->columnData(vDataColumn);
 	for (int i = 0; i < dataModel->rowCount(); i++, entry++) {
-		double value = dataModel->index(i, vDataColumn).data().toDouble();
-		int time = dataModel->index(i, hDataColumn).data().toInt();
+		double value = verticalValues[i];
+		int time = lrint(horizontalValues[i]);
 		QPointF point(hAxis->posAtValue(time), vAxis->posAtValue(value));
 		poly.push_back(point);
 		if (thresholdPtrMax && value >= threshold_max) {
@@ -1008,7 +1096,9 @@ void PartialPressureGasItem::modelDataChanged(const QModelIndex &topLeft, const
 			inAlertFragment = false;
 		}
 	}
-	setPolygon(poly);
+	setPolygon(decimate(poly));
+	for (int i = 0; i < alertPolygons.count(); i++)
+		alertPolygons[i] = decimate(alertPolygons[i]);
 	/*
 	createPPLegend(trUtf8("pN" UTF8_SUBSCRIPT_2),getColor(PN2), legendPos);
 	*/
@@ -62,11 +62,20 @@ protected:
 	 */
 	bool shouldCalculateStuff(const QModelIndex &topLeft, const QModelIndex &bottomRight);
 
+	/* Long dives have many more plot entries than the profile has pixels. This keeps the
+	 * first, last, lowest and highest point of every pixel column of the polygon, and
+	 * the points at events. If 'rows' is given, it holds a value per point that is
+	 * reduced in the same way. Nothing is dropped when printing.
+	 */
+	QPolygonF decimate(const QPolygonF &poly, QVector<int> *rows = NULL);
+	qreal pixelWidth();
+
 	DiveCartesianAxis *hAxis;
 	DiveCartesianAxis *vAxis;
 	DivePlotDataModel *dataModel;
 	int hDataColumn;
 	int vDataColumn;
+	QVector<int> polygonRows; // the model row of each point of the polygon
 	QList<DiveTextItem *> texts;
 };
 
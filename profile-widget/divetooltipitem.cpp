@@ -160,7 +160,12 @@ ToolTipItem::ToolTipItem(QGraphicsItem *parent) : QGraphicsRectItem(parent),
 	title->setBrush(Qt::white);
 
 	setPen(QPen(Qt::white, 2));
-	refreshTime.start();
+
+	// mouse moves are collected and shown once per frame
+	refreshTimer.setSingleShot(true);
+	refreshTimer.setInterval(16);
+	connect(&refreshTimer, &QTimer::timeout, this, &ToolTipItem::refreshNow);
+	entryTextUnits = prefs.units;
 }
 
 ToolTipItem::~ToolTipItem()
@@ -228,6 +233,8 @@ void ToolTipItem::readPos()
 void ToolTipItem::setPlotInfo(const plot_info &plot)
 {
 	pInfo = plot;
+	entryTexts.clear();
+	lastTime = -1;
 }
 
 void ToolTipItem::setTimeAxis(DiveCartesianAxis *axis)
@@ -235,16 +242,26 @@ void ToolTipItem::setTimeAxis(DiveCartesianAxis *axis)
 	timeAxis = axis;
 }
 
+static bool same_units(const struct units &a, const struct units &b)
+{
+	return a.length == b.length && a.volume == b.volume && a.pressure == b.pressure &&
+	       a.temperature == b.temperature && a.vertical_speed_time == b.vertical_speed_time;
+}
+
 void ToolTipItem::refresh(const QPointF &pos)
 {
-	struct plot_data *entry;
+	refreshPos = pos;
+	if (!refreshTimer.isActive())
+		refreshTimer.start();
+}
+
+void ToolTipItem::refreshNow()
+{
+	struct plot_data *entry = NULL;
 	static QPixmap tissues(16,60);
 	static QPainter painter(&tissues);
 	static struct membuffer mb = {};
-
-	if(refreshTime.elapsed() < 40)
-		return;
-	refreshTime.start();
+	const QPointF &pos = refreshPos;
 
 	int time = lrint(timeAxis->valueAt(pos));
 	if (time == lastTime)
@@ -253,8 +270,19 @@ void ToolTipItem::refresh(const QPointF &pos)
 	lastTime = time;
 	clear();
 
-	mb.len = 0;
-	entry = get_plot_details_new(&pInfo, time, &mb);
+	if (!same_units(entryTextUnits, prefs.units)) {
+		entryTexts.clear();
+		entryTextUnits = prefs.units;
+	}
+	int idx = get_plot_entry_index(&pInfo, time);
+	if (idx >= 0) {
+		entry = pInfo.entry + idx;
+		if (!entryTexts.contains(idx)) {
+			mb.len = 0;
+			get_plot_entry_details(&pInfo, idx, &mb);
+			entryTexts.insert(idx, QString::fromUtf8(mb.buffer, mb.len));
+		}
+	}
 
 	tissues.fill();
 	painter.setPen(QColor(0, 0, 0, 0));
@@ -275,9 +303,9 @@ void ToolTipItem::refresh(const QPointF &pos)
 				16, lrint(60 - AMB_PERCENTAGE * (entry->pressures.n2 + entry->pressures.he) / entry->ambpressure /2));
 		painter.setPen(QColor(0, 0, 0, 127));
 		for (int i=0; i<16; i++) {
-			painter.drawLine(i, 60, i, 60 - entry->percentages[i] / 2);
+			painter.drawLine(i, 60, i, 60 - get_plot_percentage(&pInfo, idx, i) / 2);
 		}
-		entryToolTip.second->setText(QString::fromUtf8(mb.buffer, mb.len));
+		entryToolTip.second->setText(entryTexts.value(idx));
 	}
 	entryToolTip.first->setPixmap(tissues);
 
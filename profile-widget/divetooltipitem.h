@@ -7,8 +7,10 @@
 #include <QPair>
 #include <QRectF>
 #include <QIcon>
-#include <QTime>
+#include <QHash>
+#include <QTimer>
 #include "core/display.h"
+#include "core/units.h"
 
 class DiveCartesianAxis;
 class QGraphicsLineItem;
@@ -48,6 +50,9 @@ public:
 public
 slots:
 	void setRect(const QRectF &rect);
+private
+slots:
+	void refreshNow();
 
 private:
 	typedef QPair<QGraphicsPixmapItem *, QGraphicsSimpleTextItem *> ToolTip;
@@ -60,7 +65,10 @@ private:
 	DiveCartesianAxis *timeAxis;
 	plot_info pInfo;
 	int lastTime;
-	QTime refreshTime;
+	QTimer refreshTimer;
+	QPointF refreshPos;
+	QHash<int, QString> entryTexts;	// the details of the entries shown so far
+	struct units entryTextUnits;
 	QList<QGraphicsItem*> oldSelection;
 };
 
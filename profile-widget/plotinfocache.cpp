@@ -0,0 +1,160 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "profile-widget/plotinfocache.h"
+#include "core/pref.h"
+#include <string.h>
+
+static bool sameParams(const struct deco_parameters &a, const struct deco_parameters &b)
+{
+	return a.gf_low == b.gf_low && a.gf_high == b.gf_high && a.vpmb_conservatism == b.vpmb_conservatism &&
+	       a.planner == b.planner && a.deco_mode == b.deco_mode;
+}
+
+static bool sameSettings(const struct profile_deco_settings &a, const struct profile_deco_settings &b)
+{
+	return a.calcalltissues == b.calcalltissues && a.calcceiling3m == b.calcceiling3m &&
+	       a.calcndltts == b.calcndltts && a.calcndltts_iterative == b.calcndltts_iterative &&
+	       a.planner_deco_time == b.planner_deco_time &&
+	       a.planner_first_ceiling_pressure.mbar == b.planner_first_ceiling_pressure.mbar;
+}
+
+// the tissues are compared bitwise, which at worst misses a hit for 0.0 and -0.0
+bool PlotInfoKey::operator==(const PlotInfoKey &other) const
+{
+	return diveId == other.diveId && dcNr == other.dcNr && changes == other.changes &&
+	       fast == other.fast && content == other.content &&
+	       sameParams(params, other.params) && sameSettings(settings, other.settings) &&
+	       bottomsac == other.bottomsac && decosac == other.decosac &&
+	       o2consumption == other.o2consumption && pscr_ratio == other.pscr_ratio &&
+	       defaultsetpoint == other.defaultsetpoint && modpO2 == other.modpO2 &&
+	       !memcmp(tissue_n2_sat, other.tissue_n2_sat, sizeof(tissue_n2_sat)) &&
+	       !memcmp(tissue_he_sat, other.tissue_he_sat, sizeof(tissue_he_sat)) &&
+	       !memcmp(max_n2_crushing_pressure, other.max_n2_crushing_pressure, sizeof(max_n2_crushing_pressure)) &&
+	       !memcmp(max_he_crushing_pressure, other.max_he_crushing_pressure, sizeof(max_he_crushing_pressure)) &&
+	       gf_low_pressure_this_dive == other.gf_low_pressure_this_dive;
+}
+
+// Keys that only differ in the settings or the tissues land in the same bucket,
+// operator==() tells them apart.
+uint qHash(const PlotInfoKey &key, uint seed)
+{
+	return qHash(key.diveId, seed) ^ qHash(key.content, seed) ^ qHash(key.changes * 31 + key.dcNr, seed);
+}
+
+// only for values without padding, which might differ for the same value
+template <typename T>
+static void hashValue(uint &hash, const T &value)
+{
+	hash = qHashBits(&value, sizeof(value), hash);
+}
+
+static uint contentHash(struct dive *dive, struct divecomputer *dc)
+{
+	uint hash = 0;
+
+	hashValue(hash, dive->when);
+	hashValue(hash, dive->duration.seconds);
+	hashValue(hash, dive->maxdepth.mm);
+	hashValue(hash, dive->dc.meandepth.mm);
+	hashValue(hash, dive->surface_pressure.mbar);
+	hashValue(hash, dive->salinity);
+	hashValue(hash, dive->mintemp.mkelvin);
+	hashValue(hash, dive->maxtemp.mkelvin);
+	for (int i = 0; i < MAX_CYLINDERS; i++) {
+		const cylinder_t *cyl = dive->cylinder + i;
+		hashValue(hash, cyl->type.size.mliter);
+		hashValue(hash, cyl->type.workingpressure.mbar);
+		hashValue(hash, cyl->gasmix);
+		hashValue(hash, cyl->start.mbar);
+		hashValue(hash, cyl->end.mbar);
+		hashValue(hash, cyl->sample_start.mbar);
+		hashValue(hash, cyl->sample_end.mbar);
+		hashValue(hash, cyl->depth.mm);
+		hashValue(hash, cyl->cylinder_use);
+	}
+
+	hashValue(hash, dc->when);
+	hashValue(hash, dc->duration.seconds);
+	hashValue(hash, dc->maxdepth.mm);
+	hashValue(hash, dc->surface_pressure.mbar);
+	hashValue(hash, dc->divemode);
+	hashValue(hash, dc->no_o2sensors);
+	hashValue(hash, dc->salinity);
+	// The samples are hashed as a whole. Padding that differs only costs a cache hit.
+	if (dc->samples)
+		hash = qHashBits(dc->sample, dc->samples * sizeof(struct sample), hash);
+	for (const struct event *ev = dc->events; ev; ev = ev->next) {
+		hashValue(hash, ev->time.seconds);
+		hashValue(hash, ev->type);
+		hashValue(hash, ev->flags);
+		hashValue(hash, ev->value);
+		hashValue(hash, ev->gas.index);
+		hashValue(hash, ev->gas.mix);
+		hashValue(hash, ev->deleted);
+		hash = qHashBits(ev->name, strlen(ev->name), hash);
+	}
+	return hash;
+}
+
+PlotInfoCache::Entry::~Entry()
+{
+	free_plot_info_data(&pi);
+}
+
+PlotInfoCache::PlotInfoCache()
+{
+	// the cost of an entry is in kB
+	cache.setMaxCost(prefs.profile_cache_size * 1024);
+}
+
+// ds has the parameters and the tissues after the previous dives, see init_decompression()
+PlotInfoKey PlotInfoCache::key(struct dive *dive, struct divecomputer *dc, const struct deco_state *ds,
+			       const struct profile_deco_settings *settings, bool fast)
+{
+	PlotInfoKey key;
+
+	key.diveId = dive->id;
+	key.dcNr = dc_number;
+	key.changes = dive->changes;
+	key.fast = fast;
+	key.content = contentHash(dive, dc);
+	key.params = ds->params;
+	key.settings = *settings;
+	// the gas calculations still take these from the preferences
+	key.bottomsac = prefs.bottomsac;
+	key.decosac = prefs.decosac;
+	key.o2consumption = prefs.o2consumption;
+	key.pscr_ratio = prefs.pscr_ratio;
+	key.defaultsetpoint = prefs.defaultsetpoint;
+	key.modpO2 = prefs.modpO2;
+	memcpy(key.tissue_n2_sat, ds->tissue_n2_sat, sizeof(key.tissue_n2_sat));
+	memcpy(key.tissue_he_sat, ds->tissue_he_sat, sizeof(key.tissue_he_sat));
+	memcpy(key.max_n2_crushing_pressure, ds->max_n2_crushing_pressure, sizeof(key.max_n2_crushing_pressure));
+	memcpy(key.max_he_crushing_pressure, ds->max_he_crushing_pressure, sizeof(key.max_he_crushing_pressure));
+	key.gf_low_pressure_this_dive = ds->gf_low_pressure_this_dive;
+	return key;
+}
+
+bool PlotInfoCache::find(const PlotInfoKey &key, struct plot_info *pi)
+{
+	Entry *entry = cache.object(key);
+
+	if (!entry)
+		return false;
+	copy_plot_info_data(pi, &entry->pi);
+	return true;
+}
+
+void PlotInfoCache::insert(const PlotInfoKey &key, const struct plot_info &pi)
+{
+	Entry *entry = new Entry;
+	int size = pi.nr * (sizeof(struct plot_data) + pi.nr_cylinders * sizeof(struct plot_pressure_data));
+
+	if (pi.ceilings)
+		size += pi.nr * 16 * sizeof(int);
+	if (pi.percentages)
+		size += pi.nr * 16 * sizeof(int);
+	copy_plot_info_data(&entry->pi, &pi);
+	// the budget may have changed in the preferences since the last time
+	cache.setMaxCost(prefs.profile_cache_size * 1024);
+	cache.insert(key, entry, size / 1024 + 1);
+}
@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef PLOTINFOCACHE_H
+#define PLOTINFOCACHE_H
+
+#include <QCache>
+#include "core/dive.h"
+#include "core/display.h"
+#include "core/profile.h"
+
+// What the plot info of a dive computer was calculated from: the dive, the deco
+// parameters and settings, the preferences of the gas calculations and the tissues
+// after the previous dives. The content hash is only an additional guard against
+// edits of the displayed dive that don't bump its change counter.
+struct PlotInfoKey {
+	int diveId;
+	unsigned int dcNr;
+	unsigned int changes;
+	bool fast;
+	uint content;
+	struct deco_parameters params;
+	struct profile_deco_settings settings;
+	int bottomsac;
+	int decosac;
+	int o2consumption;
+	int pscr_ratio;
+	int defaultsetpoint;
+	double modpO2;
+	double tissue_n2_sat[16];
+	double tissue_he_sat[16];
+	double max_n2_crushing_pressure[16];
+	double max_he_crushing_pressure[16];
+	double gf_low_pressure_this_dive;
+
+	bool operator==(const PlotInfoKey &other) const;
+};
+
+uint qHash(const PlotInfoKey &key, uint seed = 0);
+
+// The plot info of the dives shown last, so that going back to one of them
+// doesn't calculate the deco again. The least recently used ones are dropped
+// when they take more than prefs.profile_cache_size MB.
+class PlotInfoCache {
+public:
+	PlotInfoCache();
+	static PlotInfoKey key(struct dive *dive, struct divecomputer *dc, const struct deco_state *ds,
+			       const struct profile_deco_settings *settings, bool fast);
+	// Both make a copy of the plot data, the caller keeps what it passes in or gets out
+	bool find(const PlotInfoKey &key, struct plot_info *pi);
+	void insert(const PlotInfoKey &key, const struct plot_info &pi);
+
+private:
+	struct Entry {
+		struct plot_info pi;
+		~Entry();
+	};
+	QCache<PlotInfoKey, Entry> cache;
+};
+
+#endif // PLOTINFOCACHE_H
@@ -31,6 +31,7 @@
 #include <QDebug>
 #include <QWheelEvent>
 #include <QSettings>
+#include <QtConcurrent>
 #include <QMenu>
 
 #ifndef QT_NO_DEBUG
@@ -132,6 +133,10 @@ ProfileWidget2::ProfileWidget2(QWidget *parent) : QGraphicsView(parent),
 	isPlotZoomed = prefs.zoomed_plot; // now it seems that 'prefs' has loaded our preferences
 
 	memset(&plotInfo, 0, sizeof(plotInfo));
+#ifndef SUBSURFACE_MOBILE
+	// one profile at a time, the queued ones are skipped once they are stale
+	decoThreadPool.setMaxThreadCount(1);
+#endif
 
 	setupSceneAndFlags();
 	setupItemSizes();
@@ -156,6 +161,14 @@ ProfileWidget2::ProfileWidget2(QWidget *parent) : QGraphicsView(parent),
 #endif
 }
 
+ProfileWidget2::~ProfileWidget2()
+{
+#ifndef SUBSURFACE_MOBILE
+	decoThreadPool.waitForDone();
+#endif
+	free_plot_info_data(&plotInfo);
+}
+
 #ifndef SUBSURFACE_MOBILE
 void ProfileWidget2::addActionShortcut(const Qt::Key shortcut, void (ProfileWidget2::*slot)())
 {
@@ -495,6 +508,7 @@ void ProfileWidget2::setupItem(AbstractProfilePolygonItem *item, DiveCartesianAx
 	item->setVerticalDataColumn(vData);
 	item->setHorizontalDataColumn(hData);
 	item->setZValue(zValue);
+	connect(this, SIGNAL(zoomChanged()), item, SLOT(modelDataChanged()));
 }
 
 void ProfileWidget2::setupSceneAndFlags()
@@ -518,6 +532,7 @@ void ProfileWidget2::resetZoom()
 	const qreal defScale = 1.0 / qPow(zoomFactor, (qreal)zoomLevel);
 	scale(defScale, defScale);
 	zoomLevel = 0;
+	emit zoomChanged();
 }
 
 // Currently just one dive, but the plan is to enable All of the selected dives.
@@ -607,11 +622,33 @@ void ProfileWidget2::plotDive(struct dive *d, bool force)
 	 * shown.
 	 */
 
-	plotInfo = calculate_max_limits_new(&displayed_dive, currentdc);
+	// the items still show the old data until they get the new one
+	struct plot_info oldPlotInfo = plotInfo;
+	struct plot_info limits = calculate_max_limits_new(&displayed_dive, currentdc);
+	plotInfo = limits;
 #ifndef SUBSURFACE_MOBILE
-	create_plot_info_new(&displayed_dive, currentdc, &plotInfo, !shouldCalculateMaxDepth, &DivePlannerPointsModel::instance()->final_deco_state);
+	int generation = ++plotGeneration;
+	struct deco_state *planner_ds = &DivePlannerPointsModel::instance()->final_deco_state;
+	struct deco_state plot_deco_state;
+	struct profile_deco_settings settings;
+	init_profile_deco_parameters(&plot_deco_state, planner_ds);
+	init_decompression(&plot_deco_state, &displayed_dive);
+	init_profile_deco_settings(&settings, &plot_deco_state, planner_ds);
+
+	// The deco information of a logged dive is calculated in the background,
+	// until then the profile is shown without it. The planner needs it right away.
+	// Logged dives that have been shown before with the same settings come from the cache.
+	bool logged = currentState == PROFILE && !printMode && currentdc->samples;
+	PlotInfoKey key = {};
+	if (logged)
+		key = PlotInfoCache::key(&displayed_dive, currentdc, &plot_deco_state, &settings, !shouldCalculateMaxDepth);
+	if (!logged || !plotInfoCache.find(key, &plotInfo)) {
+		calculate_plot_info(&displayed_dive, currentdc, &plotInfo, !shouldCalculateMaxDepth, logged ? NULL : &plot_deco_state, &settings);
+		if (logged)
+			calculateDecoInBackground(generation, key, limits, plot_deco_state, settings);
+	}
 #else
-	create_plot_info_new(&displayed_dive, currentdc, &plotInfo, !shouldCalculateMaxDepth, nullptr);
+	calculate_plot_info(&displayed_dive, currentdc, &plotInfo, !shouldCalculateMaxDepth, NULL, NULL);
 #endif
 	int newMaxtime = get_maxtime(&plotInfo);
 	if (shouldCalculateMaxTime || newMaxtime > maxtime)
@@ -691,6 +728,7 @@ void ProfileWidget2::plotDive(struct dive *d, bool force)
 #ifndef SUBSURFACE_MOBILE
 	rulerItem->setPlotInfo(plotInfo);
 #endif
+	free_plot_info_data(&oldPlotInfo);
 
 #ifdef SUBSURFACE_MOBILE
 	if (currentdc->divemode == CCR) {
@@ -718,7 +756,7 @@ void ProfileWidget2::plotDive(struct dive *d, bool force)
 		ccrsensor3GasItem->setVisible(false);
 	}
 #endif
-	tankItem->setData(dataModel, &plotInfo, &displayed_dive);
+	tankItem->setData(dataModel, &displayed_dive);
 
 	dataModel->emitDataChanged();
 	// The event items are a bit special since we don't know how many events are going to
@@ -794,6 +832,55 @@ void ProfileWidget2::plotDive(struct dive *d, bool force)
 #endif
 }
 
+#ifndef SUBSURFACE_MOBILE
+// Takes a copy of displayed_dive, which may change while the deco is calculated.
+// The deco state and settings were taken on this thread, the worker doesn't look
+// at the application state or the preferences, which may change in the meantime.
+// The result is cached, but not shown if another dive has been plotted in the meantime.
+void ProfileWidget2::calculateDecoInBackground(int generation, const PlotInfoKey &key, const struct plot_info &limits, const struct deco_state &ds,
+					       const struct profile_deco_settings &settings)
+{
+	struct dive *dive = alloc_dive();
+	copy_dive(&displayed_dive, dive);
+	struct divecomputer *dc = select_dc(dive);
+	bool fast = !shouldCalculateMaxDepth;
+
+	QFutureWatcher<struct plot_info> *watcher = new QFutureWatcher<struct plot_info>(this);
+	connect(watcher, &QFutureWatcher<struct plot_info>::finished, this, [this, watcher, generation, key]() {
+		struct plot_info pi = watcher->result();
+		watcher->deleteLater();
+		if (pi.entry)
+			plotInfoCache.insert(key, pi);
+		if (generation == plotGeneration.load() && pi.entry)
+			setDecoPlotInfo(pi);
+		else
+			free_plot_info_data(&pi);
+	});
+	watcher->setFuture(QtConcurrent::run(&decoThreadPool, [this, generation, dive, dc, limits, ds, settings, fast]() {
+		struct plot_info pi = limits;
+		struct deco_state plot_deco_state = ds;
+
+		// don't bother with the dives the user has already moved on from
+		if (generation == plotGeneration.load())
+			calculate_plot_info(dive, dc, &pi, fast, &plot_deco_state, &settings);
+		clear_dive(dive);
+		free(dive);
+		return pi;
+	}));
+}
+
+void ProfileWidget2::setDecoPlotInfo(const struct plot_info &pi)
+{
+	struct plot_info oldPlotInfo = plotInfo;
+	plotInfo = pi;
+	dataModel->setDive(&displayed_dive, plotInfo);
+	toolTipItem->setPlotInfo(plotInfo);
+	rulerItem->setPlotInfo(plotInfo);
+	free_plot_info_data(&oldPlotInfo);
+	dataModel->emitDataChanged();
+}
+#endif
+
 void ProfileWidget2::recalcCeiling()
 {
 #ifndef SUBSURFACE_MOBILE
@@ -893,6 +980,7 @@ void ProfileWidget2::resizeEvent(QResizeEvent *event)
 	QGraphicsView::resizeEvent(event);
 	fitInView(sceneRect(), Qt::IgnoreAspectRatio);
 	fixBackgroundPos();
+	emit zoomChanged();
 }
 
 #ifndef SUBSURFACE_MOBILE
@@ -956,10 +1044,12 @@ void ProfileWidget2::wheelEvent(QWheelEvent *event)
 	if (event->delta() > 0 && zoomLevel < 20) {
 		scale(zoomFactor, zoomFactor);
 		zoomLevel++;
+		emit zoomChanged();
 	} else if (event->delta() < 0 && zoomLevel > 0) {
 		// Zooming out
 		scale(1.0 / zoomFactor, 1.0 / zoomFactor);
 		zoomLevel--;
+		emit zoomChanged();
 	}
 	scrollViewTo(event->pos());
 	toolTipItem->setPos(mapToScene(toolTipPos));
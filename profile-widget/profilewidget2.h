@@ -3,6 +3,8 @@
 #define PROFILEWIDGET2_H
 
 #include <QGraphicsView>
+#include <QAtomicInt>
+#include <QThreadPool>
 #include <vector>
 #include <memory>
 
@@ -18,12 +20,15 @@
 //  */
 #include "profile-widget/divelineitem.h"
 #include "profile-widget/diveprofileitem.h"
+#include "profile-widget/plotinfocache.h"
 #include "core/display.h"
+#include "core/profile.h"
 #include "core/color.h"
 
 class RulerItem2;
 struct dive;
 struct plot_info;
+struct deco_state;
 class ToolTipItem;
 class DiveReportedCeiling;
 class DiveTextItem;
@@ -72,6 +77,7 @@ public:
 	};
 
 	ProfileWidget2(QWidget *parent = 0);
+	~ProfileWidget2();
 	void resetZoom();
 	void plotDive(struct dive *d = 0, bool force = false);
 	void setupItem(AbstractProfilePolygonItem *item, DiveCartesianAxis *vAxis, int vData, int hData, int zValue);
@@ -98,6 +104,7 @@ signals:
 	void updateDiveInfo(bool clear);
 	void editCurrentDive();
 	void dateTimeChangedItems();
+	void zoomChanged(); // zoomed or resized, so the graphs are drawn with a different resolution
 
 public
 slots: // Necessary to call from QAction's signals.
@@ -168,6 +175,11 @@ private: /*methods*/
 	void createPPGas(PartialPressureGasItem *item, int verticalColumn, color_index_t color, color_index_t colorAlert,
 			 double *thresholdSettingsMin, double *thresholdSettingsMax);
 	void clearPictures();
+#ifndef SUBSURFACE_MOBILE
+	void calculateDecoInBackground(int generation, const PlotInfoKey &key, const struct plot_info &limits, const struct deco_state &ds,
+				       const struct profile_deco_settings &settings);
+	void setDecoPlotInfo(const struct plot_info &pi);
+#endif
 private:
 	DivePlotDataModel *dataModel;
 	int zoomLevel;
@@ -183,6 +195,11 @@ private:
 	// So it's esyer to replicate for more dives later.
 	// In the meantime, keep it here.
 	struct plot_info plotInfo;
+#ifndef SUBSURFACE_MOBILE
+	QAtomicInt plotGeneration; // bumped for every plotted dive, to drop the stale deco calculations
+	QThreadPool decoThreadPool;
+	PlotInfoCache plotInfoCache;
+#endif
 	DepthAxis *profileYAxis;
 	PartialGasPressureAxis *gasYAxis;
 	TemperatureAxis *temperatureAxis;
@@ -12,7 +12,7 @@
 #include "core/profile.h"
 
 RulerNodeItem2::RulerNodeItem2() :
-	entry(NULL),
+	idx(-1),
 	ruler(NULL),
 	timeAxis(NULL),
 	depthAxis(NULL)
@@ -29,7 +29,7 @@ RulerNodeItem2::RulerNodeItem2() :
 void RulerNodeItem2::setPlotInfo(plot_info &info)
 {
 	pInfo = info;
-	entry = pInfo.entry;
+	idx = 0;
 }
 
 void RulerNodeItem2::setRuler(RulerItem2 *r)
@@ -53,7 +53,7 @@ void RulerNodeItem2::recalculate()
 			count++;
 		}
 		setPos(timeAxis->posAtValue(data->sec), depthAxis->posAtValue(data->depth));
-		entry = data;
+		idx = data - pInfo.entry;
 	}
 }
 
@@ -117,7 +117,7 @@ void RulerItem2::recalculate()
 	}
 	QLineF line(startPoint, endPoint);
 	setLine(line);
-	compare_samples(source->entry, dest->entry, buffer, 500, 1);
+	compare_samples(&pInfo, source->idx, dest->idx, buffer, 500, 1);
 	text = QString(buffer);
 
 	// draw text
@@ -8,9 +8,7 @@
 TankItem::TankItem(QObject *parent) :
 	QObject(parent),
 	QGraphicsRectItem(),
-	dataModel(0),
-	pInfoEntry(0),
-	pInfoNr(0)
+	dataModel(0)
 {
 	height = 3;
 	QColor red(PERSIANRED1);
@@ -42,15 +40,10 @@ TankItem::~TankItem()
 		free((void *)diveCylinderStore.cylinder[i].type.description);
 }
 
-void TankItem::setData(DivePlotDataModel *model, struct plot_info *plotInfo, struct dive *d)
+void TankItem::setData(DivePlotDataModel *model, struct dive *d)
 {
-	free(pInfoEntry);
-	// the plotInfo and dive structures passed in could become invalid before we stop using them,
-	// so copy the data that we need
-	int size = plotInfo->nr * sizeof(plotInfo->entry[0]);
-	pInfoEntry = (struct plot_data *)malloc(size);
-	pInfoNr = plotInfo->nr;
-	memcpy(pInfoEntry, plotInfo->entry, size);
+	// the dive passed in could become invalid before we stop using it,
+	// so copy the data that we need. The model keeps its own plot data.
 	copy_cylinders(d, &diveCylinderStore, false);
 	dataModel = model;
 	connect(dataModel, SIGNAL(dataChanged(QModelIndex, QModelIndex)), this, SLOT(modelDataChanged(QModelIndex, QModelIndex)), Qt::UniqueConnection);
@@ -87,7 +80,7 @@ void TankItem::modelDataChanged(const QModelIndex &topLeft, const QModelIndex &b
 	Q_UNUSED(topLeft);
 	Q_UNUSED(bottomRight);
 	// We don't have enougth data to calculate things, quit.
-	if (!dataModel || !pInfoEntry || !pInfoNr)
+	if (!dataModel || !dataModel->rowCount())
 		return;
 
 	// remove the old rectangles
@@ -99,7 +92,7 @@ void TankItem::modelDataChanged(const QModelIndex &topLeft, const QModelIndex &b
 	qreal width, left;
 
 	// Find correct end of the dive plot for correct end of the tankbar
-	struct plot_data *last_entry = &pInfoEntry[pInfoNr-1];
+	int endTime = lrint(dataModel->value(dataModel->rowCount() - 1, DivePlotDataModel::TIME));
 
 	// get the information directly from the displayed_dive (the dc always exists)
 	struct divecomputer *dc = get_dive_dc(&displayed_dive, dc_number);
@@ -111,7 +104,7 @@ void TankItem::modelDataChanged(const QModelIndex &topLeft, const QModelIndex &b
 
 	// work through all the gas changes and add the rectangle for each gas while it was used
 	struct event *ev = get_next_event(dc->events, "gaschange");
-	while (ev && (int)ev->time.seconds < last_entry->sec) {
+	while (ev && (int)ev->time.seconds < endTime) {
 		width = hAxis->posAtValue(ev->time.seconds) - hAxis->posAtValue(startTime);
 		left = hAxis->posAtValue(startTime);
 		createBar(left, width, gasmix);
@@ -119,7 +112,7 @@ void TankItem::modelDataChanged(const QModelIndex &topLeft, const QModelIndex &b
 		gasmix = get_gasmix_from_event(&displayed_dive, ev);
 		ev = get_next_event(ev->next, "gaschange");
 	}
-	width = hAxis->posAtValue(last_entry->sec) - hAxis->posAtValue(startTime);
+	width = hAxis->posAtValue(endTime) - hAxis->posAtValue(startTime);
 	left = hAxis->posAtValue(startTime);
 	createBar(left, width, gasmix);
 }
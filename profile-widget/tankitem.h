@@ -17,7 +17,7 @@ public:
 	explicit TankItem(QObject *parent = 0);
 	~TankItem();
 	void setHorizontalAxis(DiveCartesianAxis *horizontal);
-	void setData(DivePlotDataModel *model, struct plot_info *plotInfo, struct dive *d);
+	void setData(DivePlotDataModel *model, struct dive *d);
 
 signals:
 
@@ -29,8 +29,6 @@ private:
 	DivePlotDataModel *dataModel;
 	DiveCartesianAxis *hAxis;
 	struct dive diveCylinderStore;
-	struct plot_data *pInfoEntry;
-	int pInfoNr;
 	qreal height;
 	QBrush air, nitrox, oxygen, trimix;
 	QList<QGraphicsRectItem *> rects;
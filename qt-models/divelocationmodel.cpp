@@ -150,6 +150,8 @@ bool LocationInformationModel::setData(const QModelIndex &index, const QVariant
 	struct dive_site *ds = get_dive_site(index.row());
 	free(ds->name);
 	ds->name = copy_qstring(value.toString());
+	invalidate_dive_site_dives(ds->uuid);
+	invalidate_dive_value_index();
 	emit dataChanged(index, index);
 	return true;
 }
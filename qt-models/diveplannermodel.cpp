@@ -11,6 +11,7 @@
 #include <QApplication>
 #include <QTextDocument>
 #include <QtConcurrent>
+#include <algorithm>
 
 #define VARIATIONS_IN_BACKGROUND 1
 
@@ -202,12 +203,6 @@ void DivePlannerPointsModel::addCylinder_clicked()
 void DivePlannerPointsModel::setPlanMode(Mode m)
 {
 	mode = m;
-	// the planner may reset our GF settings that are used to show deco
-	// reset them to what's in the preferences
-	if (m != PLAN) {
-		set_gf(prefs.gflow, prefs.gfhigh);
-		set_vpmb_conservatism(prefs.vpmb_conservatism);
-	}
 }
 
 bool DivePlannerPointsModel::isPlanner()
@@ -393,6 +388,8 @@ DivePlannerPointsModel::DivePlannerPointsModel(QObject *parent) : QAbstractTable
 	recalc(false)
 {
 	memset(&diveplan, 0, sizeof(diveplan));
+	diveplan.cache = alloc_plan_cache();
+	init_deco_parameters(&final_deco_state);
 	startTime.setTimeSpec(Qt::UTC);
 }
 
@@ -895,15 +892,20 @@ void DivePlannerPointsModel::createTemporaryPlan()
 		struct deco_state plan_deco_state;
 		struct diveplan *plan_copy;
 
+		init_deco_parameters(&plan_deco_state);
 		plan(&plan_deco_state, &diveplan, &displayed_dive, DECOTIMESTEP, stoptable, &cache, isPlanner(), false);
 		plan_copy = (struct diveplan *)malloc(sizeof(struct diveplan));
 		lock_planner();
 		cloneDiveplan(&diveplan, plan_copy);
 		unlock_planner();
+		struct dive *dive = alloc_dive();
+		copy_dive(&displayed_dive, dive);
+		// The variations start from the tissues after the previous dives, which the plan cached
+		struct deco_state previous_ds = cache ? *cache : plan_deco_state;
 #ifdef VARIATIONS_IN_BACKGROUND
-		QtConcurrent::run(this, &DivePlannerPointsModel::computeVariations, plan_copy, &plan_deco_state);
+		QtConcurrent::run(this, &DivePlannerPointsModel::computeVariations, plan_copy, dive, previous_ds);
 #else
-		computeVariations(plan_copy, &plan_deco_state);
+		computeVariations(plan_copy, dive, previous_ds);
 #endif
 		final_deco_state = plan_deco_state;
 		emit calculatedPlanNotes();
@@ -938,6 +940,8 @@ struct divedatapoint * DivePlannerPointsModel::cloneDiveplan(struct diveplan *pl
 
 	src = plan_src->dp;
 	*plan_copy = *plan_src;
+	// the cache belongs to the interactive plan
+	plan_copy->cache = NULL;
 	dp = &plan_copy->dp;
 	while (src && (!src->time || src->entered)) {
 		*dp = (struct divedatapoint *)malloc(sizeof(struct divedatapoint));
@@ -986,25 +990,23 @@ int DivePlannerPointsModel::analyzeVariations(struct decostop *min, struct decos
 	return (leftsum + rightsum) / 2;
 }
 
-void DivePlannerPointsModel::computeVariations(struct diveplan *original_plan, struct deco_state *previos_ds)
-{
-
-//	bool oldRecalc = setRecalc(false);
-	struct dive *dive = alloc_dive();
-	copy_dive(&displayed_dive, dive);
-	struct decostop original[60], deeper[60], shallower[60], shorter[60], longer[60];
-	struct deco_state *cache = NULL, *save = NULL;
-	struct diveplan plan_copy;
-	struct divedatapoint *last_segment;
-	struct deco_state ds = *previos_ds;
-
-	if (!original_plan)
-		return;
-
+namespace {
+	// The plan with the last manually entered segment deeper, shallower, longer or shorter
+	struct PlanVariation {
+		int deltaDepth;
+		int deltaTime;
+		bool computed;
+		struct dive dive;
+		struct decostop stoptable[60];
+	};
+}
 
-	if (in_planner() && prefs.display_variations && decoMode() != RECREATIONAL) {
+// Takes ownership of original_plan and dive
+void DivePlannerPointsModel::computeVariations(struct diveplan *original_plan, struct dive *dive, struct deco_state previous_ds)
+{
+	// This might run in the background, the deco state tells whether the plan was made in the planner
+	if (original_plan && previous_ds.params.planner && prefs.display_variations && previous_ds.params.deco_mode != RECREATIONAL) {
 		int my_instance = ++instanceCounter;
-		cache_deco_state(&ds, &save);
 
 		duration_t delta_time = { .seconds = 60 };
 		QString time_units = tr("min");
@@ -1019,66 +1021,58 @@ void DivePlannerPointsModel::computeVariations(struct diveplan *original_plan, s
 			depth_units = tr("ft");
 		}
 
-		last_segment = cloneDiveplan(original_plan, &plan_copy);
-		if (!last_segment)
-			goto finish;
-		if (my_instance != instanceCounter)
-			goto finish;
-		plan(&ds, &plan_copy, dive, 1, original, &cache, true, false);
-		free_dps(&plan_copy);
-		restore_deco_state(save, &ds, false);
-
-		last_segment = cloneDiveplan(original_plan, &plan_copy);
-		last_segment->depth.mm += delta_depth.mm;
-		last_segment->next->depth.mm += delta_depth.mm;
-		if (my_instance != instanceCounter)
-			goto finish;
-		plan(&ds, &plan_copy, dive, 1, deeper, &cache, true, false);
-		free_dps(&plan_copy);
-		restore_deco_state(save, &ds, false);
-
-		last_segment = cloneDiveplan(original_plan, &plan_copy);
-		last_segment->depth.mm -= delta_depth.mm;
-		last_segment->next->depth.mm -= delta_depth.mm;
-		if (my_instance != instanceCounter)
-			goto finish;
-		plan(&ds, &plan_copy, dive, 1, shallower, &cache, true, false);
-		free_dps(&plan_copy);
-		restore_deco_state(save, &ds, false);
-
-		last_segment = cloneDiveplan(original_plan, &plan_copy);
-		last_segment->next->time += delta_time.seconds;
-		if (my_instance != instanceCounter)
-			goto finish;
-		plan(&ds, &plan_copy, dive, 1, longer, &cache, true, false);
-		free_dps(&plan_copy);
-		restore_deco_state(save, &ds, false);
-
-		last_segment = cloneDiveplan(original_plan, &plan_copy);
-		last_segment->next->time -= delta_time.seconds;
-		if (my_instance != instanceCounter)
-			goto finish;
-		plan(&ds, &plan_copy, dive, 1, shorter, &cache, true, false);
-		free_dps(&plan_copy);
-		restore_deco_state(save, &ds, false);
-
-		char buf[200];
-		sprintf(buf, ", %s: + %d:%02d /%s + %d:%02d /min", qPrintable(tr("Stop times")),
-			FRACTION(analyzeVariations(shallower, original, deeper, qPrintable(depth_units)), 60), qPrintable(depth_units),
-			FRACTION(analyzeVariations(shorter, original, longer, qPrintable(time_units)), 60));
-
-		emit variationsComputed(QString(buf));
+		// original, deeper, shallower, longer and shorter
+		QVector<PlanVariation> variations(5);
+		variations[1].deltaDepth = delta_depth.mm;
+		variations[2].deltaDepth = -delta_depth.mm;
+		variations[3].deltaTime = delta_time.seconds;
+		variations[4].deltaTime = -delta_time.seconds;
+		for (PlanVariation &variation: variations)
+			copy_dive(dive, &variation.dive);
+
+		// Each plan gets its own dive and deco state, so they can be calculated at the same time
+		QtConcurrent::blockingMap(variations, [this, original_plan, &previous_ds, my_instance](PlanVariation &variation) {
+			struct diveplan plan_copy;
+			struct divedatapoint *last_segment = cloneDiveplan(original_plan, &plan_copy);
+			struct deco_state ds = previous_ds;
+			struct deco_state *cache = NULL;
+
+			if (last_segment && my_instance == instanceCounter.load()) {
+				if (variation.deltaDepth) {
+					last_segment->depth.mm += variation.deltaDepth;
+					last_segment->next->depth.mm += variation.deltaDepth;
+				}
+				if (variation.deltaTime)
+					last_segment->next->time += variation.deltaTime;
+				cache_deco_state(&ds, &cache);
+				plan(&ds, &plan_copy, &variation.dive, 1, variation.stoptable, &cache, true, false);
+				variation.computed = true;
+			}
+			free_dps(&plan_copy);
+			free(cache);
+		});
+
+		bool computed = std::all_of(variations.begin(), variations.end(), [](const PlanVariation &variation) { return variation.computed; });
+		if (computed && my_instance == instanceCounter.load()) {
+			char buf[200];
+			sprintf(buf, ", %s: + %d:%02d /%s + %d:%02d /min", qPrintable(tr("Stop times")),
+				FRACTION(analyzeVariations(variations[2].stoptable, variations[0].stoptable, variations[1].stoptable, qPrintable(depth_units)), 60), qPrintable(depth_units),
+				FRACTION(analyzeVariations(variations[4].stoptable, variations[0].stoptable, variations[3].stoptable, qPrintable(time_units)), 60));
+
+			emit variationsComputed(QString(buf));
 #ifdef DEBUG_STOPVAR
-		printf("\n\n");
+			printf("\n\n");
 #endif
+		}
+		for (PlanVariation &variation: variations)
+			clear_dive(&variation.dive);
 	}
-finish:
-	free_dps(original_plan);
-	free(original_plan);
-	free(save);
-	free(cache);
+	if (original_plan) {
+		free_dps(original_plan);
+		free(original_plan);
+	}
+	clear_dive(dive);
 	free(dive);
-//	setRecalc(oldRecalc);
 }
 
 void DivePlannerPointsModel::createPlan(bool replanCopy)
@@ -1092,13 +1086,16 @@ void DivePlannerPointsModel::createPlan(bool replanCopy)
 
 	//TODO: C-based function here?
 	struct decostop stoptable[60];
+	init_deco_parameters(&ds_after_previous_dives);
 	plan(&ds_after_previous_dives, &diveplan, &displayed_dive, DECOTIMESTEP, stoptable, &cache, isPlanner(), true);
 	struct diveplan *plan_copy;
 	plan_copy = (struct diveplan *)malloc(sizeof(struct diveplan));
 	lock_planner();
 	cloneDiveplan(&diveplan, plan_copy);
 	unlock_planner();
-	computeVariations(plan_copy, &ds_after_previous_dives);
+	struct dive *dive = alloc_dive();
+	copy_dive(&displayed_dive, dive);
+	computeVariations(plan_copy, dive, cache ? *cache : ds_after_previous_dives);
 
 	free(cache);
 	if (!current_dive || displayed_dive.id != current_dive->id) {
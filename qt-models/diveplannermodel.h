@@ -3,6 +3,7 @@
 #define DIVEPLANNERMODEL_H
 
 #include <QAbstractTableModel>
+#include <QAtomicInt>
 #include <QDateTime>
 
 #include "core/dive.h"
@@ -114,13 +115,13 @@ private:
 	void createPlan(bool replanCopy);
 	struct diveplan diveplan;
 	struct divedatapoint *cloneDiveplan(struct diveplan *plan_src, struct diveplan *plan_copy);
-	void computeVariations(struct diveplan *diveplan, struct deco_state *ds);
+	void computeVariations(struct diveplan *diveplan, struct dive *dive, struct deco_state previous_ds);
 	int analyzeVariations(struct decostop *min, struct decostop *mid, struct decostop *max, const char *unit);
 	Mode mode;
 	bool recalc;
 	QVector<divedatapoint> divepoints;
 	QDateTime startTime;
-	int instanceCounter = 0;
+	QAtomicInt instanceCounter;
 	struct deco_state ds_after_previous_dives;
 };
 
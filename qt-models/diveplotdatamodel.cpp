@@ -6,6 +6,8 @@
 #include "core/divelist.h"
 #include "core/color.h"
 
+#include <algorithm>
+
 DivePlotDataModel::DivePlotDataModel(QObject *parent) :
 	QAbstractTableModel(parent),
 	diveId(0),
@@ -26,7 +28,8 @@ QVariant DivePlotDataModel::data(const QModelIndex &index, int role) const
 	if ((!index.isValid()) || (index.row() >= pInfo.nr) || pInfo.entry == 0)
 		return QVariant();
 
-	plot_data item = pInfo.entry[index.row()];
+	int row = index.row();
+	plot_data item = pInfo.entry[row];
 	if (role == Qt::DisplayRole) {
 		switch (index.column()) {
 		case DEPTH:
@@ -34,7 +37,7 @@ QVariant DivePlotDataModel::data(const QModelIndex &index, int role) const
 		case TIME:
 			return item.sec;
 		case PRESSURE:
-			return item.pressure[0][0];
+			return get_plot_sensor_pressure(&pInfo, row, 0);
 		case TEMPERATURE:
 			return item.temperature;
 		case COLOR:
@@ -42,9 +45,9 @@ QVariant DivePlotDataModel::data(const QModelIndex &index, int role) const
 		case USERENTERED:
 			return false;
 		case SENSOR_PRESSURE:
-			return item.pressure[0][0];
+			return get_plot_sensor_pressure(&pInfo, row, 0);
 		case INTERPOLATED_PRESSURE:
-			return item.pressure[0][1];
+			return get_plot_interpolated_pressure(&pInfo, row, 0);
 		case CEILING:
 			return item.ceiling;
 		case SAC:
@@ -75,11 +78,11 @@ QVariant DivePlotDataModel::data(const QModelIndex &index, int role) const
 	}
 
 	if (role == Qt::DisplayRole && index.column() >= TISSUE_1 && index.column() <= TISSUE_16) {
-		return item.ceilings[index.column() - TISSUE_1];
+		return get_plot_ceiling(&pInfo, row, index.column() - TISSUE_1);
 	}
 
 	if (role == Qt::DisplayRole && index.column() >= PERCENTAGE_1 && index.column() <= PERCENTAGE_16) {
-		return item.percentages[index.column() - PERCENTAGE_1];
+		return get_plot_percentage(&pInfo, row, index.column() - PERCENTAGE_1);
 	}
 
 	if (role == Qt::BackgroundRole) {
@@ -91,6 +94,82 @@ QVariant DivePlotDataModel::data(const QModelIndex &index, int role) const
 	return QVariant();
 }
 
+double DivePlotDataModel::value(int row, int column) const
+{
+	const plot_data &item = pInfo.entry[row];
+
+	switch (column) {
+	case DEPTH:
+		return item.depth;
+	case TIME:
+		return item.sec;
+	case PRESSURE:
+		return get_plot_sensor_pressure(&pInfo, row, 0);
+	case TEMPERATURE:
+		return item.temperature;
+	case COLOR:
+		return item.velocity;
+	case SENSOR_PRESSURE:
+		return get_plot_sensor_pressure(&pInfo, row, 0);
+	case INTERPOLATED_PRESSURE:
+		return get_plot_interpolated_pressure(&pInfo, row, 0);
+	case CEILING:
+		return item.ceiling;
+	case SAC:
+		return item.sac;
+	case PN2:
+		return item.pressures.n2;
+	case PHE:
+		return item.pressures.he;
+	case PO2:
+		return item.pressures.o2;
+	case O2SETPOINT:
+		return item.o2setpoint.mbar / 1000.0;
+	case CCRSENSOR1:
+		return item.o2sensor[0].mbar / 1000.0;
+	case CCRSENSOR2:
+		return item.o2sensor[1].mbar / 1000.0;
+	case CCRSENSOR3:
+		return item.o2sensor[2].mbar / 1000.0;
+	case HEARTBEAT:
+		return item.heartbeat;
+	case AMBPRESSURE:
+		return AMB_PERCENTAGE;
+	case GFLINE:
+		return item.gfline;
+	case INSTANT_MEANDEPTH:
+		return item.running_sum;
+	}
+
+	if (column >= TISSUE_1 && column <= TISSUE_16)
+		return get_plot_ceiling(&pInfo, row, column - TISSUE_1);
+
+	if (column >= PERCENTAGE_1 && column <= PERCENTAGE_16)
+		return get_plot_percentage(&pInfo, row, column - PERCENTAGE_1);
+
+	return 0.0;
+}
+
+QVector<double> DivePlotDataModel::columnData(int column) const
+{
+	QVector<double> values(pInfo.nr);
+
+	for (int i = 0; i < pInfo.nr; i++)
+		values[i] = value(i, column);
+	return values;
+}
+
+int DivePlotDataModel::rowAtTime(int seconds) const
+{
+	const plot_data *end = pInfo.entry + pInfo.nr;
+	const plot_data *entry = std::lower_bound(pInfo.entry, end, seconds,
+						  [](const plot_data &a, int sec) { return a.sec < sec; });
+
+	if (entry == end || entry->sec != seconds)
+		return -1;
+	return entry - pInfo.entry;
+}
+
 const plot_info &DivePlotDataModel::data() const
 {
 	return pInfo;
@@ -168,8 +247,7 @@ void DivePlotDataModel::clear()
 	if (rowCount() != 0) {
 		beginRemoveRows(QModelIndex(), 0, rowCount() - 1);
 		pInfo.nr = 0;
-		free(pInfo.entry);
-		pInfo.entry = 0;
+		free_plot_info_data(&pInfo);
 		diveId = -1;
 		dcNr = -1;
 		endRemoveRows();
@@ -182,10 +260,8 @@ void DivePlotDataModel::setDive(dive *d, const plot_info &info)
 	Q_ASSERT(d != NULL);
 	diveId = d->id;
 	dcNr = dc_number;
-	free(pInfo.entry);
-	pInfo = info;
-	pInfo.entry = (struct plot_data *)malloc(sizeof(struct plot_data) * pInfo.nr);
-	memcpy(pInfo.entry, info.entry, sizeof(plot_data) * pInfo.nr);
+	free_plot_info_data(&pInfo);
+	copy_plot_info_data(&pInfo, &info);
 	beginInsertRows(QModelIndex(), 0, pInfo.nr - 1);
 	endInsertRows();
 }
@@ -219,8 +295,12 @@ void DivePlotDataModel::emitDataChanged()
 void DivePlotDataModel::calculateDecompression()
 {
 	struct divecomputer *dc = select_dc(&displayed_dive);
+	struct deco_state *planner_ds = &DivePlannerPointsModel::instance()->final_deco_state;
+	struct profile_deco_settings settings;
+	init_profile_deco_parameters(&plot_deco_state, planner_ds);
 	init_decompression(&plot_deco_state, &displayed_dive);
-	calculate_deco_information(&plot_deco_state, &(DivePlannerPointsModel::instance()->final_deco_state), &displayed_dive, dc, &pInfo, false);
+	init_profile_deco_settings(&settings, &plot_deco_state, planner_ds);
+	calculate_deco_information(&plot_deco_state, &settings, &displayed_dive, dc, &pInfo, false);
 	dataChanged(index(0, CEILING), index(pInfo.nr - 1, TISSUE_16));
 }
 #endif
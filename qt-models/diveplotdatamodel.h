@@ -3,6 +3,7 @@
 #define DIVEPLOTDATAMODEL_H
 
 #include <QAbstractTableModel>
+#include <QVector>
 
 #include "core/display.h"
 #include "core/dive.h"
@@ -78,6 +79,11 @@ public:
 	void clear();
 	void setDive(struct dive *d, const plot_info &pInfo);
 	const plot_info &data() const;
+	// typed access for the profile items, without a QVariant per value;
+	// data() keeps its types for everything else
+	double value(int row, int column) const;
+	QVector<double> columnData(int column) const;
+	int rowAtTime(int seconds) const; // the first row at exactly that time, or -1
 	unsigned int dcShown() const;
 	double pheMax();
 	double pn2Max();
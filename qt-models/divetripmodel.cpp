@@ -7,6 +7,7 @@
 #include "core/dive.h"
 #include <QIcon>
 #include <QDebug>
+#include <QSet>
 
 static int nitrox_sort_value(struct dive *dive)
 {
@@ -83,6 +84,104 @@ QVariant TripItem::data(int column, int role) const
 }
 
 
+// Many dives share their suit, cylinder, tags or location. Sorting compares the
+// same shared string data for those, which QString short-circuits.
+// The strings are dropped when the model is set up again or loses all its dives.
+static QSet<QString> internedStrings;
+
+static QString internString(const QString &s)
+{
+	QSet<QString>::const_iterator it = internedStrings.constFind(s);
+	if (it != internedStrings.constEnd())
+		return *it;
+	internedStrings.insert(s);
+	return s;
+}
+
+// Every edit of what the row shows goes through invalidate_dive_cache(),
+// also for the dive site, see invalidate_dive_site_dives()
+bool DiveItem::needsUpdate(struct dive *dive) const
+{
+	return dive->changes != changes;
+}
+
+void DiveItem::updated(struct dive *dive)
+{
+	changes = dive->changes;
+	// not all edits bump the dive list generation
+	sortKeys.clear();
+}
+
+// The sort keys are computed the first time a column is sorted and kept
+// until the dive list changes, so re-sorting only compares cached values.
+QVariant DiveItem::sortKey(struct dive *dive, int column) const
+{
+	if (column < 0 || column >= COLUMNS)
+		return QVariant();
+	unsigned int generation = get_dive_list_generation();
+	if (sortKeys.isEmpty() || sortKeysGeneration != generation) {
+		sortKeys = QVector<QVariant>(COLUMNS);
+		sortKeysGeneration = generation;
+	}
+	QVariant &retVal = sortKeys[column];
+	if (retVal.isValid())
+		return retVal;
+	switch (column) {
+	case NR:
+		retVal = (qlonglong)dive->when;
+		break;
+	case DATE:
+		retVal = (qlonglong)dive->when;
+		break;
+	case RATING:
+		retVal = dive->rating;
+		break;
+	case DEPTH:
+		retVal = dive->maxdepth.mm;
+		break;
+	case DURATION:
+		retVal = dive->duration.seconds;
+		break;
+	case TEMPERATURE:
+		retVal = dive->watertemp.mkelvin;
+		break;
+	case TOTALWEIGHT:
+		retVal = total_weight(dive);
+		break;
+	case SUIT:
+		retVal = internString(QString(dive->suit));
+		break;
+	case CYLINDER:
+		retVal = internString(QString(dive->cylinder[0].type.description));
+		break;
+	case GAS:
+		retVal = nitrox_sort_value(dive);
+		break;
+	case SAC:
+		retVal = dive->sac;
+		break;
+	case OTU:
+		retVal = dive->otu;
+		break;
+	case MAXCNS:
+		retVal = dive->maxcns;
+		break;
+	case TAGS:
+		retVal = internString(displayTags());
+		break;
+	case PHOTOS:
+		retVal = countPhotos(dive);
+		break;
+	case COUNTRY:
+		retVal = internString(QString(get_dive_country(dive)));
+		break;
+	case LOCATION:
+		retVal = internString(QString(get_dive_location(dive)));
+		break;
+	}
+	return retVal;
+}
+
 QVariant DiveItem::data(int column, int role) const
 {
 	QVariant retVal;
@@ -97,59 +196,7 @@ QVariant DiveItem::data(int column, int role) const
 		break;
 	case DiveTripModel::SORT_ROLE:
 		Q_ASSERT(dive != NULL);
-		switch (column) {
-		case NR:
-			retVal = (qlonglong)dive->when;
-			break;
-		case DATE:
-			retVal = (qlonglong)dive->when;
-			break;
-		case RATING:
-			retVal = dive->rating;
-			break;
-		case DEPTH:
-			retVal = dive->maxdepth.mm;
-			break;
-		case DURATION:
-			retVal = dive->duration.seconds;
-			break;
-		case TEMPERATURE:
-			retVal = dive->watertemp.mkelvin;
-			break;
-		case TOTALWEIGHT:
-			retVal = total_weight(dive);
-			break;
-		case SUIT:
-			retVal = QString(dive->suit);
-			break;
-		case CYLINDER:
-			retVal = QString(dive->cylinder[0].type.description);
-			break;
-		case GAS:
-			retVal = nitrox_sort_value(dive);
-			break;
-		case SAC:
-			retVal = dive->sac;
-			break;
-		case OTU:
-			retVal = dive->otu;
-			break;
-		case MAXCNS:
-			retVal = dive->maxcns;
-			break;
-		case TAGS:
-			retVal = displayTags();
-			break;
-		case PHOTOS:
-			retVal = countPhotos(dive);
-			break;
-		case COUNTRY:
-			retVal = QString(get_dive_country(dive));
-			break;
-		case LOCATION:
-			retVal = QString(get_dive_location(dive));
-			break;
-		}
+		retVal = sortKey(dive, column);
 		break;
 	case Qt::DisplayRole:
 		Q_ASSERT(dive != NULL);
@@ -595,17 +642,20 @@ void DiveTripModel::setupModelData()
 		beginRemoveRows(QModelIndex(), 0, rowCount() - 1);
 		endRemoveRows();
 	}
+	// the sort keys of the old rows keep their own copies
+	internedStrings.clear();
 
 	if (autogroup)
 		autogroup_dives();
 	dive_table.preexisting = dive_table.nr;
 	while (--i >= 0) {
 		struct dive *dive = get_dive(i);
-		update_cylinder_related_info(dive);
+		cache_cylinder_related_info(dive);
 		dive_trip_t *trip = dive->divetrip;
 
 		DiveItem *diveItem = new DiveItem();
 		diveItem->diveId = dive->id;
+		diveItem->updated(dive);
 
 		if (!trip || currentLayout == LIST) {
 			diveItem->parent = rootItem;
@@ -615,16 +665,14 @@ void DiveTripModel::setupModelData()
 		if (currentLayout == LIST)
 			continue;
 
-		if (!trips.keys().contains(trip)) {
-			TripItem *tripItem = new TripItem();
+		TripItem *&tripItem = trips[trip];
+		if (!tripItem) {
+			tripItem = new TripItem();
 			tripItem->trip = trip;
 			tripItem->parent = rootItem;
-			tripItem->children.push_back(diveItem);
-			trips[trip] = tripItem;
 			rootItem->children.push_back(tripItem);
-			continue;
 		}
-		TripItem *tripItem = trips[trip];
+		diveItem->parent = tripItem;
 		tripItem->children.push_back(diveItem);
 	}
 
@@ -634,6 +682,154 @@ void DiveTripModel::setupModelData()
 	}
 }
 
+// Remove the children of parentItem that are marked as stale, in as few runs as possible
+void DiveTripModel::removeStaleRows(TreeItem *parentItem, const QModelIndex &parentIndex, const QVector<bool> &stale)
+{
+	int last = stale.count() - 1;
+	while (last >= 0) {
+		if (!stale[last]) {
+			last--;
+			continue;
+		}
+		int first = last;
+		while (first > 0 && stale[first - 1])
+			first--;
+		beginRemoveRows(parentIndex, first, last);
+		for (int row = last; row >= first; row--)
+			delete parentItem->children.takeAt(row);
+		endRemoveRows();
+		last = first - 1;
+	}
+}
+
+// Bring the model in line with the dive table without rebuilding it. The rows of
+// dives and trips that are gone are removed and the new ones appended - the sort
+// proxy puts them in place. Of the remaining rows only those of dives that were
+// changed since they were added (see invalidate_dive_cache()) are updated.
+void DiveTripModel::updateModelData()
+{
+	int i;
+	struct dive *dive;
+	QHash<int, dive_trip_t *> wantedTrip;
+	QSet<int> shown;
+
+	if (autogroup)
+		autogroup_dives();
+	dive_table.preexisting = dive_table.nr;
+	for_each_dive (i, dive)
+		wantedTrip.insert(dive->id, currentLayout == LIST ? NULL : dive->divetrip);
+
+	// Drop the rows of dives that were deleted or moved to a different trip,
+	// and the trips without any of their dives left
+	trips.clear();
+	QVector<bool> stale(rootItem->children.count());
+	for (int row = 0; row < rootItem->children.count(); row++) {
+		TreeItem *item = rootItem->children[row];
+		TripItem *tripItem = dynamic_cast<TripItem *>(item);
+		if (!tripItem) {
+			DiveItem *diveItem = static_cast<DiveItem *>(item);
+			QHash<int, dive_trip_t *>::const_iterator it = wantedTrip.constFind(diveItem->diveId);
+			stale[row] = it == wantedTrip.constEnd() || it.value() != NULL;
+			if (!stale[row])
+				shown.insert(diveItem->diveId);
+			continue;
+		}
+		QVector<bool> staleChildren(tripItem->children.count());
+		bool keepTrip = false;
+		for (int j = 0; j < tripItem->children.count(); j++) {
+			DiveItem *diveItem = static_cast<DiveItem *>(tripItem->children[j]);
+			QHash<int, dive_trip_t *>::const_iterator it = wantedTrip.constFind(diveItem->diveId);
+			staleChildren[j] = it == wantedTrip.constEnd() || it.value() != tripItem->trip;
+			if (!staleChildren[j]) {
+				shown.insert(diveItem->diveId);
+				keepTrip = true;
+			}
+		}
+		if (!keepTrip) {
+			stale[row] = true;
+			continue;
+		}
+		trips[tripItem->trip] = tripItem;
+		removeStaleRows(tripItem, createIndex(row, 0, tripItem), staleChildren);
+	}
+	removeStaleRows(rootItem, QModelIndex(), stale);
+	// none of the dives are left, e.g. the dive table was cleared
+	if (shown.isEmpty())
+		internedStrings.clear();
+
+	// Add the dives that are not shown yet, in the same order as setupModelData()
+	QList<TreeItem *> newTopLevel;
+	QSet<TripItem *> newTrips;
+	QHash<TripItem *, QList<TreeItem *> > newChildren;
+	i = dive_table.nr;
+	while (--i >= 0) {
+		dive = get_dive(i);
+		cache_cylinder_related_info(dive);
+		if (shown.contains(dive->id))
+			continue;
+		dive_trip_t *trip = wantedTrip.value(dive->id);
+
+		DiveItem *diveItem = new DiveItem();
+		diveItem->diveId = dive->id;
+		diveItem->updated(dive);
+
+		if (!trip) {
+			diveItem->parent = rootItem;
+			newTopLevel.push_back(diveItem);
+			continue;
+		}
+		TripItem *&tripItem = trips[trip];
+		if (!tripItem) {
+			tripItem = new TripItem();
+			tripItem->trip = trip;
+			tripItem->parent = rootItem;
+			newTopLevel.push_back(tripItem);
+			newTrips.insert(tripItem);
+		}
+		diveItem->parent = tripItem;
+		if (newTrips.contains(tripItem))
+			tripItem->children.push_back(diveItem);
+		else
+			newChildren[tripItem].push_back(diveItem);
+	}
+	for (QHash<TripItem *, QList<TreeItem *> >::iterator it = newChildren.begin(); it != newChildren.end(); ++it) {
+		TripItem *tripItem = it.key();
+		int first = tripItem->children.count();
+		beginInsertRows(createIndex(tripItem->row(), 0, tripItem), first, first + it.value().count() - 1);
+		tripItem->children.append(it.value());
+		endInsertRows();
+	}
+	if (!newTopLevel.isEmpty()) {
+		int first = rootItem->children.count();
+		beginInsertRows(QModelIndex(), first, first + newTopLevel.count() - 1);
+		rootItem->children.append(newTopLevel);
+		endInsertRows();
+	}
+
+	// Only the dives that were edited need to be redrawn and re-sorted. The trips are
+	// few and their summary depends on their dives, so they are always updated.
+	for (int row = 0; row < rootItem->children.count(); row++) {
+		TreeItem *item = rootItem->children[row];
+		TripItem *tripItem = dynamic_cast<TripItem *>(item);
+		if (tripItem) {
+			emit dataChanged(createIndex(row, 0, item), createIndex(row, COLUMNS - 1, item));
+			for (int j = 0; j < tripItem->children.count(); j++)
+				updateDiveRow(static_cast<DiveItem *>(tripItem->children[j]), j);
+		} else {
+			updateDiveRow(static_cast<DiveItem *>(item), row);
+		}
+	}
+}
+
+void DiveTripModel::updateDiveRow(DiveItem *diveItem, int row)
+{
+	struct dive *dive = get_dive_by_uniq_id(diveItem->diveId);
+	if (!dive || !diveItem->needsUpdate(dive))
+		return;
+	diveItem->updated(dive);
+	emit dataChanged(createIndex(row, 0, diveItem), createIndex(row, COLUMNS - 1, diveItem));
+}
+
 DiveTripModel::Layout DiveTripModel::layout() const
 {
 	return currentLayout;
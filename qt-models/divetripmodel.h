@@ -5,6 +5,9 @@
 #include "treemodel.h"
 #include "core/dive.h"
 #include <string>
+#include <QHash>
+#include <QVector>
+#include <QVariant>
 
 struct DiveItem : public TreeItem {
 	Q_DECLARE_TR_FUNCTIONS(TripItem)
@@ -32,6 +35,9 @@ public:
 
 	virtual QVariant data(int column, int role) const;
 	int diveId;
+	// Whether the dive was edited since this row was last updated
+	bool needsUpdate(struct dive *dive) const;
+	void updated(struct dive *dive);
 	virtual bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole);
 	virtual Qt::ItemFlags flags(const QModelIndex &index) const;
 	QString displayDate() const;
@@ -47,7 +53,14 @@ public:
 	QString displayTags() const;
 	int countPhotos(dive *dive) const;
 	int weight() const;
+	QVariant sortKey(struct dive *dive, int column) const;
 	QString icon_names[4];
+
+private:
+	// SORT_ROLE values, filled per column on first use and dropped when the dive list changes
+	mutable QVector<QVariant> sortKeys;
+	mutable unsigned int sortKeysGeneration;
+	unsigned int changes; // dive->changes when this row was last updated
 };
 
 struct TripItem : public TreeItem {
@@ -100,12 +113,15 @@ public:
 	DiveTripModel(QObject *parent = 0);
 	Layout layout() const;
 	void setLayout(Layout layout);
+	void updateModelData();
 	int columnWidth(int column);
 	void setColumnWidth(int column, int width);
 
 private:
 	void setupModelData();
-	QMap<dive_trip_t *, TripItem *> trips;
+	void removeStaleRows(TreeItem *parentItem, const QModelIndex &parentIndex, const QVector<bool> &stale);
+	void updateDiveRow(DiveItem *diveItem, int row);
+	QHash<dive_trip_t *, TripItem *> trips;
 	QVector<int> columnWidthMap;
 	Layout currentLayout;
 };
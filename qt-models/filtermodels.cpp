@@ -25,10 +25,15 @@ CREATE_INSTANCE_METHOD(LocationFilterModel)
 CREATE_INSTANCE_METHOD(SuitsFilterModel)
 CREATE_INSTANCE_METHOD(MultiFilterSortModel)
 
-FilterModelBase::FilterModelBase(QObject *parent) : QStringListModel(parent),
+FilterModelBase::FilterModelBase(enum dive_value_kind kindIn, QObject *parent) : QStringListModel(parent),
 	anyChecked(false),
-	negate(false)
+	negate(false),
+	bitmapDirty(true),
+	kind(kindIn)
 {
+	// Every change of the check states, the negate flag or the list itself ends in one of these
+	connect(this, &QAbstractItemModel::dataChanged, [this]() { bitmapDirty = true; });
+	connect(this, &QAbstractItemModel::modelReset, [this]() { bitmapDirty = true; });
 }
 
 // Update the stringList and the checkState array.
@@ -94,6 +99,36 @@ QVariant FilterModelBase::data(const QModelIndex &index, int role) const
 	return QVariant();
 }
 
+// Collect the dives with any of the checked values from the inverted index of the dive table.
+// The last item, the "Show Empty Tags" entry, stands for the dives without any value.
+void FilterModelBase::updateBitmap()
+{
+	bitmapDirty = false;
+	// If there's nothing checked, this should show everything
+	// rowCount() == 0 should never happen, because we have the "no tags" row
+	// let's handle it gracefully anyway.
+	if (!anyChecked || rowCount() == 0) {
+		bitmap.assign((dive_table.nr + 63) / 64, ~(uint64_t)0);
+		return;
+	}
+	bitmap.assign((dive_table.nr + 63) / 64, 0);
+	QStringList list = stringList();
+	for (int i = 0; i < rowCount(); i++) {
+		if (!checkState[i])
+			continue;
+		const int *dives;
+		QByteArray value = i == rowCount() - 1 ? QByteArray() : list[i].toUtf8();
+		int nr = get_dives_with_value(kind, value.constData(), &dives);
+		for (int j = 0; j < nr; j++)
+			bitmap[dives[j] / 64] |= (uint64_t)1 << (dives[j] % 64);
+	}
+	// Checked means 'Show', Unchecked means 'Hide'.
+	if (negate) {
+		for (uint64_t &word : bitmap)
+			word = ~word;
+	}
+}
+
 void FilterModelBase::clearFilter()
 {
 	std::fill(checkState.begin(), checkState.end(), false);
@@ -122,7 +157,7 @@ void FilterModelBase::setNegate(bool negateParam)
 	emit dataChanged(createIndex(0, 0), createIndex(rowCount() - 1, 0));
 }
 
-SuitsFilterModel::SuitsFilterModel(QObject *parent) : FilterModelBase(parent)
+SuitsFilterModel::SuitsFilterModel(QObject *parent) : FilterModelBase(DIVE_VALUE_SUIT, parent)
 {
 }
 
@@ -131,49 +166,18 @@ int SuitsFilterModel::countDives(const char *s) const
 	return count_dives_with_suit(s);
 }
 
-bool SuitsFilterModel::doFilter(dive *d, QModelIndex &index0, QAbstractItemModel *sourceModel) const
-{
-	Q_UNUSED(index0);
-	Q_UNUSED(sourceModel);
-
-	// rowCount() == 0 should never happen, because we have the "no suits" row
-	// let's handle it gracefully anyway.
-	if (!anyChecked || rowCount() == 0)
-		return true;
-
-	// Checked means 'Show', Unchecked means 'Hide'.
-	QString suit(d->suit);
-	// only show empty suit dives if the user checked that.
-	if (suit.isEmpty())
-		return checkState[rowCount() - 1] != negate;
-
-	// there is a suit selected
-	QStringList suitList = stringList();
-	// Ignore last item, since this is the "Show Empty Tags" entry
-	for (int i = 0; i < rowCount() - 1; i++) {
-		if (checkState[i] && suit == suitList[i])
-			return !negate;
-	}
-	return negate;
-}
-
 void SuitsFilterModel::repopulate()
 {
 	QStringList list;
-	struct dive *dive;
-	int i = 0;
-	for_each_dive (i, dive) {
-		QString suit(dive->suit);
-		if (!suit.isEmpty() && !list.contains(suit)) {
-			list.append(suit);
-		}
-	}
+	int nr = count_dive_values(DIVE_VALUE_SUIT);
+	for (int i = 0; i < nr; i++)
+		list.append(QString(get_dive_value(DIVE_VALUE_SUIT, i)));
 	qSort(list);
 	list << tr("No suit set");
 	updateList(list);
 }
 
-TagFilterModel::TagFilterModel(QObject *parent) : FilterModelBase(parent)
+TagFilterModel::TagFilterModel(QObject *parent) : FilterModelBase(DIVE_VALUE_TAG, parent)
 {
 }
 
@@ -187,50 +191,15 @@ void TagFilterModel::repopulate()
 	if (g_tag_list == NULL)
 		return;
 	QStringList list;
-	struct tag_entry *current_tag_entry = g_tag_list;
-	while (current_tag_entry != NULL) {
-		if (count_dives_with_tag(current_tag_entry->tag->name) > 0)
-			list.append(QString(current_tag_entry->tag->name));
-		current_tag_entry = current_tag_entry->next;
-	}
+	int nr = count_dive_values(DIVE_VALUE_TAG);
+	for (int i = 0; i < nr; i++)
+		list.append(QString(get_dive_value(DIVE_VALUE_TAG, i)));
 	qSort(list);
 	list << tr("Empty tags");
 	updateList(list);
 }
 
-bool TagFilterModel::doFilter(dive *d, QModelIndex &index0, QAbstractItemModel *sourceModel) const
-{
-	Q_UNUSED(index0);
-	Q_UNUSED(sourceModel);
-
-	// If there's nothing checked, this should show everything
-	// rowCount() == 0 should never happen, because we have the "no tags" row
-	// let's handle it gracefully anyway.
-	if (!anyChecked || rowCount() == 0)
-		return true;
-
-	// Checked means 'Show', Unchecked means 'Hide'.
-	struct tag_entry *head = d->tag_list;
-
-	if (!head) // last tag means "Show empty tags";
-		return checkState[rowCount() - 1] != negate;
-
-	// have at least one tag.
-	QStringList tagList = stringList();
-	if (!tagList.isEmpty()) {
-		tagList.removeLast(); // remove the "Show Empty Tags";
-		while (head) {
-			QString tagName(head->tag->name);
-			int index = tagList.indexOf(tagName);
-			if (index >= 0 && checkState[index])
-				return !negate;
-			head = head->next;
-		}
-	}
-	return negate;
-}
-
-BuddyFilterModel::BuddyFilterModel(QObject *parent) : FilterModelBase(parent)
+BuddyFilterModel::BuddyFilterModel(QObject *parent) : FilterModelBase(DIVE_VALUE_PERSON, parent)
 {
 }
 
@@ -239,56 +208,19 @@ int BuddyFilterModel::countDives(const char *s) const
 	return count_dives_with_person(s);
 }
 
-bool BuddyFilterModel::doFilter(dive *d, QModelIndex &index0, QAbstractItemModel *sourceModel) const
-{
-	Q_UNUSED(index0);
-	Q_UNUSED(sourceModel);
-
-	// If there's nothing checked, this should show everything
-	// rowCount() == 0 should never happen, because we have the "no tags" row
-	// let's handle it gracefully anyway.
-	if (!anyChecked || rowCount() == 0)
-		return true;
-
-	// Checked means 'Show', Unchecked means 'Hide'.
-	QString persons = QString(d->buddy) + "," + QString(d->divemaster);
-	QStringList personsList = persons.split(',', QString::SkipEmptyParts);
-	for (QString &s : personsList)
-		s = s.trimmed();
-	// only show empty buddie dives if the user checked that.
-	if (personsList.isEmpty())
-		return checkState[rowCount() - 1] != negate;
-
-	// have at least one buddy
-	QStringList buddyList = stringList();
-	// Ignore last item, since this is the "Show Empty Tags" entry
-	for (int i = 0; i < rowCount() - 1; i++) {
-		if (checkState[i] && personsList.contains(buddyList[i], Qt::CaseInsensitive))
-			return !negate;
-	}
-	return negate;
-}
-
 void BuddyFilterModel::repopulate()
 {
+	// People differing only in case are listed once, they are counted and filtered together anyway
 	QStringList list;
-	struct dive *dive;
-	int i = 0;
-	for_each_dive (i, dive) {
-		QString persons = QString(dive->buddy) + "," + QString(dive->divemaster);
-		Q_FOREACH (const QString &person, persons.split(',', QString::SkipEmptyParts)) {
-			// Remove any leading spaces
-			if (!list.contains(person.trimmed())) {
-				list.append(person.trimmed());
-			}
-		}
-	}
+	int nr = count_dive_values(DIVE_VALUE_PERSON);
+	for (int i = 0; i < nr; i++)
+		list.append(QString(get_dive_value(DIVE_VALUE_PERSON, i)));
 	qSort(list);
 	list << tr("No buddies");
 	updateList(list);
 }
 
-LocationFilterModel::LocationFilterModel(QObject *parent) : FilterModelBase(parent)
+LocationFilterModel::LocationFilterModel(QObject *parent) : FilterModelBase(DIVE_VALUE_LOCATION, parent)
 {
 }
 
@@ -297,43 +229,12 @@ int LocationFilterModel::countDives(const char *s) const
 	return count_dives_with_location(s);
 }
 
-bool LocationFilterModel::doFilter(struct dive *d, QModelIndex &index0, QAbstractItemModel *sourceModel) const
-{
-	Q_UNUSED(index0);
-	Q_UNUSED(sourceModel);
-
-	// rowCount() == 0 should never happen, because we have the "no location" row
-	// let's handle it gracefully anyway.
-	if (!anyChecked || rowCount() == 0)
-		return true;
-
-	// Checked means 'Show', Unchecked means 'Hide'.
-	QString location(get_dive_location(d));
-	// only show empty location dives if the user checked that.
-	if (location.isEmpty())
-		return checkState[rowCount() - 1] != negate;
-
-	// There is a location selected
-	QStringList locationList = stringList();
-	// Ignore last item, since this is the "Show Empty Tags" entry
-	for (int i = 0; i < rowCount() - 1; i++) {
-		if (checkState[i] && location == locationList[i])
-			return !negate;
-	}
-	return negate;
-}
-
 void LocationFilterModel::repopulate()
 {
 	QStringList list;
-	struct dive *dive;
-	int i = 0;
-	for_each_dive (i, dive) {
-		QString location(get_dive_location(dive));
-		if (!location.isEmpty() && !list.contains(location)) {
-			list.append(location);
-		}
-	}
+	int nr = count_dive_values(DIVE_VALUE_LOCATION);
+	for (int i = 0; i < nr; i++)
+		list.append(QString(get_dive_value(DIVE_VALUE_LOCATION, i)));
 	qSort(list);
 	list << tr("No location set");
 	updateList(list);
@@ -374,8 +275,36 @@ void LocationFilterModel::addName(const QString &newName)
 MultiFilterSortModel::MultiFilterSortModel(QObject *parent) : QSortFilterProxyModel(parent),
 	divesDisplayed(0),
 	justCleared(false),
-	curr_dive_site(NULL)
+	curr_dive_site(NULL),
+	shownGeneration(0),
+	shownDirty(true)
+{
+}
+
+// Recompile the filters whose check states changed, or all of them if the
+// dive values changed, and combine them into one bit per dive. The value
+// generation moves whenever the dive table changes or is marked as changed,
+// which every edit of a dive does, so the bitmaps never outlive the dives
+// they were compiled from.
+void MultiFilterSortModel::updateBitmap() const
 {
+	int generation = get_dive_value_generation();
+	bool stale = generation != shownGeneration;
+	shownGeneration = generation;
+	Q_FOREACH (FilterModelBase *model, models) {
+		if (stale || model->bitmapDirty) {
+			model->updateBitmap();
+			shownDirty = true;
+		}
+	}
+	if (!shownDirty)
+		return;
+	shown.assign((dive_table.nr + 63) / 64, ~(uint64_t)0);
+	Q_FOREACH (FilterModelBase *model, models) {
+		for (size_t i = 0; i < shown.size(); i++)
+			shown[i] &= model->bitmap[i];
+	}
+	shownDirty = false;
 }
 
 bool MultiFilterSortModel::filterAcceptsRow(int source_row, const QModelIndex &source_parent) const
@@ -422,10 +351,10 @@ bool MultiFilterSortModel::filterAcceptsRow(int source_row, const QModelIndex &s
 		}
 		return showTrip;
 	}
-	Q_FOREACH (FilterModelBase *model, models) {
-		if (!model->doFilter(d, index0, sourceModel()))
-			shouldShow = false;
-	}
+	updateBitmap();
+	int idx = get_divenr(d);
+	if (idx >= 0 && (size_t)idx / 64 < shown.size())
+		shouldShow = (shown[idx / 64] >> (idx % 64)) & 1;
 
 	filter_dive(d, shouldShow);
 	return shouldShow;
@@ -481,12 +410,14 @@ void MultiFilterSortModel::myInvalidate()
 void MultiFilterSortModel::addFilterModel(FilterModelBase *model)
 {
 	models.append(model);
+	shownDirty = true;
 	connect(model, SIGNAL(dataChanged(QModelIndex, QModelIndex)), this, SLOT(myInvalidate()));
 }
 
 void MultiFilterSortModel::removeFilterModel(FilterModelBase *model)
 {
 	models.removeAll(model);
+	shownDirty = true;
 	disconnect(model, SIGNAL(dataChanged(QModelIndex, QModelIndex)), this, SLOT(myInvalidate()));
 }
 
@@ -6,25 +6,31 @@
 #include <QSortFilterProxyModel>
 #include <stdint.h>
 #include <vector>
+#include "core/dive.h"
 
 class FilterModelBase : public QStringListModel {
 	Q_OBJECT
 public:
-	virtual bool doFilter(struct dive *d, QModelIndex &index0, QAbstractItemModel *sourceModel) const = 0;
 	void clearFilter();
 	void selectAll();
 	void invertSelection();
+	void updateBitmap();
 	std::vector<char> checkState;
 	bool anyChecked;
 	bool negate;
+	// The dives shown by this filter, one bit per entry of the dive table.
+	// Rebuilt by updateBitmap() whenever the check states change.
+	std::vector<uint64_t> bitmap;
+	bool bitmapDirty;
 public
 slots:
 	void setNegate(bool negate);
 protected:
-	explicit FilterModelBase(QObject *parent = 0);
+	explicit FilterModelBase(enum dive_value_kind kind, QObject *parent = 0);
 	void updateList(const QStringList &new_list);
 	virtual int countDives(const char *) const = 0;
 private:
+	enum dive_value_kind kind;
 	Qt::ItemFlags flags(const QModelIndex &index) const;
 	QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
 	bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole);
@@ -34,7 +40,6 @@ class TagFilterModel : public FilterModelBase {
 	Q_OBJECT
 public:
 	static TagFilterModel *instance();
-	bool doFilter(struct dive *d, QModelIndex &index0, QAbstractItemModel *sourceModel) const;
 public
 slots:
 	void repopulate();
@@ -48,7 +53,6 @@ class BuddyFilterModel : public FilterModelBase {
 	Q_OBJECT
 public:
 	static BuddyFilterModel *instance();
-	bool doFilter(struct dive *d, QModelIndex &index0, QAbstractItemModel *sourceModel) const;
 public
 slots:
 	void repopulate();
@@ -62,7 +66,6 @@ class LocationFilterModel : public FilterModelBase {
 	Q_OBJECT
 public:
 	static LocationFilterModel *instance();
-	bool doFilter(struct dive *d, QModelIndex &index0, QAbstractItemModel *sourceModel) const;
 public
 slots:
 	void repopulate();
@@ -78,7 +81,6 @@ class SuitsFilterModel : public FilterModelBase {
 	Q_OBJECT
 public:
 	static SuitsFilterModel *instance();
-	bool doFilter(struct dive *d, QModelIndex &index0, QAbstractItemModel *sourceModel) const;
 public
 slots:
 	void repopulate();
@@ -107,9 +109,14 @@ signals:
 	void filterFinished();
 private:
 	MultiFilterSortModel(QObject *parent = 0);
+	void updateBitmap() const;
 	QList<FilterModelBase *> models;
 	bool justCleared;
 	struct dive_site *curr_dive_site;
+	// The intersection of the bitmaps of all filter models
+	mutable std::vector<uint64_t> shown;
+	mutable int shownGeneration; // get_dive_value_generation() the bitmaps were compiled for
+	mutable bool shownDirty;
 };
 
 #endif
@@ -0,0 +1,109 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "testbatchplanner.h"
+#include "core/batchplanner.h"
+#include "core/dive.h"
+#include <QJsonDocument>
+#include <QTextStream>
+
+void TestBatchPlanner::init()
+{
+	copy_prefs(&default_prefs, &prefs);
+}
+
+static QJsonObject readScenarioFile(const QString &fileName)
+{
+	QFile file(fileName);
+	if (!file.open(QFile::ReadOnly))
+		return QJsonObject();
+	return QJsonDocument::fromJson(file.readAll()).object();
+}
+
+void TestBatchPlanner::testScenarioFile()
+{
+	QJsonArray results;
+	QStringList errors;
+
+	QVERIFY(run_batch_plans(readScenarioFile(SUBSURFACE_TEST_DATA "/dives/batchplanner.json"), results, errors));
+	QVERIFY(errors.isEmpty());
+
+	// the air scenario expands into one plan per gfhigh
+	QCOMPARE(results.size(), 3);
+	QJsonObject air70 = results.at(0).toObject();
+	QJsonObject air85 = results.at(1).toObject();
+	QJsonObject ean50 = results.at(2).toObject();
+	QCOMPARE(air70.value("name").toString(), QString("air 30m"));
+	QCOMPARE(air70.value("gfhigh").toInt(), 70);
+	QCOMPARE(air85.value("gfhigh").toInt(), 85);
+	QCOMPARE(ean50.value("deco_mode").toString(), QString("vpmb"));
+	QCOMPARE(ean50.value("max_depth").toDouble(), 45.0);
+
+	// the same plans as calculated by the planner
+	QCOMPARE(air70.value("duration").toInt(), 3740);
+	QCOMPARE(air85.value("duration").toInt(), 2960);
+	QCOMPARE(ean50.value("duration").toInt(), 3560);
+	QCOMPARE(ean50.value("stops").toArray().first().toObject().value("depth").toDouble(), 21.0);
+	QCOMPARE(ean50.value("cylinders").toArray().at(1).toObject().value("gas").toString(), QString("EAN50"));
+
+	QString csv;
+	QTextStream out(&csv);
+	write_batch_plans_csv(out, results);
+	out.flush();
+	QStringList lines = csv.split("\n", QString::SkipEmptyParts);
+	QCOMPARE(lines.size(), 4);
+	QCOMPARE(lines.at(1), QString("\"air 30m\",buehlmann,30,70,0,30,30:00,62:20,\"12m 2:00; 9m 3:40; 6m 6:40; 3m 16:40\",\"AIR 3229l\""));
+}
+
+void TestBatchPlanner::testInvalidScenarios()
+{
+	QJsonArray results;
+	QStringList errors;
+	QJsonObject scenarioFile = QJsonDocument::fromJson(
+		"{ \"scenarios\": ["
+		"  { \"name\": \"no depth\", \"cylinders\": [ { \"o2\": 21 } ], \"bottom_time\": 20 },"
+		"  { \"name\": \"short\", \"cylinders\": [ { \"o2\": 21 } ], \"depth\": 30, \"bottom_time\": [ 1, 20 ] },"
+		"  { \"name\": \"fine\", \"cylinders\": [ { \"o2\": 21 } ], \"depth\": 30, \"bottom_time\": 20 }"
+		"] }").object();
+
+	// nothing is calculated and every broken scenario is reported
+	QVERIFY(!run_batch_plans(scenarioFile, results, errors));
+	QVERIFY(results.isEmpty());
+	QCOMPARE(errors.size(), 2);
+	QVERIFY(errors.at(0).startsWith("no depth: "));
+	QVERIFY(errors.at(1).startsWith("short: bottom time 1 min"));
+}
+
+// The scenarios run side by side, so the gas use and the minimum gas in the
+// dive notes have to come from the SAC of each scenario, not from the preferences.
+void TestBatchPlanner::testScenarioSac()
+{
+	QJsonArray results;
+	QStringList errors;
+	QJsonObject scenarioFile = QJsonDocument::fromJson(
+		"{ \"scenarios\": ["
+		"  { \"name\": \"sac 12\", \"cylinders\": [ { \"o2\": 21, \"size\": 24, \"pressure\": 232 } ],"
+		"    \"depth\": 30, \"bottom_time\": 30, \"gflow\": 30, \"gfhigh\": 70, \"bottom_sac\": 12, \"deco_sac\": 9 },"
+		"  { \"name\": \"sac 18\", \"cylinders\": [ { \"o2\": 21, \"size\": 24, \"pressure\": 232 } ],"
+		"    \"depth\": 30, \"bottom_time\": 30, \"gflow\": 30, \"gfhigh\": 70, \"bottom_sac\": 18, \"deco_sac\": 15 }"
+		"] }").object();
+
+	QVERIFY(run_batch_plans(scenarioFile, results, errors));
+	QVERIFY(errors.isEmpty());
+	QCOMPARE(results.size(), 2);
+	QJsonObject sac12 = results.at(0).toObject();
+	QJsonObject sac18 = results.at(1).toObject();
+
+	// the same deco for both
+	QCOMPARE(sac12.value("duration").toInt(), 3740);
+	QCOMPARE(sac18.value("duration").toInt(), 3740);
+	QCOMPARE(sac12.value("stops"), sac18.value("stops"));
+
+	// but not the same gas
+	QJsonObject cyl12 = sac12.value("cylinders").toArray().first().toObject();
+	QJsonObject cyl18 = sac18.value("cylinders").toArray().first().toObject();
+	QCOMPARE(lrint(cyl12.value("gas_used").toDouble()), 1875l);
+	QCOMPARE(lrint(cyl18.value("gas_used").toDouble()), 2891l);
+	QCOMPARE(lrint(sac12.value("minimum_gas").toDouble()), 110l);
+	QCOMPARE(lrint(sac18.value("minimum_gas").toDouble()), 183l);
+}
+
+QTEST_GUILESS_MAIN(TestBatchPlanner)
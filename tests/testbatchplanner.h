@@ -0,0 +1,17 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTBATCHPLANNER_H
+#define TESTBATCHPLANNER_H
+
+#include <QtTest>
+
+class TestBatchPlanner : public QObject {
+	Q_OBJECT
+private slots:
+	void init();
+
+	void testScenarioFile();
+	void testInvalidScenarios();
+	void testScenarioSac();
+};
+
+#endif
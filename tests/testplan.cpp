@@ -363,6 +363,7 @@ void TestPlan::testMetric()
 	struct diveplan testPlan = {};
 	setupPlan(&testPlan);
 
+	init_deco_parameters(&test_deco_state);
 	plan(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
 
 #if DEBUG
@@ -403,6 +404,7 @@ void TestPlan::testImperial()
 	struct diveplan testPlan = {};
 	setupPlan(&testPlan);
 
+	init_deco_parameters(&test_deco_state);
 	plan(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
 
 #if DEBUG
@@ -443,6 +445,7 @@ void TestPlan::testVpmbMetric45m30minTx()
 	setupPlanVpmb45m30mTx(&testPlan);
 	setCurrentAppState("PlanDive");
 
+	init_deco_parameters(&test_deco_state);
 	plan(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
 
 #if DEBUG
@@ -473,6 +476,7 @@ void TestPlan::testVpmbMetric60m10minTx()
 	setupPlanVpmb60m10mTx(&testPlan);
 	setCurrentAppState("PlanDive");
 
+	init_deco_parameters(&test_deco_state);
 	plan(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
 
 #if DEBUG
@@ -503,6 +507,7 @@ void TestPlan::testVpmbMetric60m30minAir()
 	setupPlanVpmb60m30minAir(&testPlan);
 	setCurrentAppState("PlanDive");
 
+	init_deco_parameters(&test_deco_state);
 	plan(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
 
 #if DEBUG
@@ -533,6 +538,7 @@ void TestPlan::testVpmbMetric60m30minEan50()
 	setupPlanVpmb60m30minEan50(&testPlan);
 	setCurrentAppState("PlanDive");
 
+	init_deco_parameters(&test_deco_state);
 	plan(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
 
 #if DEBUG
@@ -569,6 +575,7 @@ void TestPlan::testVpmbMetric60m30minTx()
 	setupPlanVpmb60m30minTx(&testPlan);
 	setCurrentAppState("PlanDive");
 
+	init_deco_parameters(&test_deco_state);
 	plan(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
 
 #if DEBUG
@@ -605,6 +612,7 @@ void TestPlan::testVpmbMetric100m60min()
 	setupPlanVpmb100m60min(&testPlan);
 	setCurrentAppState("PlanDive");
 
+	init_deco_parameters(&test_deco_state);
 	plan(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
 
 #if DEBUG
@@ -647,6 +655,7 @@ void TestPlan::testVpmbMetricMultiLevelAir()
 	setupPlanVpmbMultiLevelAir(&testPlan);
 	setCurrentAppState("PlanDive");
 
+	init_deco_parameters(&test_deco_state);
 	plan(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
 
 #if DEBUG
@@ -677,6 +686,7 @@ void TestPlan::testVpmbMetric100m10min()
 	setupPlanVpmb100m10min(&testPlan);
 	setCurrentAppState("PlanDive");
 
+	init_deco_parameters(&test_deco_state);
 	plan(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
 
 #if DEBUG
@@ -723,6 +733,7 @@ void TestPlan::testVpmbMetricRepeat()
 	setupPlanVpmb30m20min(&testPlan);
 	setCurrentAppState("PlanDive");
 
+	init_deco_parameters(&test_deco_state);
 	plan(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
 
 #if DEBUG
@@ -799,4 +810,147 @@ void TestPlan::testVpmbMetricRepeat()
 	QCOMPARE(finalDiveRunTimeSeconds, firstDiveRunTimeSeconds);
 }
 
+// the samples and gas changes of displayed_dive, to compare the plans
+static QVector<int> planProfile()
+{
+	QVector<int> profile;
+
+	for (int i = 0; i < displayed_dive.dc.samples; i++) {
+		const struct sample *sample = displayed_dive.dc.sample + i;
+		profile << sample->time.seconds << sample->depth.mm;
+	}
+	for (const struct event *ev = displayed_dive.dc.events; ev; ev = ev->next)
+		profile << ev->time.seconds << ev->gas.index;
+	profile << displayed_dive.dc.duration.seconds;
+	return profile;
+}
+
+// the plan of setupPlan() with 5 more minutes at the last waypoint
+static void setupLongerPlan(struct diveplan *dp)
+{
+	struct divedatapoint *last;
+
+	setupPlan(dp);
+	for (last = dp->dp; last->next; last = last->next)
+		;
+	last->time += 5 * 60;
+}
+
+// plan with a fresh plan and no plan cache
+static QVector<int> uncachedPlan(void (*setup)(struct diveplan *) = setupPlan)
+{
+	struct deco_state *cache = NULL;
+	struct diveplan testPlan = {};
+
+	setup(&testPlan);
+	init_deco_parameters(&test_deco_state);
+	plan(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
+	free_dps(&testPlan);
+	free(cache);
+	return planProfile();
+}
+
+/* The planner keeps the tissues after each sample and the ascent of the last plan
+ * in a plan cache while the user drags the profile. A plan that reuses them has to
+ * come out the same as one calculated from scratch, also after a preference changed.
+ */
+void TestPlan::testPlanCache()
+{
+	struct deco_state *cache = NULL;
+
+	setupPrefs();
+	prefs.unit_system = METRIC;
+	prefs.units.length = units::METERS;
+	prefs.planner_deco_mode = BUEHLMANN;
+
+	QVector<int> expected = uncachedPlan();
+
+	struct diveplan testPlan = {};
+	testPlan.cache = alloc_plan_cache();
+	for (int i = 0; i < 2; i++) {
+		setupPlan(&testPlan);
+		init_deco_parameters(&test_deco_state);
+		plan(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
+		QCOMPARE(planProfile(), expected);
+		// the second time the whole plan comes from the cache
+		QCOMPARE(plan_cache_ascent_restored(testPlan.cache), i == 1);
+	}
+	int samples = displayed_dive.dc.samples;
+
+	// moving the last waypoint resumes from the tissues before it and calculates the ascent again
+	QVector<int> expectedLonger = uncachedPlan(setupLongerPlan);
+	QVERIFY(expectedLonger != expected);
+	setupLongerPlan(&testPlan);
+	init_deco_parameters(&test_deco_state);
+	plan(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
+	QCOMPARE(planProfile(), expectedLonger);
+	QVERIFY(plan_cache_resumed_samples(testPlan.cache) > 0);
+	QVERIFY(plan_cache_resumed_samples(testPlan.cache) < samples);
+	QVERIFY(!plan_cache_ascent_restored(testPlan.cache));
+
+	// and moving it back gives the first plan again
+	setupPlan(&testPlan);
+	init_deco_parameters(&test_deco_state);
+	plan(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
+	QCOMPARE(planProfile(), expected);
+	QVERIFY(plan_cache_resumed_samples(testPlan.cache) > 0);
+
+	// a last stop at 3m instead of 6m changes the ascent, so the cached one must not be used
+	prefs.last_stop = false;
+	QVector<int> expectedLastStop = uncachedPlan();
+	QVERIFY(expectedLastStop != expected);
+	setupPlan(&testPlan);
+	init_deco_parameters(&test_deco_state);
+	plan(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
+	QCOMPARE(planProfile(), expectedLastStop);
+	QVERIFY(!plan_cache_ascent_restored(testPlan.cache));
+
+	free_dps(&testPlan);
+	free_plan_cache(testPlan.cache);
+	free(cache);
+}
+
+/* stop_end_time() predicts the end of each stop and only checks the prediction with trial
+ * ascents. Walk through the stops of dives with different depths, gradient factors and gases,
+ * trimix included, and make sure it always ends the stop where wait_until() does.
+ */
+void TestPlan::testStopEndTime()
+{
+	struct gasmix gases[] = { { {210}, {0} }, { {320}, {0} }, { {500}, {0} }, { {210}, {350} }, { {150}, {450} } };
+	int bottoms[] = { 30000, 45000, 60000, 80000 };
+	short gfs[][2] = { { 100, 100 }, { 30, 70 } };
+	int bottom_time = 25 * 60;
+	struct dive dive = {};
+
+	setupPrefs();
+	prefs.planner_deco_mode = BUEHLMANN;
+	dive.salinity = 10300;
+	dive.surface_pressure.mbar = 1013;
+	for (unsigned int i = 0; i < sizeof(gfs) / sizeof(gfs[0]); i++) {
+		for (unsigned int j = 0; j < sizeof(bottoms) / sizeof(bottoms[0]); j++) {
+			for (unsigned int k = 0; k < sizeof(gases) / sizeof(gases[0]); k++) {
+				struct deco_state ds;
+				int bottom = bottoms[j];
+				int clock = bottom_time;
+
+				set_gf(gfs[i][0], gfs[i][1]);
+				init_deco_parameters(&ds);
+				clear_deco(&ds, 1.013);
+				add_segment(&ds, depth_to_bar(bottom, &dive), &gases[k], bottom_time, 0, &dive, prefs.bottomsac);
+				for (int depth = bottom / 3000 * 3000; depth > 0; depth -= 3000) {
+					struct deco_state predicted = ds, searched = ds;
+					int end = stop_end_time(&predicted, &dive, clock, 61, 60, depth, depth - 3000, bottom / 2, bottom_time, &gases[k], 0, 1.013);
+					int expected = wait_until(&searched, &dive, clock, clock, 61, 60, depth, depth - 3000, bottom / 2, bottom_time, &gases[k], 0, 1.013);
+					QCOMPARE(end, expected);
+					if (expected >= 48 * 3600)
+						break;
+					add_segment(&ds, depth_to_bar(depth, &dive), &gases[k], expected - clock, 0, &dive, prefs.decosac);
+					clock = expected;
+				}
+			}
+		}
+	}
+	set_gf(prefs.gflow, prefs.gfhigh);
+}
+
 QTEST_GUILESS_MAIN(TestPlan)
@@ -18,6 +18,8 @@ private slots:
 	void testVpmbMetricMultiLevelAir();
 	void testVpmbMetric100m10min();
 	void testVpmbMetricRepeat();
+	void testPlanCache();
+	void testStopEndTime();
 };
 
 #endif // TESTPLAN_H
@@ -109,6 +109,10 @@ void TestPreferences::testPreferences()
 	TEST(tecDetails->calcalltissues(), true);
 	tecDetails->setCalcndltts(true);
 	TEST(tecDetails->calcndltts(), true);
+	tecDetails->setCalcndlttsIterative(true);
+	TEST(tecDetails->calcndlttsIterative(), true);
+	tecDetails->setProfileCacheSize(20);
+	TEST(tecDetails->profileCacheSize(), 20);
 	tecDetails->setBuehlmann(true);
 	TEST(tecDetails->buehlmann(), true);
 	tecDetails->setHRgraph(true);
@@ -150,6 +154,8 @@ void TestPreferences::testPreferences()
 	TEST(tecDetails->calcalltissues(), false);
 	tecDetails->setCalcndltts(false);
 	TEST(tecDetails->calcndltts(), false);
+	tecDetails->setCalcndlttsIterative(false);
+	TEST(tecDetails->calcndlttsIterative(), false);
 	tecDetails->setBuehlmann(false);
 	TEST(tecDetails->buehlmann(), false);
 	tecDetails->setHRgraph(false);
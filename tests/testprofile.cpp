@@ -1,10 +1,342 @@
 // SPDX-License-Identifier: GPL-2.0
 #include "testprofile.h"
 #include "core/dive.h"
+#include "core/display.h"
+#include "core/profile.h"
+#include "core/divelist.h"
+#include "core/qthelper.h"
+#include "profile-widget/plotinfocache.h"
+#include <QVector>
+#include <QtConcurrent>
 
 void TestProfile::testRedCeiling()
 {
 	parse_file("../dives/deep.xml");
 }
 
+// like create_plot_info_new(), but the caller owns the plot data
+static void decoInformation(struct dive *dive, struct plot_info *pi)
+{
+	struct deco_state ds;
+	struct profile_deco_settings settings;
+
+	*pi = calculate_max_limits_new(dive, &dive->dc);
+	init_profile_deco_parameters(&ds, NULL);
+	init_decompression(&ds, dive);
+	init_profile_deco_settings(&settings, &ds, NULL);
+	calculate_plot_info(dive, &dive->dc, pi, false, &ds, &settings);
+}
+
+static QVector<plot_data> ndl_tts(struct dive *dive, bool iterative)
+{
+	struct plot_info pi;
+	QVector<plot_data> entries;
+
+	prefs.calcndltts_iterative = iterative;
+	decoInformation(dive, &pi);
+	for (int i = 0; i < pi.nr; i++)
+		entries.append(pi.entry[i]);
+	free_plot_info_data(&pi);
+	return entries;
+}
+
+// The solved NDL and the cached ascents may only be off by one calculation step
+void TestProfile::testNdlTtsShortcuts()
+{
+	struct dive *dive;
+	int i, j, checked = 0;
+
+	copy_prefs(&default_prefs, &prefs);
+	prefs.calcndltts = true;
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf"), 0);
+	for_each_dive (i, dive) {
+		QVector<plot_data> iterative = ndl_tts(dive, true);
+		QVector<plot_data> shortcut = ndl_tts(dive, false);
+
+		QCOMPARE(shortcut.size(), iterative.size());
+		for (j = 0; j < iterative.size(); j++) {
+			QVERIFY(abs(shortcut[j].ndl_calc - iterative[j].ndl_calc) <= 60);
+			QVERIFY(abs(shortcut[j].tts_calc - iterative[j].tts_calc) <= 60);
+			QVERIFY(abs(shortcut[j].stoptime_calc - iterative[j].stoptime_calc) <= 60);
+			QCOMPARE(shortcut[j].stopdepth_calc, iterative[j].stopdepth_calc);
+			if (iterative[j].ndl_calc || iterative[j].tts_calc)
+				checked++;
+		}
+	}
+	QVERIFY(checked > 0);
+	clear_dive_file_data();
+}
+
+// The binary search has to find the same entry as a scan over the useful entries
+void TestProfile::testPlotEntryIndex()
+{
+	struct dive *dive;
+	int i;
+
+	copy_prefs(&default_prefs, &prefs);
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf"), 0);
+	for_each_dive (i, dive) {
+		struct plot_info pi = calculate_max_limits_new(dive, &dive->dc);
+
+		create_plot_info_new(dive, &dive->dc, &pi, true, NULL);
+		for (int time = -10; time <= pi.maxtime + 10; time += 7) {
+			int expected = -1;
+			for (int j = 2; j < pi.nr - 2; j++) {
+				expected = j;
+				if (pi.entry[j].sec >= time)
+					break;
+			}
+			QCOMPARE(get_plot_entry_index(&pi, time), expected);
+		}
+	}
+	clear_dive_file_data();
+}
+
+// The deco information of a logged dive is calculated on another thread, with the deco
+// state and the settings taken when the job was created. Opening the planner or changing
+// the preferences in the meantime must not change the result.
+void TestProfile::testBackgroundDeco()
+{
+	struct dive *dive;
+	int i, j, k;
+
+	copy_prefs(&default_prefs, &prefs);
+	prefs.calcndltts = true;
+	prefs.calcalltissues = true;
+	setCurrentAppState("Default");
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf"), 0);
+	for_each_dive (i, dive) {
+		struct plot_info limits = calculate_max_limits_new(dive, &dive->dc);
+		struct plot_info expected = limits, pi = limits;
+		struct deco_state ds, job_ds;
+		struct profile_deco_settings settings;
+
+		init_profile_deco_parameters(&ds, NULL);
+		init_decompression(&ds, dive);
+		init_profile_deco_settings(&settings, &ds, NULL);
+		job_ds = ds;
+		calculate_plot_info(dive, &dive->dc, &expected, false, &ds, &settings);
+
+		struct dive *copy = alloc_dive();
+		copy_dive(dive, copy);
+		setCurrentAppState("PlanDive");
+		prefs.planner_deco_mode = prefs.display_deco_mode = VPMB;
+		prefs.calcndltts = prefs.calcalltissues = false;
+		QtConcurrent::run([copy, &pi, &job_ds, &settings]() {
+			calculate_plot_info(copy, &copy->dc, &pi, false, &job_ds, &settings);
+		}).waitForFinished();
+		setCurrentAppState("Default");
+		prefs.planner_deco_mode = default_prefs.planner_deco_mode;
+		prefs.display_deco_mode = default_prefs.display_deco_mode;
+		prefs.calcndltts = prefs.calcalltissues = true;
+
+		QCOMPARE(pi.nr, expected.nr);
+		QVERIFY(pi.ceilings != NULL);
+		for (j = 0; j < pi.nr; j++) {
+			QCOMPARE(pi.entry[j].ceiling, expected.entry[j].ceiling);
+			QCOMPARE(pi.entry[j].ndl_calc, expected.entry[j].ndl_calc);
+			QCOMPARE(pi.entry[j].tts_calc, expected.entry[j].tts_calc);
+			QCOMPARE(pi.entry[j].stoptime_calc, expected.entry[j].stoptime_calc);
+			QCOMPARE(pi.entry[j].stopdepth_calc, expected.entry[j].stopdepth_calc);
+			for (k = 0; k < 16; k++) {
+				QCOMPARE(get_plot_ceiling(&pi, j, k), get_plot_ceiling(&expected, j, k));
+				QCOMPARE(get_plot_percentage(&pi, j, k), get_plot_percentage(&expected, j, k));
+			}
+		}
+		free_plot_info_data(&expected);
+		free_plot_info_data(&pi);
+		clear_dive(copy);
+		free(copy);
+	}
+	clear_dive_file_data();
+}
+
+static void compareDecoInformation(const struct plot_info &pi, const struct plot_info &expected)
+{
+	QCOMPARE(pi.nr, expected.nr);
+	for (int j = 0; j < pi.nr; j++) {
+		QCOMPARE(pi.entry[j].ceiling, expected.entry[j].ceiling);
+		QCOMPARE(pi.entry[j].ndl_calc, expected.entry[j].ndl_calc);
+		QCOMPARE(pi.entry[j].tts_calc, expected.entry[j].tts_calc);
+		QCOMPARE(pi.entry[j].stoptime_calc, expected.entry[j].stoptime_calc);
+		QCOMPARE(pi.entry[j].stopdepth_calc, expected.entry[j].stopdepth_calc);
+		for (int k = 0; k < 16; k++) {
+			QCOMPARE(get_plot_ceiling(&pi, j, k), get_plot_ceiling(&expected, j, k));
+			QCOMPARE(get_plot_percentage(&pi, j, k), get_plot_percentage(&expected, j, k));
+		}
+	}
+}
+
+// The Buehlmann deco calculation picks up the last profile at the checkpoint before
+// the first sample that differs. Changing the end of a dive has to give the same
+// result as calculating it from scratch.
+void TestProfile::testDecoResume()
+{
+	struct dive *dive;
+	int i, j, compared = 0;
+
+	copy_prefs(&default_prefs, &prefs);
+	prefs.calcndltts = true;
+	prefs.calcalltissues = true;
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf"), 0);
+	for_each_dive (i, dive) {
+		struct divecomputer *dc = &dive->dc;
+		struct plot_info pi, expected;
+
+		decoInformation(dive, &pi);
+		free_plot_info_data(&pi);
+
+		// only the samples after the first checkpoint
+		if (dc->samples < 10 || dc->duration.seconds < 900)
+			continue;
+		QVector<int> depths;
+		for (j = dc->samples - 5; j < dc->samples - 1; j++) {
+			depths.append(dc->sample[j].depth.mm);
+			dc->sample[j].depth.mm += 3000;
+		}
+		invalidate_dive_cache(dive);
+
+		decoInformation(dive, &pi);
+		// the samples before the change come from the checkpoint
+		QVERIFY(deco_resumed_entries() > 0);
+
+		// with the cache taken, the profile is calculated from scratch
+		QVERIFY(trylock_deco_cache());
+		decoInformation(dive, &expected);
+		unlock_deco_cache();
+
+		compareDecoInformation(pi, expected);
+		free_plot_info_data(&expected);
+		free_plot_info_data(&pi);
+		for (j = dc->samples - 5; j < dc->samples - 1; j++)
+			dc->sample[j].depth.mm = depths[j - dc->samples + 5];
+		invalidate_dive_cache(dive);
+		compared++;
+	}
+	QVERIFY(compared > 0);
+	clear_dive_file_data();
+}
+
+static bool sameTissues(const struct deco_state &a, const struct deco_state &b)
+{
+	return !memcmp(a.tissue_n2_sat, b.tissue_n2_sat, sizeof(a.tissue_n2_sat)) &&
+	       !memcmp(a.tissue_he_sat, b.tissue_he_sat, sizeof(a.tissue_he_sat));
+}
+
+static struct deco_state tissuesBefore(struct dive *dive)
+{
+	struct deco_state ds;
+
+	init_profile_deco_parameters(&ds, NULL);
+	init_decompression(&ds, dive);
+	return ds;
+}
+
+// init_decompression() keeps the tissues after each previous dive. They are used as long
+// as the dive is unchanged, and an edit of the dive has to invalidate them, whether it
+// bumps the change counter or not.
+void TestProfile::testDecoSnapshots()
+{
+	struct dive *dive, *prev = NULL;
+	int i;
+
+	copy_prefs(&default_prefs, &prefs);
+	setCurrentAppState("Default");
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf"), 0);
+	sort_table(&dive_table);
+	// a dive with a previous dive with samples in the 12 hours before it
+	for_each_dive (i, dive) {
+		if (i && get_dive(i - 1)->dc.samples > 1 && dive->when - dive_endtime(get_dive(i - 1)) < 12 * 3600 &&
+		    (!dive->divetrip || dive->divetrip == get_dive(i - 1)->divetrip)) {
+			prev = get_dive(i - 1);
+			break;
+		}
+	}
+	QVERIFY(prev != NULL);
+	struct deco_state expected = tissuesBefore(dive);
+
+	// an edit invalidates it
+	for (i = 0; i < prev->dc.samples; i++)
+		prev->dc.sample[i].depth.mm += 5000;
+	invalidate_dive_cache(prev);
+	QVERIFY(!sameTissues(tissuesBefore(dive), expected));
+
+	// and the new snapshot is calculated like the first one
+	for (i = 0; i < prev->dc.samples; i++)
+		prev->dc.sample[i].depth.mm -= 5000;
+	invalidate_dive_cache(prev);
+	QVERIFY(sameTissues(tissuesBefore(dive), expected));
+
+	// so is one after edits that don't bump the change counter
+	for (i = 0; i < prev->dc.samples; i++)
+		prev->dc.sample[i].depth.mm += 5000;
+	QVERIFY(!sameTissues(tissuesBefore(dive), expected));
+	for (i = 0; i < prev->dc.samples; i++)
+		prev->dc.sample[i].depth.mm -= 5000;
+	struct gasmix gasmix = prev->cylinder[0].gasmix;
+	prev->cylinder[0].gasmix.o2.permille = gasmix.o2.permille == 320 ? 500 : 320;
+	QVERIFY(!sameTissues(tissuesBefore(dive), expected));
+	prev->cylinder[0].gasmix = gasmix;
+	QVERIFY(sameTissues(tissuesBefore(dive), expected));
+	clear_dive_file_data();
+}
+
+static PlotInfoKey plotInfoKey(struct dive *dive)
+{
+	struct deco_state ds;
+	struct profile_deco_settings settings;
+
+	init_profile_deco_parameters(&ds, NULL);
+	init_decompression(&ds, dive);
+	init_profile_deco_settings(&settings, &ds, NULL);
+	return PlotInfoCache::key(dive, &dive->dc, &ds, &settings, false);
+}
+
+// The profile widget keeps the plot info of the dives shown last. Showing a dive again
+// gives the cached copy, an edit of the dive or other settings calculate it again.
+void TestProfile::testPlotInfoCache()
+{
+	struct dive *dive;
+	struct plot_info pi, cached;
+	PlotInfoCache cache;
+	int i;
+
+	copy_prefs(&default_prefs, &prefs);
+	setCurrentAppState("Default");
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf"), 0);
+	for_each_dive (i, dive) {
+		if (dive->dc.samples > 1)
+			break;
+	}
+	QVERIFY(dive != NULL);
+	dc_number = 0;
+	decoInformation(dive, &pi);
+	QVERIFY(!cache.find(plotInfoKey(dive), &cached));
+	cache.insert(plotInfoKey(dive), pi);
+	QVERIFY(cache.find(plotInfoKey(dive), &cached));
+	compareDecoInformation(cached, pi);
+	free_plot_info_data(&cached);
+
+	// other deco settings
+	prefs.display_deco_mode = VPMB;
+	QVERIFY(!cache.find(plotInfoKey(dive), &cached));
+	prefs.display_deco_mode = default_prefs.display_deco_mode;
+	prefs.calcalltissues = !prefs.calcalltissues;
+	QVERIFY(!cache.find(plotInfoKey(dive), &cached));
+	prefs.calcalltissues = default_prefs.calcalltissues;
+	QVERIFY(cache.find(plotInfoKey(dive), &cached));
+	free_plot_info_data(&cached);
+
+	// an edit of the displayed dive, before and after the change counter is bumped
+	dive->dc.sample[1].depth.mm += 1000;
+	QVERIFY(!cache.find(plotInfoKey(dive), &cached));
+	invalidate_dive_cache(dive);
+	QVERIFY(!cache.find(plotInfoKey(dive), &cached));
+	dive->dc.sample[1].depth.mm -= 1000;
+	QVERIFY(!cache.find(plotInfoKey(dive), &cached));
+
+	free_plot_info_data(&pi);
+	clear_dive_file_data();
+}
+
 QTEST_GUILESS_MAIN(TestProfile)
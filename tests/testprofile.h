@@ -9,6 +9,12 @@ class TestProfile : public QObject{
 	Q_OBJECT
 private slots:
 	void testRedCeiling();
+	void testNdlTtsShortcuts();
+	void testPlotEntryIndex();
+	void testBackgroundDeco();
+	void testDecoResume();
+	void testDecoSnapshots();
+	void testPlotInfoCache();
 };
 
 #endif